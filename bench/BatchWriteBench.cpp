@@ -0,0 +1,65 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include "OpcUABench.h"
+#include "OpcUANodeHandler.h"
+
+using namespace n_opcua;
+using namespace n_opcua::bench;
+
+/* one PLC poll cycle, every 5th tag changes twice */
+static const size_t tagCount = 50000;
+static const size_t cycles = 20;
+
+OPCUA_BENCH(benchBatchWrite) {
+   OpcUAServer server;
+   OpcUANodeHandler handler(&server);
+   std::vector<OpcUAVarNodeContext *> tags;
+   std::vector<double> samples(tagCount);
+   std::vector<UA_Variant> values(tagCount);
+   std::vector<OpcUAValueUpdate> updates;
+
+   for (size_t i = 0; i < tagCount; i++) {
+      OpcUAVarNodeContext *tag = new (&handler) OpcUAVarNodeContext(&handler);
+      tag->setServer(&server);
+      tags.push_back(tag);
+      samples[i] = (double) i;
+      UA_Variant_setScalar(&values[i], &samples[i],
+                           &UA_TYPES[UA_TYPES_DOUBLE]);
+   }
+   for (size_t i = 0; i < tagCount; i++) {
+      OpcUAValueUpdate update = {tags[i], &values[i], 0};
+      updates.push_back(update);
+      if (i % 5 == 0)
+         updates.push_back(update);
+   }
+
+   uint64_t count = cycles * updates.size();
+
+   double seconds = runner.time(cycles, [&](uint64_t) {
+      for (size_t i = 0; i < updates.size(); i++) {
+         UA_DataValue dv;
+         UA_DataValue_init(&dv);
+         dv.value = *updates[i].value;
+         dv.hasValue = true;
+         dv.sourceTimestamp = UA_DateTime_now();
+         dv.hasSourceTimestamp = true;
+         updates[i].ctx->publishDataValue(&dv);
+      }
+   });
+   runner.report("update/single", count, seconds, count / seconds,
+                 "updates/s");
+
+   seconds = runner.time(cycles, [&](uint64_t) {
+      handler.writeValues(updates);
+   });
+   runner.report("update/batch", count, seconds, count / seconds,
+                 "updates/s");
+
+   handler.deleteAllNodes();
+}
@@ -0,0 +1,63 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include "OpcUABench.h"
+#include "OpcUANodeHandler.h"
+#include "OpcUABorrowedArray.h"
+
+using namespace n_opcua;
+using namespace n_opcua::bench;
+
+/* one client read through the datasource, the server frees the value after
+ * encoding it */
+static void readOnce(OpcUAVarNodeContext *ctx) {
+   UA_DataValue value;
+   UA_DataValue_init(&value);
+   OpcUANodeHandler::readCallback(nullptr, nullptr, nullptr, nullptr, ctx,
+                                  false, nullptr, &value);
+   doNotOptimize(value.value.data);
+   UA_DataValue_deleteMembers(&value);
+}
+
+OPCUA_BENCH(benchBorrowedRead) {
+   const size_t sizes[] = {1024, 65536, 1048576};
+
+   OpcUAServer server;
+   OpcUANodeHandler handler(&server);
+
+   for (size_t size : sizes) {
+      uint64_t iterations = 256 * 1048576 / size;
+      double megabytes = (double) size * sizeof(double) * iterations / 1e6;
+      std::string suffix = "/" + std::to_string(size);
+
+      OpcUAVarNodeContext *copied = new OpcUAVarNodeContext(&handler);
+      std::vector<double> samples(size, 1.0);
+      copied->setReadMethodSimple([copied, &samples](UA_DataValue *value) {
+         copied->convertToOPC(&value->value, &samples);
+         value->hasValue = true;
+         return true;
+      });
+
+      double seconds = runner.time(iterations,
+                                   [&](uint64_t) { readOnce(copied); });
+      runner.report("read/copy" + suffix, iterations, seconds,
+                    megabytes / seconds, "MB/s");
+
+      OpcUAVarNodeContext *borrowed = new OpcUAVarNodeContext(&handler);
+      OpcUABorrowedArray<double> waveform(&server, size);
+      borrowed->setReadMethodBorrowed(waveform.getReadMethod());
+
+      seconds = runner.time(iterations,
+                            [&](uint64_t) { readOnce(borrowed); });
+      runner.report("read/borrowed" + suffix, iterations, seconds,
+                    megabytes / seconds, "MB/s");
+
+      handler.deleteNode(copied);
+      handler.deleteNode(borrowed);
+   }
+}
@@ -0,0 +1,120 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include <cstdlib>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include "OpcUABench.h"
+#include "OpcUANodeHandler.h"
+
+using namespace n_opcua;
+using namespace n_opcua::bench;
+
+static const size_t nodeCount = 300000;
+
+/* a plant model tag as the application would set it up */
+static OpcUAVarNodeContext *createTag(OpcUANodeHandler *handler, size_t i,
+                                      bool inArena = false) {
+   OpcUAVarNodeContext *tag = inArena ?
+         new (handler) OpcUAVarNodeContext(handler) :
+         new OpcUAVarNodeContext(handler);
+   std::string name = "plant.area" + std::to_string(i % 64) + ".tag" +
+                      std::to_string(i);
+   tag->setNamespace(1);
+   tag->setName(name);
+   tag->setQualifiedName(name);
+   tag->setDescription("measured value");
+   tag->setDataType(0.0);
+   tag->setReadable(true);
+   tag->setReadMethodSimple([tag](UA_DataValue *value) {
+      double zero = 0.0;
+      tag->convertToOPC(value, &zero);
+      return true;
+   });
+   return tag;
+}
+
+/* bytes taken from the heap, 0 if unknown */
+static size_t heapInUse() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+   struct mallinfo2 info = mallinfo2();
+   return info.uordblks + info.hblkhd;
+#else
+   return 0;
+#endif
+}
+
+OPCUA_BENCH(benchNodeCreate) {
+   const struct {
+      const char *name;
+      bool inArena;
+   } cases[] = {{"heap", false}, {"arena", true}};
+
+   for (const auto &c : cases) {
+      OpcUANodeHandler handler;
+      std::vector<OpcUAVarNodeContext *> tags;
+      handler.reserveNodes(nodeCount);
+      tags.reserve(nodeCount);
+
+      size_t heapBefore = heapInUse();
+      double seconds = runner.time(1, [&](uint64_t) {
+         for (size_t i = 0; i < nodeCount; i++)
+            tags.push_back(createTag(&handler, i, c.inArena));
+      });
+      size_t bytes = heapInUse() - heapBefore;
+      std::string name = c.name;
+      runner.report("create/" + name, nodeCount, seconds,
+                    nodeCount / seconds, "nodes/s");
+      if (bytes > 0)
+         runner.report("memory/" + name, nodeCount, 0,
+                       (double) bytes / nodeCount, "bytes/node");
+
+      /* what a periodic sweep over all tags costs */
+      runner.measure("iterate/" + name, nodeCount, [&](uint64_t i) {
+         doNotOptimize(tags[i]->getNodeId()->identifier.string.length +
+                       tags[i]->getName().size());
+      });
+
+      seconds = runner.time(1, [&](uint64_t) { handler.deleteAllNodes(); });
+      runner.report("teardown/" + name, nodeCount, seconds,
+                    nodeCount / seconds, "nodes/s");
+   }
+}
+
+OPCUA_BENCH(benchBulkAdd) {
+   {
+      OpcUAServer server;
+      server.setBaseConfigDone();
+      OpcUANodeHandler handler(&server);
+
+      double seconds = runner.time(1, [&](uint64_t) {
+         for (size_t i = 0; i < nodeCount; i++)
+            handler.addVariableCallbackNodeDataSourceToServer(
+                  createTag(&handler, i));
+      });
+      runner.report("startup/single", nodeCount, seconds,
+                    nodeCount / seconds, "nodes/s");
+   }
+   {
+      OpcUAServer server;
+      server.setBaseConfigDone();
+      OpcUANodeHandler handler(&server);
+      std::vector<OpcUANodeContext *> tags;
+
+      double seconds = runner.time(1, [&](uint64_t) {
+         handler.reserveNodes(nodeCount);
+         tags.reserve(nodeCount);
+         for (size_t i = 0; i < nodeCount; i++)
+            tags.push_back(createTag(&handler, i));
+         handler.addNodesToServer(tags);
+      });
+      runner.report("startup/bulk", nodeCount, seconds,
+                    nodeCount / seconds, "nodes/s");
+   }
+}
@@ -0,0 +1,147 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include <algorithm>
+#include "OpcUABench.h"
+#include "OpcUANodeHandler.h"
+
+using namespace n_opcua;
+using namespace n_opcua::bench;
+
+static const uint64_t scalarConversions = 1000000;
+/* elements converted per vector case, the count of calls depends on size */
+static const uint64_t vectorElements = 16000000;
+
+template <typename T>
+static void benchScalar(BenchRunner &runner, OpcUAVarNodeContext *ctx,
+                        const std::string &name, T sample) {
+   runner.measure("convert/to/" + name, scalarConversions, [&](uint64_t) {
+      UA_Variant var;
+      UA_Variant_init(&var);
+      ctx->convertToOPC(&var, &sample);
+      doNotOptimize(var.data);
+      UA_Variant_deleteMembers(&var);
+   });
+
+   UA_Variant var;
+   UA_Variant_init(&var);
+   ctx->convertToOPC(&var, &sample);
+   runner.measure("convert/from/" + name, scalarConversions, [&](uint64_t) {
+      T value;
+      ctx->convertFromOPC(&value, &var);
+      doNotOptimize(value);
+   });
+   UA_Variant_deleteMembers(&var);
+}
+
+template <typename T>
+static void benchVector(BenchRunner &runner, OpcUAVarNodeContext *ctx,
+                        const std::string &name, T sample) {
+   const size_t sizes[] = {1, 16, 256, 4096};
+
+   for (size_t size : sizes) {
+      std::vector<T> vec(size, sample);
+      uint64_t calls = vectorElements / size;
+      double seconds = runner.time(calls, [&](uint64_t) {
+         UA_Variant var;
+         UA_Variant_init(&var);
+         ctx->convertToOPC(&var, &vec);
+         doNotOptimize(var.data);
+         UA_Variant_deleteMembers(&var);
+      });
+      runner.report("convert/to/" + name + "[" + std::to_string(size) + "]",
+                    calls, seconds, calls * size / seconds, "elements/s");
+
+      UA_Variant var;
+      UA_Variant_init(&var);
+      ctx->convertToOPC(&var, &vec);
+      seconds = runner.time(calls, [&](uint64_t) {
+         std::vector<T> value;
+         ctx->convertFromOPC(&value, &var);
+         doNotOptimize(value.size());
+      });
+      runner.report("convert/from/" + name + "[" + std::to_string(size) + "]",
+                    calls, seconds, calls * size / seconds, "elements/s");
+      UA_Variant_deleteMembers(&var);
+   }
+}
+
+/* large arrays into a reused vector, the same type and widened or narrowed,
+ * against a loop converting one element at a time */
+template <typename D, typename S>
+static void benchArray(BenchRunner &runner, OpcUAVarNodeContext *ctx,
+                       const std::string &name) {
+   const size_t sizes[] = {1000, 100000, 1000000, 10000000};
+   /* elements converted per case */
+   const uint64_t elements = 40000000;
+
+   for (size_t size : sizes) {
+      std::vector<S> source(size);
+      for (size_t i = 0; i < size; i++)
+         source[i] = static_cast<S>(i % 1000);
+      UA_Variant var;
+      UA_Variant_init(&var);
+      ctx->convertToOPC(&var, &source);
+
+      std::vector<D> value(size);
+      uint64_t calls = std::max<uint64_t>(1, elements / size);
+      std::string suffix = name + "[" + std::to_string(size) + "]";
+
+      double seconds = runner.time(calls, [&](uint64_t) {
+         ctx->convertFromOPC(value.data(), value.size(), &var);
+         doNotOptimize(value.data());
+      });
+      runner.report("convert/array/" + suffix, calls, seconds,
+                    calls * size / seconds, "elements/s");
+
+      seconds = runner.time(calls, [&](uint64_t) {
+         const S *data = static_cast<const S *>(var.data);
+         for (size_t i = 0; i < size; i++)
+            value[i] = static_cast<D>(data[i]);
+         doNotOptimize(value.data());
+      });
+      runner.report("convert/array/" + suffix + "/loop", calls, seconds,
+                    calls * size / seconds, "elements/s");
+
+      UA_Variant_deleteMembers(&var);
+   }
+}
+
+OPCUA_BENCH(benchConvert) {
+   OpcUANodeHandler handler;
+   OpcUAVarNodeContext *ctx = new OpcUAVarNodeContext(&handler);
+
+   benchScalar<bool>(runner, ctx, "bool", true);
+   benchScalar<int8_t>(runner, ctx, "int8", -8);
+   benchScalar<uint8_t>(runner, ctx, "uint8", 8);
+   benchScalar<int16_t>(runner, ctx, "int16", -16);
+   benchScalar<uint16_t>(runner, ctx, "uint16", 16);
+   benchScalar<int32_t>(runner, ctx, "int32", -32);
+   benchScalar<uint32_t>(runner, ctx, "uint32", 32);
+   benchScalar<int64_t>(runner, ctx, "int64", -64);
+   benchScalar<uint64_t>(runner, ctx, "uint64", 64);
+   benchScalar<float>(runner, ctx, "float", 1.5f);
+   benchScalar<double>(runner, ctx, "double", 2.5);
+   benchScalar<std::string>(runner, ctx, "string", "Plant/Line1/Tag42");
+
+   benchVector<bool>(runner, ctx, "bool", true);
+   benchVector<int16_t>(runner, ctx, "int16", -16);
+   benchVector<int32_t>(runner, ctx, "int32", -32);
+   benchVector<uint32_t>(runner, ctx, "uint32", 32);
+   benchVector<int64_t>(runner, ctx, "int64", -64);
+   benchVector<float>(runner, ctx, "float", 1.5f);
+   benchVector<double>(runner, ctx, "double", 2.5);
+
+   benchArray<double, double>(runner, ctx, "double");
+   benchArray<double, float>(runner, ctx, "float->double");
+   benchArray<float, double>(runner, ctx, "double->float");
+   benchArray<int32_t, int16_t>(runner, ctx, "int16->int32");
+   benchArray<double, int32_t>(runner, ctx, "int32->double");
+
+   handler.deleteAllNodes();
+}
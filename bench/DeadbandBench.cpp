@@ -0,0 +1,63 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include <random>
+#include "OpcUABench.h"
+#include "OpcUANodeHandler.h"
+
+using namespace n_opcua;
+using namespace n_opcua::bench;
+
+/* analog tags around 50.0 with +-0.05 of noise, a step of 1.0 every 10
+ * samples of a tag */
+static const size_t tagCount = 10000;
+static const size_t samplesPerTag = 50;
+
+OPCUA_BENCH(benchDeadband) {
+   std::vector<double> signal(tagCount * samplesPerTag);
+   std::mt19937 rng(42);
+   std::uniform_real_distribution<double> noise(-0.05, 0.05);
+   for (size_t i = 0; i < signal.size(); i++)
+      signal[i] = 50.0 + (double) (i / tagCount / 10) + noise(rng);
+
+   const struct {
+      const char *name;
+      OpcUADeadbandType type;
+      double band;
+   } cases[] = {
+      {"none", OpcUADeadbandNone, 0},
+      {"absolute/0.2", OpcUADeadbandAbsolute, 0.2},
+      {"percent/0.2", OpcUADeadbandPercent, 0.2},
+   };
+
+   for (const auto &c : cases) {
+      OpcUAServer server;
+      OpcUANodeHandler handler(&server);
+      std::vector<OpcUAVarNodeContext *> tags;
+      for (size_t i = 0; i < tagCount; i++) {
+         OpcUAVarNodeContext *tag = new (&handler) OpcUAVarNodeContext(&handler);
+         tag->setServer(&server);
+         /* 0.2 % of 0..100 is the same band as the absolute case */
+         tag->setDeadband(c.type, c.band, 0, 100);
+         tags.push_back(tag);
+      }
+
+      uint64_t updates = signal.size();
+      double seconds = runner.time(updates, [&](uint64_t i) {
+         tags[i % tagCount]->publishValue(signal[i]);
+      });
+
+      uint64_t suppressed = 0;
+      for (size_t i = 0; i < tagCount; i++)
+         suppressed += tags[i]->getSuppressedCount();
+      runner.report(std::string("deadband/") + c.name, updates, seconds,
+                    100.0 * suppressed / updates, "% suppressed");
+
+      handler.deleteAllNodes();
+   }
+}
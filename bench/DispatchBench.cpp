@@ -0,0 +1,144 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include "OpcUABench.h"
+#include "OpcUANodeHandler.h"
+
+using namespace n_opcua;
+using namespace n_opcua::bench;
+
+static const uint64_t calls = 2000000;
+
+/* the static callbacks as the server calls them, through std::function */
+OPCUA_BENCH(benchDispatch) {
+   OpcUANodeHandler handler;
+   OpcUAVarNodeContext *full = new OpcUAVarNodeContext(&handler);
+   OpcUAVarNodeContext *simple = new OpcUAVarNodeContext(&handler);
+   OpcUAMethodNodeContext *method = new OpcUAMethodNodeContext(&handler);
+   OpcUAMethodNodeContext *methodSimple = new OpcUAMethodNodeContext(&handler);
+   double sample = 1.0;
+   double sink = 0.0;
+
+   full->setReadMethod([&](const UA_NodeId *, void *, UA_Boolean,
+                           const UA_NumericRange *, UA_DataValue *value) {
+      full->convertToOPC(value, &sample);
+      return true;
+   });
+   full->setWriteMethod([&](const UA_NodeId *, void *,
+                            const UA_NumericRange *,
+                            const UA_DataValue *value) {
+      full->convertFromOPC(&sink, value);
+      return true;
+   });
+   simple->setReadMethodSimple([&](UA_DataValue *value) {
+      simple->convertToOPC(value, &sample);
+      return true;
+   });
+   simple->setWriteMethodSimple([&](const UA_DataValue *value) {
+      simple->convertFromOPC(&sink, value);
+      return true;
+   });
+   method->setCallback([&](const UA_NodeId *, void *, const UA_NodeId *,
+                           void *, size_t, const UA_Variant *input, size_t,
+                           UA_Variant *output) {
+      *static_cast<double *>(output->data) =
+            *static_cast<double *>(input->data);
+      return true;
+   });
+   methodSimple->setCallbackSimple([&](size_t, const UA_Variant *input,
+                                       size_t, UA_Variant *output) {
+      *static_cast<double *>(output->data) =
+            *static_cast<double *>(input->data);
+      return true;
+   });
+
+   const struct {
+      const char *name;
+      OpcUAVarNodeContext *ctx;
+   } vars[] = {{"full", full}, {"simple", simple}};
+
+   for (const auto &var : vars) {
+      OpcUAVarNodeContext *ctx = var.ctx;
+      runner.measure(std::string("dispatch/read/") + var.name, calls,
+                     [&](uint64_t) {
+         UA_DataValue value;
+         UA_DataValue_init(&value);
+         OpcUANodeHandler::readCallback(nullptr, nullptr, nullptr, nullptr,
+                                        ctx, false, nullptr, &value);
+         doNotOptimize(value.value.data);
+         UA_DataValue_deleteMembers(&value);
+      });
+
+      UA_DataValue written;
+      UA_DataValue_init(&written);
+      ctx->convertToOPC(&written, &sample);
+      runner.measure(std::string("dispatch/write/") + var.name, calls,
+                     [&](uint64_t) {
+         OpcUANodeHandler::writeCallback(nullptr, nullptr, nullptr, nullptr,
+                                         ctx, nullptr, &written);
+         doNotOptimize(sink);
+      });
+      UA_DataValue_deleteMembers(&written);
+   }
+
+   /* the server hands in allocated output variants */
+   UA_Variant input, output;
+   UA_Variant_setScalar(&input, &sample, &UA_TYPES[UA_TYPES_DOUBLE]);
+   UA_Variant_setScalar(&output, &sink, &UA_TYPES[UA_TYPES_DOUBLE]);
+
+   const struct {
+      const char *name;
+      OpcUAMethodNodeContext *ctx;
+   } methods[] = {{"full", method}, {"simple", methodSimple}};
+
+   for (const auto &m : methods) {
+      OpcUAMethodNodeContext *ctx = m.ctx;
+      runner.measure(std::string("dispatch/call/") + m.name, calls,
+                     [&](uint64_t) {
+         OpcUANodeHandler::onMethodCallCallback(nullptr, nullptr, nullptr,
+                                                nullptr, ctx, nullptr,
+                                                nullptr, 1, &input, 1,
+                                                &output);
+         doNotOptimize(sink);
+      });
+   }
+
+   /* the same calls again, recording statistics, timing every or every
+    * 16th call */
+   const unsigned sampleShifts[] = {0, 4};
+   for (unsigned shift : sampleShifts) {
+      std::string suffix = "+stats/" + std::to_string(1u << shift);
+      handler.setStatsEnabled(true, shift);
+
+      runner.measure("dispatch/read/simple" + suffix, calls, [&](uint64_t) {
+         UA_DataValue value;
+         UA_DataValue_init(&value);
+         OpcUANodeHandler::readCallback(nullptr, nullptr, nullptr, nullptr,
+                                        simple, false, nullptr, &value);
+         doNotOptimize(value.value.data);
+         UA_DataValue_deleteMembers(&value);
+      });
+      runner.measure("dispatch/call/simple" + suffix, calls, [&](uint64_t) {
+         OpcUANodeHandler::onMethodCallCallback(nullptr, nullptr, nullptr,
+                                                nullptr, methodSimple,
+                                                nullptr, nullptr, 1, &input,
+                                                1, &output);
+         doNotOptimize(sink);
+      });
+   }
+   handler.setStatsEnabled(false);
+
+   runner.measure("timestamp/now", calls, [&](uint64_t) {
+      UA_DataValue value;
+      UA_DataValue_init(&value);
+      full->setOPCSourceTimeStampNow(&value);
+      doNotOptimize(value.sourceTimestamp);
+   });
+
+   handler.deleteAllNodes();
+}
@@ -0,0 +1,78 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include <poll.h>
+
+#include <thread>
+#include <atomic>
+#include "OpcUABench.h"
+#include "OpcUAServer.h"
+
+using namespace n_opcua;
+using namespace n_opcua::bench;
+
+static const uint64_t iterations = 1000000;
+static const uint64_t writes = 2000;
+
+/* the time from a write of another thread until an iteration started after
+ * it finished */
+static double writeLatency(OpcUAServer *server, BenchRunner &runner) {
+   UA_NodeId node = UA_NODEID_NUMERIC(1, 1000);
+   UA_Double sample = 1.0;
+   UA_Variant value;
+   UA_Variant_setScalar(&value, &sample, &UA_TYPES[UA_TYPES_DOUBLE]);
+
+   return runner.time(writes, [&](uint64_t) {
+      uint64_t e = server->getEpoch();
+      server->writeValue(&node, &value);
+      uint64_t done = (e + 1) | 1;
+      while (server->getEpoch() <= done)
+         std::this_thread::yield();
+   });
+}
+
+OPCUA_BENCH(benchEventLoop) {
+   OpcUAServer server;
+   server.setBaseConfigDone();
+
+   runner.measure("eventloop/raw", iterations, [&](uint64_t) {
+      doNotOptimize(UA_Server_run_iterate(server.getServer(), false));
+   });
+
+   server.startup();
+   runner.measure("eventloop/iterate", iterations, [&](uint64_t) {
+      doNotOptimize(server.iterate());
+   });
+   server.shutdown();
+
+   /* a host loop sleeping in poll() until the deadline or a wakeup */
+   std::atomic<bool> hosting(true);
+   server.startup();
+   std::thread host([&] {
+      struct pollfd wakeup = {server.getWakeupFd(), POLLIN, 0};
+      int timeout = server.iterate();
+      while (hosting) {
+         poll(&wakeup, 1, timeout);
+         timeout = server.iterate();
+      }
+   });
+   double hostSeconds = writeLatency(&server, runner);
+   hosting = false;
+   server.terminate();
+   host.join();
+   server.shutdown();
+   runner.report("eventloop/write/host", writes, hostSeconds,
+                 writes / hostSeconds, "writes/s");
+
+   /* the managed thread of start() */
+   server.start();
+   double managedSeconds = writeLatency(&server, runner);
+   server.stop();
+   runner.report("eventloop/write/managed", writes, managedSeconds,
+                 writes / managedSeconds, "writes/s");
+}
@@ -0,0 +1,90 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include <chrono>
+#include <thread>
+#include "OpcUABench.h"
+#include "OpcUAServer.h"
+
+using namespace n_opcua;
+using namespace n_opcua::bench;
+
+/* a LDS answering after a delay, failing if unreachable, the delay is spent
+ * in the server loop like the answer of a LDS */
+static OpcUALDSCall standIn(uint32_t delay, bool reachable) {
+   return [delay, reachable](const std::string &, bool) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+      return reachable ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BADTIMEOUT;
+   };
+}
+
+/* the longest server loop iteration while a slow LDS registers us, the
+ * iteration running the request waits for the answer */
+static double longestIteration(OpcUAServer *server, uint32_t millis) {
+   std::chrono::steady_clock::time_point end =
+         std::chrono::steady_clock::now() + std::chrono::milliseconds(millis);
+   double longest = 0;
+
+   server->startup();
+   while (std::chrono::steady_clock::now() < end) {
+      double seconds = BenchRunner::time(1, [&](uint64_t) {
+         server->iterate();
+      });
+      if (seconds > longest)
+         longest = seconds;
+   }
+   server->shutdown();
+   return longest;
+}
+
+OPCUA_BENCH(benchLDSRegister) {
+   const uint32_t slow = 200;
+   OpcUALDSOptions options;
+   options.firstDelay = 0;
+   options.period = 50;
+
+   /* a slow LDS does not stall registerAtLDS() */
+   OpcUAServer server;
+   server.setBaseConfigDone();
+   server.setLDSOptions(options);
+   server.setLDSCall(standIn(slow, true));
+   runner.measure("lds/registerAtLDS", 1, [&](uint64_t) {
+      server.registerAtLDS("opc.tcp://localhost:4840");
+   });
+   double longest = longestIteration(&server, 3 * slow);
+   runner.report("lds/longest iteration", 1, longest, longest * 1e3, "ms");
+
+   OpcUALDSStats stats;
+   server.getLDSStats(&stats);
+   runner.report("lds/registration latency", stats.attempts,
+                 stats.meanLatency() * 1e-9 * stats.attempts,
+                 stats.meanLatency() * 1e-6, "ms mean");
+   runner.measure("lds/unregister slow", 1, [&](uint64_t) {
+      server.unregisterAtLDS();
+   });
+
+   /* an unreachable LDS is retried with backoff and not unregistered */
+   OpcUAServer lonely(4841);
+   lonely.setBaseConfigDone();
+   options.minBackoff = 10;
+   options.maxBackoff = 80;
+   lonely.setLDSOptions(options);
+   lonely.setLDSCall(standIn(1, false));
+   lonely.start();
+   lonely.registerAtLDS("opc.tcp://localhost:4840");
+   std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+   lonely.getLDSStats(&stats);
+   runner.report("lds/attempts unreachable", stats.attempts, 1.0,
+                 stats.attempts, "per s");
+   runner.report("lds/backoff", stats.consecutiveFailures, 1.0,
+                 stats.nextDelay, "ms next");
+   runner.measure("lds/unregister unreachable", 1, [&](uint64_t) {
+      lonely.unregisterAtLDS();
+   });
+   lonely.stop();
+}
@@ -0,0 +1,96 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include <algorithm>
+#include <random>
+#include <unordered_map>
+#include "OpcUABench.h"
+#include "OpcUANodeHandler.h"
+
+using namespace n_opcua;
+using namespace n_opcua::bench;
+
+static const uint64_t lookups = 1000000;
+
+/* a random visiting order, so lookups are not helped by the cache */
+static std::vector<size_t> shuffledOrder(size_t count) {
+   std::vector<size_t> order(count);
+   for (size_t i = 0; i < count; i++)
+      order[i] = i;
+   std::shuffle(order.begin(), order.end(), std::mt19937(42));
+   return order;
+}
+
+OPCUA_BENCH(benchNodeIndexLookup) {
+   const size_t sizes[] = {1000, 100000, 500000};
+
+   for (size_t size : sizes) {
+      OpcUANodeHandler handler;
+      std::vector<OpcUANodeContext *> ctxs;
+      std::vector<std::string> names;
+      /* the map the handler used up to now, keyed by the NodeId pointer */
+      std::unordered_map<UA_NodeId *, OpcUANodeContext *> nodemap;
+
+      for (size_t i = 0; i < size; i++) {
+         OpcUAObjectNodeContext *ctx = new OpcUAObjectNodeContext(&handler);
+         names.push_back("Plant/Line" + std::to_string(i % 16) + "/Tag" +
+                         std::to_string(i));
+         ctx->setNamespace(1);
+         ctx->setName(names.back());
+         ctxs.push_back(ctx);
+         nodemap.emplace(ctx->getNodeId(), ctx);
+      }
+
+      /*
+       * NodeIds as they come from a request: equal content, other memory and
+       * visited in random order. They are laid out in visiting order, so only
+       * the lookup itself misses the cache.
+       */
+      std::vector<size_t> order = shuffledOrder(size);
+      std::vector<std::string> requestNames(size);
+      std::vector<UA_NodeId> requests(size);
+      std::vector<UA_NodeId *> pointers(size);
+      for (size_t i = 0; i < size; i++) {
+         requestNames[i] = names[order[i]];
+         requests[i] = UA_NODEID_STRING(1, (char *) requestNames[i].c_str());
+         pointers[i] = ctxs[order[i]]->getNodeId();
+      }
+
+      std::string suffix = "/" + std::to_string(size);
+
+      runner.measure("nodeindex/string" + suffix, lookups, [&](uint64_t i) {
+         OpcUANodeContext *ctx = nullptr;
+         handler.findNodeInIndex(&requests[i % size], &ctx);
+         doNotOptimize(ctx);
+      });
+
+      runner.measure("nodemap/pointer" + suffix, lookups, [&](uint64_t i) {
+         std::unordered_map<UA_NodeId *, OpcUANodeContext *>::iterator it =
+               nodemap.find(pointers[i % size]);
+         doNotOptimize(it);
+      });
+
+      /* numeric NodeIds are compared by their key only */
+      OpcUANodeIndex numeric(size);
+      for (size_t i = 0; i < size; i++) {
+         UA_NodeId node = UA_NODEID_NUMERIC(1, (UA_UInt32) (i + 1));
+         numeric.insert(&node, ctxs[i]);
+      }
+
+      runner.measure("nodeindex/numeric" + suffix, lookups, [&](uint64_t i) {
+         UA_NodeId node = UA_NODEID_NUMERIC(1, (UA_UInt32) (order[i % size] + 1));
+         doNotOptimize(numeric.find(&node));
+      });
+
+      runner.measure("nodeindex/miss" + suffix, lookups, [&](uint64_t i) {
+         UA_NodeId node = requests[i % size];
+         node.namespaceIndex = 2;
+         doNotOptimize(handler.findNodeInIndex(&node));
+      });
+   }
+}
@@ -0,0 +1,83 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include "OpcUABench.h"
+#include "OpcUANodeSetLoader.h"
+
+using namespace n_opcua;
+using namespace n_opcua::bench;
+
+/* a plant model of folders with 100 variables each */
+static const size_t variableCount = 200000;
+static const size_t variablesPerFolder = 100;
+
+static void writeNodeSet(FILE *file) {
+   fprintf(file, "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+           "<UANodeSet xmlns=\"http://opcfoundation.org/UA/2011/03/UANodeSet.xsd\">\n"
+           "  <NamespaceUris><Uri>urn:bench:plant</Uri></NamespaceUris>\n"
+           "  <Aliases>\n"
+           "    <Alias Alias=\"Double\">i=11</Alias>\n"
+           "    <Alias Alias=\"Organizes\">i=35</Alias>\n"
+           "    <Alias Alias=\"HasComponent\">i=47</Alias>\n"
+           "    <Alias Alias=\"HasTypeDefinition\">i=40</Alias>\n"
+           "  </Aliases>\n");
+
+   for (size_t i = 0; i < variableCount; i++) {
+      size_t folder = i / variablesPerFolder;
+      if (i % variablesPerFolder == 0)
+         fprintf(file,
+                 "  <UAObject NodeId=\"ns=1;i=%zu\" BrowseName=\"1:Area%zu\" "
+                 "ParentNodeId=\"i=85\">\n"
+                 "    <DisplayName>Area%zu</DisplayName>\n"
+                 "    <References>\n"
+                 "      <Reference ReferenceType=\"HasTypeDefinition\">i=61</Reference>\n"
+                 "      <Reference ReferenceType=\"Organizes\" IsForward=\"false\">i=85</Reference>\n"
+                 "    </References>\n"
+                 "  </UAObject>\n", 1000000 + folder, folder, folder);
+
+      fprintf(file,
+              "  <UAVariable NodeId=\"ns=1;s=Area%zu.Tag%zu\" BrowseName=\"1:Tag%zu\" "
+              "DataType=\"Double\" AccessLevel=\"3\">\n"
+              "    <DisplayName>Tag%zu</DisplayName>\n"
+              "    <Description>Measured value &amp; unit</Description>\n"
+              "    <References>\n"
+              "      <Reference ReferenceType=\"HasTypeDefinition\">i=63</Reference>\n"
+              "      <Reference ReferenceType=\"HasComponent\" IsForward=\"false\">ns=1;i=%zu</Reference>\n"
+              "    </References>\n"
+              "    <Value><uax:Double>0.0</uax:Double></Value>\n"
+              "  </UAVariable>\n", folder, i, i, i, 1000000 + folder);
+   }
+   fprintf(file, "</UANodeSet>\n");
+}
+
+OPCUA_BENCH(benchNodeSetLoad) {
+   FILE *file = tmpfile();
+   if (!file)
+      return;
+   writeNodeSet(file);
+   double megabytes = ftell(file) / 1e6;
+   rewind(file);
+
+   OpcUAServer server;
+   server.setBaseConfigDone();
+   OpcUANodeHandler handler(&server);
+   handler.reserveNodes(variableCount + variableCount / variablesPerFolder);
+   OpcUANodeSetLoader loader(&handler);
+
+   bool ok = false;
+   double seconds = runner.time(1, [&](uint64_t) { ok = loader.load(file); });
+   fclose(file);
+   if (!ok) {
+      printf("nodeset load failed: %s\n", loader.getError().c_str());
+      return;
+   }
+
+   size_t nodes = loader.getLoadedNodes().size();
+   runner.report("nodeset/load", nodes, seconds, nodes / seconds, "nodes/s");
+   runner.report("nodeset/parse", 1, seconds, megabytes / seconds, "MB/s");
+}
@@ -0,0 +1,130 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include "OpcUABench.h"
+
+namespace n_opcua {
+namespace bench {
+
+struct BenchEntry {
+   const char *name;
+   BenchFunction fn;
+};
+
+static std::vector<BenchEntry> &benchList() {
+   static std::vector<BenchEntry> list;
+   return list;
+}
+
+BenchRegistration::BenchRegistration(const char *name, BenchFunction fn) {
+   benchList().push_back(BenchEntry {name, fn});
+}
+
+void BenchRunner::report(const std::string &name, uint64_t iterations,
+                         double seconds, double rate,
+                         const std::string &rateUnit) {
+   BenchResult r;
+   r.name = name;
+   r.iterations = iterations;
+   r.nsPerOp = iterations ? seconds * 1e9 / iterations : 0;
+   r.rate = rate;
+   r.rateUnit = rateUnit;
+   results.push_back(r);
+
+   if (json)
+      return;
+   if (rate > 0)
+      printf("%-48s %12llu %14.2f ns/op %14.2f %s\n", r.name.c_str(),
+             (unsigned long long) iterations, r.nsPerOp, rate,
+             rateUnit.c_str());
+   else
+      printf("%-48s %12llu %14.2f ns/op\n", r.name.c_str(),
+             (unsigned long long) iterations, r.nsPerOp);
+   fflush(stdout);
+}
+
+/* print a string as JSON string, the names are plain ASCII */
+static void writeJsonString(FILE *out, const std::string &str) {
+   fputc('"', out);
+   for (size_t i = 0; i < str.size(); i++) {
+      unsigned char c = (unsigned char) str[i];
+      if (c == '"' || c == '\\')
+         fprintf(out, "\\%c", c);
+      else if (c < 0x20)
+         fprintf(out, "\\u%04x", c);
+      else
+         fputc(c, out);
+   }
+   fputc('"', out);
+}
+
+/* JSON has no inf or nan, such a result is written as null */
+static void writeJsonNumber(FILE *out, double value) {
+   if (std::isfinite(value))
+      fprintf(out, "%.3f", value);
+   else
+      fprintf(out, "null");
+}
+
+void BenchRunner::writeJson(FILE *out) {
+   fprintf(out, "{\n  \"results\": [");
+   for (size_t i = 0; i < results.size(); i++) {
+      const BenchResult &r = results[i];
+      fprintf(out, "%s\n    {\"name\": ", i ? "," : "");
+      writeJsonString(out, r.name);
+      fprintf(out, ", \"iterations\": %llu, \"ns_per_op\": ",
+              (unsigned long long) r.iterations);
+      writeJsonNumber(out, r.nsPerOp);
+      if (r.rate > 0) {
+         fprintf(out, ", \"rate\": ");
+         writeJsonNumber(out, r.rate);
+         fprintf(out, ", \"rate_unit\": ");
+         writeJsonString(out, r.rateUnit);
+      }
+      fprintf(out, "}");
+   }
+   fprintf(out, "\n  ]\n}\n");
+   fflush(out);
+}
+
+} /* namespace bench */
+} /* namespace n_opcua */
+
+using namespace n_opcua::bench;
+
+/*
+ * usage: opcuawrap_bench [--json] [filter]
+ * Runs all benchmarks whose name contains filter, --json prints the results
+ * as one JSON document to compare them between releases
+ */
+int main(int argc, char **argv) {
+   const char *filter = "";
+   bool json = false;
+
+   for (int i = 1; i < argc; i++) {
+      if (strcmp(argv[i], "--json") == 0)
+         json = true;
+      else
+         filter = argv[i];
+   }
+   BenchRunner runner(json);
+
+   for (size_t i = 0; i < benchList().size(); i++) {
+      if (!strstr(benchList()[i].name, filter))
+         continue;
+      benchList()[i].fn(runner);
+   }
+
+   if (json)
+      runner.writeJson(stdout);
+
+   return 0;
+}
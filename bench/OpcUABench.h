@@ -0,0 +1,131 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#ifndef BENCH_OPCUABENCH_H_
+#define BENCH_OPCUABENCH_H_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+namespace n_opcua {
+namespace bench {
+
+/**
+ * @brief Keep the compiler from optimizing a value away
+ * @param value the value to keep
+ */
+template <typename T>
+inline void doNotOptimize(T const &value) {
+   asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * @brief The result of one measured case
+ */
+struct BenchResult {
+   /* name of the case, e.g. "nodeindex/string/1000" */
+   std::string name;
+   /* how often the operation ran */
+   uint64_t iterations;
+   /* the mean time per operation */
+   double nsPerOp;
+   /* an optional throughput, e.g. MB/s, 0 if not given */
+   double rate;
+   /* the unit of the throughput */
+   std::string rateUnit;
+};
+
+class BenchRunner {
+private:
+   std::vector<BenchResult> results;
+   /* print the results as JSON at the end instead of a table per case */
+   bool json;
+
+public:
+   BenchRunner(bool jsonOutput = false) : json(jsonOutput) {}
+
+   /**
+    * @brief Time an operation without recording it
+    * @param iterations how often to call op, op gets the iteration number
+    * @param op the operation to time
+    * @return the elapsed time in seconds
+    */
+   template <typename F>
+   static double time(uint64_t iterations, F op) {
+      std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+      for (uint64_t i = 0; i < iterations; i++)
+         op(i);
+      std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+      return elapsed.count();
+   }
+
+   /**
+    * @brief Time an operation and record it
+    * @param name the name of the case
+    * @param iterations how often to call op, op gets the iteration number
+    * @param op the operation to time
+    * @return the elapsed time in seconds
+    */
+   template <typename F>
+   double measure(const std::string &name, uint64_t iterations, F op) {
+      double seconds = time(iterations, op);
+      report(name, iterations, seconds);
+      return seconds;
+   }
+
+   /**
+    * @brief Record a case which was timed by the benchmark itself
+    * @param name the name of the case
+    * @param iterations how often the operation ran
+    * @param seconds the elapsed time for all iterations
+    * @param rate an optional throughput
+    * @param rateUnit the unit of the throughput
+    */
+   void report(const std::string &name, uint64_t iterations, double seconds,
+               double rate = 0, const std::string &rateUnit = "");
+
+   /**
+    * @brief Print all recorded results as a JSON document
+    * @param out the stream to print to
+    */
+   void writeJson(FILE *out);
+
+   /**
+    * @brief Return all recorded results
+    */
+   const std::vector<BenchResult> &getResults() {
+      return results;
+   }
+};
+
+typedef void (*BenchFunction)(BenchRunner &runner);
+
+/**
+ * @brief Adds a benchmark to the global list on construction
+ */
+struct BenchRegistration {
+   BenchRegistration(const char *name, BenchFunction fn);
+};
+
+} /* namespace bench */
+} /* namespace n_opcua */
+
+/**
+ * Define a benchmark, the body gets a BenchRunner named runner
+ */
+#define OPCUA_BENCH(name)                                                  \
+   static void name(n_opcua::bench::BenchRunner &runner);                  \
+   static n_opcua::bench::BenchRegistration name##Registration(#name, name); \
+   static void name(n_opcua::bench::BenchRunner &runner)
+
+#endif /* BENCH_OPCUABENCH_H_ */
@@ -0,0 +1,119 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include <unordered_map>
+
+#include "OpcUABench.h"
+#include "OpcUANodeHandler.h"
+
+using namespace n_opcua;
+using namespace n_opcua::bench;
+
+/* 100 devices of 10 groups of 100 tags, 101101 browse paths */
+static const size_t deviceCount = 100;
+static const size_t groupCount = 10;
+static const size_t tagCount = 100;
+static const size_t lookupCount = 1024;
+
+static OpcUANodeContext *addNode(OpcUANodeHandler *handler,
+                                 OpcUANodeContext *parent,
+                                 const std::string &name) {
+   OpcUANodeContext *ctx = new (handler) OpcUAObjectNodeContext(handler);
+   ctx->setQualifiedName(name);
+   if (parent)
+      parent->addChild(ctx);
+   return ctx;
+}
+
+/* the name walk the lookup had to do before the index */
+static OpcUANodeContext *walkPath(OpcUANodeContext *root,
+                                  const std::string &path) {
+   OpcUANodeContext *ctx = root;
+   size_t pos = path.find('/');
+   while (ctx && pos != std::string::npos) {
+      size_t end = path.find('/', pos + 1);
+      std::string name = path.substr(pos + 1, end - pos - 1);
+      OpcUANodeContext *next = nullptr;
+      for (OpcUANodeContext *child : ctx->getChildren()) {
+         const UA_String *qn = &child->getQualifiedName()->name;
+         if (qn->length == name.size() &&
+             name.compare(0, name.size(),
+                          reinterpret_cast<const char *>(qn->data),
+                          qn->length) == 0) {
+            next = child;
+            break;
+         }
+      }
+      ctx = next;
+      pos = end;
+   }
+   return ctx;
+}
+
+OPCUA_BENCH(benchPathIndex) {
+   OpcUAServer server;
+   OpcUANodeHandler handler(&server);
+   std::unordered_map<std::string, OpcUANodeContext *> flat;
+   std::vector<std::string> paths;
+
+   double buildSeconds = runner.time(1, [&](uint64_t) {
+      OpcUANodeContext *root = addNode(&handler, nullptr, "Plant");
+      for (size_t d = 0; d < deviceCount; d++) {
+         OpcUANodeContext *device =
+               addNode(&handler, root, "D" + std::to_string(d));
+         for (size_t g = 0; g < groupCount; g++) {
+            OpcUANodeContext *group =
+                  addNode(&handler, device, "G" + std::to_string(g));
+            for (size_t t = 0; t < tagCount; t++)
+               addNode(&handler, group, "T" + std::to_string(t));
+         }
+      }
+   });
+   size_t nodes = 1 + deviceCount * (1 + groupCount * (1 + tagCount));
+   runner.report("pathindex/build", nodes, buildSeconds, nodes / buildSeconds,
+                 "nodes/s");
+
+   OpcUANodeContext *root = nullptr;
+   handler.findNodeByPath("Plant", &root);
+   for (size_t i = 0; i < lookupCount; i++) {
+      size_t d = (i * 37) % deviceCount;
+      size_t g = (i * 7) % groupCount;
+      size_t t = (i * 53) % tagCount;
+      paths.push_back("Plant/D" + std::to_string(d) + "/G" +
+                      std::to_string(g) + "/T" + std::to_string(t));
+   }
+   for (const std::string &path : paths)
+      flat[path] = walkPath(root, path);
+
+   runner.measure("pathindex/walk", 20000, [&](uint64_t i) {
+      doNotOptimize(walkPath(root, paths[i % lookupCount]));
+   });
+   runner.measure("pathindex/hashmap", 1000000, [&](uint64_t i) {
+      doNotOptimize(flat.find(paths[i % lookupCount])->second);
+   });
+   runner.measure("pathindex/trie", 1000000, [&](uint64_t i) {
+      OpcUANodeContext *ctx = nullptr;
+      handler.findNodeByPath(paths[i % lookupCount], &ctx);
+      doNotOptimize(ctx);
+   });
+
+   std::vector<OpcUANodeContext *> found;
+   runner.measure("pathindex/prefix-group", 100000, [&](uint64_t i) {
+      found.clear();
+      handler.findNodesByPathPrefix(
+            "Plant/D" + std::to_string(i % deviceCount) + "/G3/", &found);
+      doNotOptimize(found.data());
+   });
+   runner.measure("pathindex/prefix-devices", 10000, [&](uint64_t) {
+      found.clear();
+      handler.findNodesByPathPrefix("Plant/D4", &found);
+      doNotOptimize(found.data());
+   });
+
+   handler.deleteAllNodes();
+}
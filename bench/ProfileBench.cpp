@@ -0,0 +1,152 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include <open62541/ua_config_default.h>
+#include <open62541/ua_client_highlevel.h>
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include "OpcUABench.h"
+#include "OpcUANodeHandler.h"
+
+using namespace n_opcua;
+using namespace n_opcua::bench;
+
+/* the doubles of a scalar, an array and a bulk read */
+static const size_t elementCounts[] = {1, 8192, 131072};
+static const uint64_t roundTrips = 200;
+static const uint32_t clientTimeout = 2000;
+
+/* a variable of the samples served by the handler */
+static OpcUAVarNodeContext *createArray(OpcUANodeHandler *handler,
+                                        const std::vector<double> *samples) {
+   OpcUAVarNodeContext *ctx = new OpcUAVarNodeContext(handler);
+   std::string name = "profile.array" + std::to_string(samples->size());
+   ctx->setNamespace(1);
+   ctx->setName(name);
+   ctx->setQualifiedName(name);
+   ctx->setDataType(0.0);
+   ctx->setReadable(true);
+   ctx->setReadMethodSimple([ctx, samples](UA_DataValue *value) {
+      value->hasValue = ctx->convertToOPC(&value->value, samples->data(),
+                                          samples->size());
+      return value->hasValue;
+   });
+   return ctx;
+}
+
+/* the reads of a client over loopback from a server running in its own
+ * thread, negative if the client failed */
+static double clientReads(uint16_t port, const OpcUAServerLimits &limits,
+                          const UA_NodeId *node, BenchRunner &runner) {
+   UA_ClientConfig config = UA_ClientConfig_default;
+   config.timeout = clientTimeout;
+   config.localConnectionConfig.sendBufferSize = limits.recvBufferSize;
+   config.localConnectionConfig.recvBufferSize = limits.sendBufferSize;
+   config.localConnectionConfig.maxMessageSize = limits.maxMessageSize;
+   config.localConnectionConfig.maxChunkCount = limits.maxChunkCount;
+   UA_Client *client = UA_Client_new(config);
+   if (!client)
+      return -1;
+
+   std::string url = "opc.tcp://localhost:" + std::to_string(port);
+   UA_StatusCode ret = UA_Client_connect(client, url.c_str());
+   double seconds = -1;
+   if (ret == UA_STATUSCODE_GOOD) {
+      seconds = runner.time(roundTrips, [&](uint64_t) {
+         if (ret != UA_STATUSCODE_GOOD)
+            return;
+         UA_Variant value;
+         ret = UA_Client_readValueAttribute(client, *node, &value);
+         doNotOptimize(value.data);
+         UA_Variant_deleteMembers(&value);
+      });
+   }
+   if (ret != UA_STATUSCODE_GOOD) {
+      fprintf(stderr, "profile: read from %s failed: 0x%08x\n", url.c_str(),
+              (unsigned) ret);
+      seconds = -1;
+   }
+
+   UA_Client_disconnect(client);
+   UA_Client_delete(client);
+   return seconds;
+}
+
+/* read round trips of growing size against servers set up with each preset */
+OPCUA_BENCH(benchProfile) {
+   const struct {
+      const char *name;
+      OpcServerProfile profile;
+   } profiles[] = {{"default", ProfileDefault},
+                   {"lowlatency", ProfileLowLatency},
+                   {"highfanout", ProfileHighFanOut},
+                   {"lowmemory", ProfileLowMemory}};
+   const size_t cases = sizeof(elementCounts) / sizeof(elementCounts[0]);
+
+   for (size_t i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+      const char *name = profiles[i].name;
+      uint16_t port = (uint16_t) (4850 + i);
+      OpcUAServer server(port);
+      /* reads depend on the transport limits, which every build applies */
+      if (!server.setProfile(profiles[i].profile))
+         fprintf(stderr, "profile: %s applied without its subscription "
+                 "limits\n", name);
+      server.setBaseConfigDone();
+      OpcUAServerLimits limits = server.getLimits();
+      double bufferMB = limits.bufferMemory() / (1024.0 * 1024.0);
+
+      OpcUANodeHandler handler(&server);
+      std::vector<std::vector<double>> samples(cases);
+      std::vector<OpcUAVarNodeContext *> arrays(cases, nullptr);
+      for (size_t c = 0; c < cases; c++) {
+         samples[c].assign(elementCounts[c], 1.0);
+         arrays[c] = createArray(&handler, &samples[c]);
+         if (!handler.addVariableCallbackNodeDataSourceToServer(arrays[c])) {
+            fprintf(stderr, "profile: adding %zu doubles failed\n",
+                    elementCounts[c]);
+            arrays[c] = nullptr;
+         }
+      }
+
+      if (!server.startup()) {
+         fprintf(stderr, "profile: server on port %u not started\n",
+                 (unsigned) port);
+         continue;
+      }
+      std::atomic<bool> serving(true);
+      std::thread loop([&] {
+         while (serving)
+            server.iterate(true);
+      });
+
+      for (size_t c = 0; c < cases; c++) {
+         size_t bytes = elementCounts[c] * sizeof(double);
+         uint64_t chunks = (bytes + limits.sendBufferSize - 1) /
+                           limits.sendBufferSize;
+         /* the server would refuse to send such a response */
+         if (!arrays[c] ||
+             (limits.maxMessageSize && bytes > limits.maxMessageSize) ||
+             (limits.maxChunkCount && chunks > limits.maxChunkCount))
+            continue;
+
+         double seconds = clientReads(port, limits, arrays[c]->getNodeId(),
+                                      runner);
+         if (seconds < 0)
+            break;
+         runner.report(std::string("profile/") + name + "/" +
+                       std::to_string(bytes), roundTrips, seconds,
+                       bufferMB, "MB buffers");
+      }
+
+      serving = false;
+      loop.join();
+      server.shutdown();
+   }
+}
@@ -0,0 +1,57 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include "OpcUABench.h"
+#include "OpcUANodeHandler.h"
+
+using namespace n_opcua;
+using namespace n_opcua::bench;
+
+/* a spectrum tag changing in a few small windows per cycle */
+static const size_t spectrumSize = 100000;
+static const size_t windowSize = 64;
+static const size_t windowsPerCycle = 4;
+
+/* the first element of a window, two windows of a cycle overlap */
+static size_t windowStart(uint64_t cycle, size_t window) {
+   size_t start = (cycle * 7919 + window * 1237) % (spectrumSize - windowSize);
+   if (window == 1)
+      start = windowStart(cycle, 0) + windowSize / 2;
+   return std::min(start, spectrumSize - windowSize);
+}
+
+OPCUA_BENCH(benchRangeUpdate) {
+   const uint64_t cycles = 20000;
+   std::vector<double> window(windowSize, 2.0);
+
+   OpcUAServer server;
+   OpcUANodeHandler handler(&server);
+
+   OpcUAVarNodeContext *whole = new OpcUAVarNodeContext(&handler);
+   std::vector<double> spectrum(spectrumSize, 1.0);
+   whole->publishValue(spectrum);
+   runner.measure("rangeupdate/whole", cycles, [&](uint64_t cycle) {
+      for (size_t w = 0; w < windowsPerCycle; w++) {
+         size_t start = windowStart(cycle, w);
+         std::copy(window.begin(), window.end(), spectrum.begin() + start);
+      }
+      whole->publishValue(spectrum);
+   });
+
+   OpcUAVarNodeContext *ranged = new OpcUAVarNodeContext(&handler);
+   ranged->publishValue(spectrum);
+   runner.measure("rangeupdate/ranges", cycles, [&](uint64_t cycle) {
+      for (size_t w = 0; w < windowsPerCycle; w++) {
+         size_t start = windowStart(cycle, w);
+         ranged->updateRange(start, window.data(), windowSize);
+      }
+      ranged->publishRanges();
+   });
+
+   handler.deleteAllNodes();
+}
@@ -0,0 +1,82 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include <thread>
+#include <atomic>
+#include "OpcUABench.h"
+#include "OpcUANodeHandler.h"
+
+using namespace n_opcua;
+using namespace n_opcua::bench;
+
+/* a fieldbus query, shortened from the 5 ms of the real one */
+static const std::chrono::microseconds queryTime(200);
+static const unsigned clientCount = 8;
+static const uint64_t readsPerClient = 500;
+
+static void readTag(OpcUAVarNodeContext *tag) {
+   UA_DataValue value;
+   UA_DataValue_init(&value);
+   OpcUANodeHandler::readCallback(nullptr, nullptr, nullptr, nullptr, tag,
+                                  true, nullptr, &value);
+   doNotOptimize(value.value.data);
+   UA_DataValue_deleteMembers(&value);
+}
+
+OPCUA_BENCH(benchReadMemo) {
+   OpcUANodeHandler handler;
+   OpcUAVarNodeContext *tag = new OpcUAVarNodeContext(&handler);
+   std::atomic<uint64_t> queries(0);
+   double sample = 1.0;
+
+   tag->setReadMethodSimple([&](UA_DataValue *value) {
+      std::chrono::steady_clock::time_point end =
+            std::chrono::steady_clock::now() + queryTime;
+      while (std::chrono::steady_clock::now() < end)
+         ;
+      queries.fetch_add(1, std::memory_order_relaxed);
+      tag->convertToOPC(value, &sample);
+      return true;
+   });
+
+   /* several clients sampling the tag at the same time */
+   const struct {
+      const char *name;
+      std::chrono::nanoseconds maxAge;
+   } modes[] = {{"readmemo/off", std::chrono::nanoseconds(0)},
+                {"readmemo/coalesce", std::chrono::nanoseconds(1)},
+                {"readmemo/ttl-10ms", std::chrono::milliseconds(10)}};
+
+   for (const auto &mode : modes) {
+      tag->setReadMaxAge(mode.maxAge);
+      queries.store(0);
+      double seconds = runner.time(1, [&](uint64_t) {
+         std::vector<std::thread> clients;
+         for (unsigned c = 0; c < clientCount; c++) {
+            clients.push_back(std::thread([&] {
+               for (uint64_t i = 0; i < readsPerClient; i++)
+                  readTag(tag);
+            }));
+         }
+         for (size_t c = 0; c < clients.size(); c++)
+            clients[c].join();
+      });
+
+      uint64_t reads = clientCount * readsPerClient;
+      runner.report(mode.name, reads, seconds,
+                    1000.0 * queries.load() / reads, "queries/kread");
+   }
+
+   tag->setReadMaxAge(std::chrono::milliseconds(10));
+   readTag(tag);
+   runner.measure("readmemo/hit", 1000000, [&](uint64_t) {
+      readTag(tag);
+   });
+
+   handler.deleteAllNodes();
+}
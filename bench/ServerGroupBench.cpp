@@ -0,0 +1,74 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include <thread>
+#include "OpcUABench.h"
+#include "OpcUAServerGroup.h"
+
+using namespace n_opcua;
+using namespace n_opcua::bench;
+
+static const size_t tagCount = 1000;
+static const uint64_t readsPerShard = 1000000;
+
+/* the reads the loop of one shard does for its clients */
+static void shardReads(const std::vector<OpcUAVarNodeContext *> *tags) {
+   for (uint64_t i = 0; i < readsPerShard; i++) {
+      UA_DataValue value;
+      UA_DataValue_init(&value);
+      OpcUANodeHandler::readCallback(nullptr, nullptr, nullptr, nullptr,
+                                     (*tags)[i % tagCount], true, nullptr,
+                                     &value);
+      doNotOptimize(value.value.data);
+      UA_DataValue_deleteMembers(&value);
+   }
+}
+
+OPCUA_BENCH(benchServerGroup) {
+   const size_t shardCounts[] = {1, 2, 4, 8};
+
+   for (size_t shardCount : shardCounts) {
+      OpcUAServerGroup group(shardCount, 14840);
+      group.setBaseConfigDone();
+      OpcUANodeHandler handler(group.getPrimary());
+      group.attach(&handler);
+
+      std::vector<OpcUAVarNodeContext *> tags;
+      for (size_t i = 0; i < tagCount; i++) {
+         OpcUAVarNodeContext *tag = new (&handler) OpcUAVarNodeContext(&handler);
+         tag->setName("Tag" + std::to_string(i));
+         tag->setReadable(true);
+         tag->publishValue((double) i);
+         tags.push_back(tag);
+      }
+
+      std::string shards = std::to_string(shardCount);
+      double addSeconds = runner.time(tagCount, [&](uint64_t i) {
+         handler.addNodeToServer(tags[i]);
+      });
+      runner.report("servergroup/add/" + shards, tagCount, addSeconds,
+                    tagCount / addSeconds, "nodes/s");
+
+      /* one publish is seen by all shards */
+      runner.measure("servergroup/publish/" + shards, 200000,
+                     [&](uint64_t i) {
+         tags[i % tagCount]->publishValue((double) i);
+      });
+
+      double readSeconds = runner.time(1, [&](uint64_t) {
+         std::vector<std::thread> loops;
+         for (size_t s = 0; s < shardCount; s++)
+            loops.push_back(std::thread(shardReads, &tags));
+         for (size_t s = 0; s < loops.size(); s++)
+            loops[s].join();
+      });
+      uint64_t reads = shardCount * readsPerShard;
+      runner.report("servergroup/read/" + shards, reads, readSeconds,
+                    reads / readSeconds, "reads/s");
+   }
+}
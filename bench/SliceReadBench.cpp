@@ -0,0 +1,83 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include <cmath>
+#include "OpcUABench.h"
+#include "OpcUANodeHandler.h"
+
+using namespace n_opcua;
+using namespace n_opcua::bench;
+
+/* one client read of an index range through the datasource */
+static void readRange(OpcUAVarNodeContext *ctx, UA_NumericRange *range) {
+   UA_DataValue value;
+   UA_DataValue_init(&value);
+   OpcUANodeHandler::readCallback(nullptr, nullptr, nullptr, nullptr, ctx,
+                                  false, range, &value);
+   doNotOptimize(value.value.data);
+   UA_DataValue_deleteMembers(&value);
+}
+
+/* reads of 16 elements from the middle of arrays of growing size, once sliced
+ * after converting the whole array and once converting only the slice */
+OPCUA_BENCH(benchSliceRead) {
+   const size_t sizes[] = {1000, 100000, 1000000, 10000000};
+   /* elements copied by the whole array reads per case */
+   const uint64_t elements = 100000000;
+
+   OpcUAServer server;
+   OpcUANodeHandler handler(&server);
+
+   for (size_t size : sizes) {
+      std::vector<double> samples(size, 1.0);
+      std::string suffix = "/" + std::to_string(size);
+
+      UA_NumericRangeDimension line = {(UA_UInt32) size / 2,
+                                       (UA_UInt32) size / 2 + 15};
+      UA_NumericRange range = {1, &line};
+
+      OpcUAVarNodeContext *whole = new OpcUAVarNodeContext(&handler);
+      whole->setReadMethodSimple([whole, &samples](UA_DataValue *value) {
+         whole->convertToOPC(&value->value, &samples);
+         value->hasValue = true;
+         return true;
+      });
+      uint64_t calls = std::max<uint64_t>(4, elements / size);
+      runner.measure("slice/whole" + suffix, calls,
+                     [&](uint64_t) { readRange(whole, &range); });
+
+      OpcUAVarNodeContext *sliced = new OpcUAVarNodeContext(&handler);
+      sliced->setReadMethodRange([sliced, &samples](
+            const UA_NumericRange *range, UA_DataValue *value) {
+         return sliced->convertToOPC(&value->value, &samples, range);
+      });
+      runner.measure("slice/range" + suffix, 1000000,
+                     [&](uint64_t) { readRange(sliced, &range); });
+
+      /* a 4x4 block from the middle of a square matrix */
+      std::vector<uint32_t> dims(2, (uint32_t) std::sqrt((double) size));
+      std::vector<double> matrix((size_t) dims[0] * dims[1], 1.0);
+      UA_NumericRangeDimension block[2] = {
+         {dims[0] / 2, dims[0] / 2 + 3},
+         {dims[1] / 2, dims[1] / 2 + 3}
+      };
+      UA_NumericRange blockRange = {2, block};
+
+      OpcUAVarNodeContext *grid = new OpcUAVarNodeContext(&handler);
+      grid->setReadMethodRange([grid, &matrix, &dims](
+            const UA_NumericRange *range, UA_DataValue *value) {
+         return grid->convertToOPC(&value->value, &matrix, dims, range);
+      });
+      runner.measure("slice/range2d" + suffix, 1000000,
+                     [&](uint64_t) { readRange(grid, &blockRange); });
+
+      handler.deleteNode(whole);
+      handler.deleteNode(sliced);
+      handler.deleteNode(grid);
+   }
+}
@@ -0,0 +1,74 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include "OpcUABench.h"
+#include "OpcUANodeHandler.h"
+
+using namespace n_opcua;
+using namespace n_opcua::bench;
+
+/* 100 devices of 10 groups of 100 tags, 101100 nodes */
+static const size_t deviceCount = 100;
+static const size_t groupCount = 10;
+static const size_t tagCount = 100;
+static const size_t treeSize = deviceCount * (1 + groupCount * (1 + tagCount));
+
+static OpcUAObjectNodeContext *buildTree(OpcUANodeHandler *handler) {
+   OpcUAObjectNodeContext *root = new (handler) OpcUAObjectNodeContext(handler);
+   root->setName("Plant");
+
+   for (size_t d = 0; d < deviceCount; d++) {
+      OpcUAObjectNodeContext *device =
+            new (handler) OpcUAObjectNodeContext(handler);
+      std::string deviceName = "Plant.D" + std::to_string(d);
+      device->setName(deviceName);
+      root->addChild(device);
+
+      for (size_t g = 0; g < groupCount; g++) {
+         OpcUAObjectNodeContext *group =
+               new (handler) OpcUAObjectNodeContext(handler);
+         std::string groupName = deviceName + ".G" + std::to_string(g);
+         group->setName(groupName);
+         device->addChild(group);
+
+         for (size_t t = 0; t < tagCount; t++) {
+            OpcUAVarNodeContext *tag =
+                  new (handler) OpcUAVarNodeContext(handler);
+            tag->setName(groupName + ".T" + std::to_string(t));
+            group->addChild(tag);
+         }
+      }
+   }
+   return root;
+}
+
+OPCUA_BENCH(benchTeardown) {
+   const int rounds = 5;
+   double allSeconds = 0;
+   double subtreeSeconds = 0;
+
+   OpcUAServer server;
+   for (int r = 0; r < rounds; r++) {
+      OpcUANodeHandler handler(&server);
+      buildTree(&handler);
+      allSeconds += runner.time(1, [&](uint64_t) {
+         handler.deleteAllNodes();
+      });
+
+      OpcUAObjectNodeContext *root = buildTree(&handler);
+      subtreeSeconds += runner.time(1, [&](uint64_t) {
+         handler.deleteNode(root);
+      });
+   }
+
+   uint64_t nodes = rounds * (treeSize + 1);
+   runner.report("teardown/deleteAllNodes", nodes, allSeconds,
+                 nodes / allSeconds, "nodes/s");
+   runner.report("teardown/deleteNode", nodes, subtreeSeconds,
+                 nodes / subtreeSeconds, "nodes/s");
+}
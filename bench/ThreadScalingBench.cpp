@@ -0,0 +1,70 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include <thread>
+#include <atomic>
+#include "OpcUABench.h"
+#include "OpcUANodeHandler.h"
+
+using namespace n_opcua;
+using namespace n_opcua::bench;
+
+/* worker threads reading cached tags, as the server does with its sessions */
+static const size_t tagCount = 10000;
+static const uint64_t readsPerThread = 2000000;
+
+static void readTags(std::vector<OpcUAVarNodeContext *> *tags) {
+   for (uint64_t i = 0; i < readsPerThread; i++) {
+      UA_DataValue value;
+      UA_DataValue_init(&value);
+      OpcUANodeHandler::readCallback(nullptr, nullptr, nullptr, nullptr,
+                                     (*tags)[i % tagCount], true, nullptr,
+                                     &value);
+      doNotOptimize(value.value.data);
+      UA_DataValue_deleteMembers(&value);
+   }
+}
+
+OPCUA_BENCH(benchThreadScaling) {
+   OpcUAServer server;
+   /* only a multithreading build guards readers against a running producer */
+   bool producing = server.setThreads(8);
+   OpcUANodeHandler handler(&server);
+   std::vector<OpcUAVarNodeContext *> tags;
+
+   for (size_t i = 0; i < tagCount; i++) {
+      OpcUAVarNodeContext *tag = new OpcUAVarNodeContext(&handler);
+      tag->setServer(&server);
+      tag->publishValue((double) i);
+      tags.push_back(tag);
+   }
+
+   for (unsigned n = 1; n <= 8; n *= 2) {
+      std::atomic<bool> done(false);
+      std::thread producer([&]() {
+         for (uint64_t i = 0; producing && !done; i++)
+            tags[i % tagCount]->publishValue((double) i);
+      });
+
+      double seconds = runner.time(1, [&](uint64_t) {
+         std::vector<std::thread> readers;
+         for (unsigned t = 0; t < n; t++)
+            readers.push_back(std::thread(readTags, &tags));
+         for (size_t t = 0; t < readers.size(); t++)
+            readers[t].join();
+      });
+      done = true;
+      producer.join();
+
+      uint64_t reads = n * readsPerThread;
+      runner.report("read/threads=" + std::to_string(n), reads, seconds,
+                    reads / seconds, "reads/s");
+   }
+
+   handler.deleteAllNodes();
+}
@@ -0,0 +1,65 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include "OpcUABench.h"
+#include "OpcUANodeHandler.h"
+
+using namespace n_opcua;
+using namespace n_opcua::bench;
+
+static const uint64_t calls = 10000000;
+/* the reads of one server loop iteration */
+static const size_t batchSize = 10000;
+
+OPCUA_BENCH(benchTimestamp) {
+   runner.measure("timestamp/time", calls, [&](uint64_t) {
+      doNotOptimize(UA_DateTime_fromUnixTime(std::time(nullptr)));
+   });
+   runner.measure("timestamp/now", calls, [&](uint64_t) {
+      doNotOptimize(OpcUAClock::now());
+   });
+   {
+      OpcUAClockCycle cycle;
+      runner.measure("timestamp/cycle", calls, [&](uint64_t) {
+         doNotOptimize(OpcUAClock::cycleNow());
+      });
+   }
+
+   OpcUANodeHandler handler;
+   OpcUAVarNodeContext *tag = new OpcUAVarNodeContext(&handler);
+   double sample = 1.0;
+   tag->setReadMethodSimple([&](UA_DataValue *value) {
+      tag->convertToOPC(value, &sample);
+      return true;
+   });
+
+   const struct {
+      const char *name;
+      bool cached;
+   } modes[] = {{"timestamp/batch/clock", false},
+                {"timestamp/batch/cycle", true}};
+
+   for (const auto &mode : modes) {
+      runner.measure(mode.name, 200, [&](uint64_t) {
+         if (mode.cached)
+            OpcUAClock::beginCycle();
+         for (size_t i = 0; i < batchSize; i++) {
+            UA_DataValue value;
+            UA_DataValue_init(&value);
+            OpcUANodeHandler::readCallback(nullptr, nullptr, nullptr, nullptr,
+                                           tag, true, nullptr, &value);
+            doNotOptimize(value.sourceTimestamp);
+            UA_DataValue_deleteMembers(&value);
+         }
+         if (mode.cached)
+            OpcUAClock::endCycle();
+      });
+   }
+
+   handler.deleteAllNodes();
+}
@@ -0,0 +1,102 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include "OpcUABench.h"
+#include "OpcUANodeHandler.h"
+#include "OpcUATypedMethod.h"
+
+using namespace n_opcua;
+using namespace n_opcua::bench;
+
+static const uint64_t calls = 2000000;
+
+/* a recipe download: a step number, a recipe name and 64 setpoints, the
+ * method itself does next to nothing to show the cost of the arguments */
+OPCUA_BENCH(benchTypedMethod) {
+   OpcUANodeHandler handler;
+   double sink = 0;
+
+   /* decoding by hand in a simple callback, as done so far */
+   OpcUAMethodNodeContext *callback =
+         new (&handler) OpcUAMethodNodeContext(&handler);
+   callback->initInputArguments(3);
+   callback->initInputArgumentType(0, int32_t());
+   callback->initInputArgumentType(1, std::string());
+   callback->initInputArgumentType(2, std::vector<float>());
+   callback->setInputArgumentRank(2, UA_VALUERANK_ONE_DIMENSION);
+   callback->initOutputArguments(1);
+   callback->initOutputArgumentType(0, double());
+   callback->setCallbackSimple([&](size_t inputSize, const UA_Variant *input,
+                                   size_t outputSize, UA_Variant *output) {
+      if (inputSize != 3 || outputSize != 1 ||
+          input[0].type != &UA_TYPES[UA_TYPES_INT32] ||
+          input[1].type != &UA_TYPES[UA_TYPES_STRING] ||
+          input[2].type != &UA_TYPES[UA_TYPES_FLOAT])
+         return false;
+
+      int32_t step;
+      std::string name;
+      callback->convertFromOPC(&step, &input[0]);
+      callback->convertFromOPC(&name, &input[1]);
+      const float *data = static_cast<const float *>(input[2].data);
+      std::vector<float> setpoints(data, data + input[2].arrayLength);
+
+      double result = step + (double) name.size() + setpoints.back();
+      callback->convertToOPC(output, &result);
+      return true;
+   });
+
+   /* the same as typed methods, with views and with copies */
+   OpcUAMethodNodeContext *typedRef = newTypedMethod(&handler,
+         [](int32_t step, OpcUAStringRef name, OpcUAArrayRef<float> setpoints) {
+      return step + (double) name.size() + setpoints[setpoints.size() - 1];
+   });
+   OpcUAMethodNodeContext *typedCopy = newTypedMethod(&handler,
+         [](int32_t step, const std::string &name,
+            const std::vector<float> &setpoints) {
+      return step + (double) name.size() + setpoints[setpoints.size() - 1];
+   });
+
+   int32_t step = 7;
+   UA_String name = UA_STRING((char *) "recipe/extruder/zone-temperatures");
+   std::vector<float> setpoints(64, 180.5f);
+   UA_Variant input[3];
+   UA_Variant_setScalar(&input[0], &step, &UA_TYPES[UA_TYPES_INT32]);
+   UA_Variant_setScalar(&input[1], &name, &UA_TYPES[UA_TYPES_STRING]);
+   UA_Variant_setArray(&input[2], setpoints.data(), setpoints.size(),
+                       &UA_TYPES[UA_TYPES_FLOAT]);
+
+   const struct {
+      const char *name;
+      OpcUAMethodNodeContext *ctx;
+   } methods[] = {
+      {"callback", callback},
+      {"typed/ref", typedRef},
+      {"typed/copy", typedCopy},
+   };
+
+   for (const auto &m : methods) {
+      UA_MethodCallback cb = m.ctx->getMethodCallback();
+      if (!cb)
+         cb = OpcUANodeHandler::onMethodCallCallback;
+      OpcUAMethodNodeContext *ctx = m.ctx;
+
+      runner.measure(std::string("method/recipe/") + m.name, calls,
+                     [&](uint64_t) {
+         UA_Variant output;
+         UA_Variant_init(&output);
+         cb(nullptr, nullptr, nullptr, nullptr, ctx, nullptr, nullptr, 3,
+            input, 1, &output);
+         sink += *static_cast<double *>(output.data);
+         UA_Variant_deleteMembers(&output);
+      });
+   }
+   doNotOptimize(sink);
+
+   handler.deleteAllNodes();
+}
@@ -0,0 +1,105 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include "OpcUABench.h"
+#include "OpcUANodeHandler.h"
+#include "OpcUATypedVar.h"
+
+using namespace n_opcua;
+using namespace n_opcua::bench;
+
+static const uint64_t calls = 2000000;
+
+/* read a variable as the server does, through its data source */
+static void benchRead(BenchRunner &runner, const std::string &name,
+                      OpcUAVarNodeContext *ctx) {
+   UA_DataSource source;
+   if (!ctx->getDataSource(&source))
+      source.read = OpcUANodeHandler::readCallback;
+
+   runner.measure("typed/read/" + name, calls, [&](uint64_t) {
+      UA_DataValue value;
+      UA_DataValue_init(&value);
+      source.read(nullptr, nullptr, nullptr, nullptr, ctx, false, nullptr,
+                  &value);
+      doNotOptimize(value.value.data);
+      UA_DataValue_deleteMembers(&value);
+   });
+}
+
+/* write a variable as the server does, through its data source */
+static void benchWrite(BenchRunner &runner, const std::string &name,
+                       OpcUAVarNodeContext *ctx, const UA_DataValue *value) {
+   UA_DataSource source;
+   if (!ctx->getDataSource(&source))
+      source.write = OpcUANodeHandler::writeCallback;
+
+   runner.measure("typed/write/" + name, calls, [&](uint64_t) {
+      source.write(nullptr, nullptr, nullptr, nullptr, ctx, nullptr, value);
+      doNotOptimize(value);
+   });
+}
+
+/* the same objects bound through simple std::function callbacks and
+ * through OpcUATypedVar */
+OPCUA_BENCH(benchTypedVar) {
+   OpcUANodeHandler handler;
+   double scalar = 1.0;
+   std::atomic<double> atomic(1.0);
+   std::vector<double> vector(256, 1.0);
+
+   OpcUAVarNodeContext *scalarCallback =
+         new (&handler) OpcUAVarNodeContext(&handler);
+   scalarCallback->setReadMethodSimple([&](UA_DataValue *value) {
+      scalarCallback->convertToOPC(value, &scalar);
+      return true;
+   });
+   scalarCallback->setWriteMethodSimple([&](const UA_DataValue *value) {
+      scalarCallback->convertFromOPC(&scalar, value);
+      return true;
+   });
+   OpcUAVarNodeContext *atomicCallback =
+         new (&handler) OpcUAVarNodeContext(&handler);
+   atomicCallback->setReadMethodSimple([&](UA_DataValue *value) {
+      double v = atomic.load(std::memory_order_acquire);
+      atomicCallback->convertToOPC(value, &v);
+      return true;
+   });
+   OpcUAVarNodeContext *vectorCallback =
+         new (&handler) OpcUAVarNodeContext(&handler);
+   vectorCallback->setReadMethodSimple([&](UA_DataValue *value) {
+      vectorCallback->convertToOPC(value, &vector);
+      return true;
+   });
+
+   OpcUAVarNodeContext *scalarTyped =
+         new (&handler) OpcUATypedVar<double>(&handler, &scalar);
+   OpcUAVarNodeContext *atomicTyped =
+         new (&handler) OpcUATypedVar<std::atomic<double> >(&handler,
+                                                            &atomic);
+   OpcUAVarNodeContext *vectorTyped =
+         new (&handler) OpcUATypedVar<std::vector<double> >(&handler,
+                                                            &vector);
+
+   benchRead(runner, "double/callback", scalarCallback);
+   benchRead(runner, "double/typed", scalarTyped);
+   benchRead(runner, "atomic/callback", atomicCallback);
+   benchRead(runner, "atomic/typed", atomicTyped);
+   benchRead(runner, "vector256/callback", vectorCallback);
+   benchRead(runner, "vector256/typed", vectorTyped);
+
+   UA_DataValue written;
+   UA_DataValue_init(&written);
+   double sample = 2.0;
+   scalarCallback->convertToOPC(&written, &sample);
+   benchWrite(runner, "double/callback", scalarCallback, &written);
+   benchWrite(runner, "double/typed", scalarTyped, &written);
+   UA_DataValue_deleteMembers(&written);
+
+   handler.deleteAllNodes();
+}
@@ -0,0 +1,62 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include "OpcUABench.h"
+#include "OpcUANodeHandler.h"
+
+using namespace n_opcua;
+using namespace n_opcua::bench;
+
+/* 20 clients sampling 10k tags each */
+static const size_t tagCount = 10000;
+static const size_t clientCount = 20;
+
+static void sampleAll(std::vector<OpcUAVarNodeContext *> &tags) {
+   for (size_t c = 0; c < clientCount; c++) {
+      for (OpcUAVarNodeContext *tag : tags) {
+         UA_DataValue value;
+         UA_DataValue_init(&value);
+         OpcUANodeHandler::readCallback(nullptr, nullptr, nullptr, nullptr,
+                                        tag, true, nullptr, &value);
+         doNotOptimize(value.value.data);
+         UA_DataValue_deleteMembers(&value);
+      }
+   }
+}
+
+OPCUA_BENCH(benchValueCache) {
+   OpcUAServer server;
+   OpcUANodeHandler handler(&server);
+   std::vector<OpcUAVarNodeContext *> tags;
+   std::vector<double> samples(tagCount, 1.0);
+
+   for (size_t i = 0; i < tagCount; i++) {
+      OpcUAVarNodeContext *tag = new OpcUAVarNodeContext(&handler);
+      double *sample = &samples[i];
+      tag->setReadMethodSimple([tag, sample](UA_DataValue *value) {
+         tag->convertToOPC(value, sample);
+         return true;
+      });
+      tags.push_back(tag);
+   }
+
+   const uint64_t rounds = 10;
+   const uint64_t reads = rounds * tagCount * clientCount;
+
+   double seconds = runner.time(rounds, [&](uint64_t) { sampleAll(tags); });
+   runner.report("read/callback", reads, seconds, reads / seconds, "reads/s");
+
+   runner.measure("publish", rounds * tagCount, [&](uint64_t i) {
+      tags[i % tagCount]->publishValue((double) i);
+   });
+
+   seconds = runner.time(rounds, [&](uint64_t) { sampleAll(tags); });
+   runner.report("read/cached", reads, seconds, reads / seconds, "reads/s");
+
+   handler.deleteAllNodes();
+}
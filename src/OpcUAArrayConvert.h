@@ -0,0 +1,309 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#ifndef SRC_OPCUAARRAYCONVERT_H_
+#define SRC_OPCUAARRAYCONVERT_H_
+
+#include <cstring>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "OpcUATypeTraits.h"
+
+namespace n_opcua {
+
+/**
+ * Bulk conversion of numeric arrays between element types.
+ *
+ * Arrays of the same type are copied with memcpy. Conversions between
+ * different types run a loop per array instead of a call per element, with
+ * SSE2 kernels for the common widening and narrowing cases (float <-> double,
+ * int16 -> int32, int32 -> float/double) where available. Integers convert to
+ * floating point and between each other like static_cast, floating point
+ * values never convert to integers and bool only converts to bool.
+ */
+template <typename D, typename S>
+struct UaElementConvert {
+   /* if S converts to D */
+   static constexpr bool allowed =
+         std::is_arithmetic<D>::value && std::is_arithmetic<S>::value &&
+         std::is_same<D, bool>::value == std::is_same<S, bool>::value &&
+         !(std::is_floating_point<S>::value && std::is_integral<D>::value);
+
+   static void run(D *dst, const S *src, size_t count) {
+      for (size_t i = 0; i < count; i++)
+         dst[i] = static_cast<D>(src[i]);
+   }
+};
+
+template <typename T>
+struct UaElementConvert<T, T> {
+   static constexpr bool allowed = std::is_arithmetic<T>::value;
+
+   static void run(T *dst, const T *src, size_t count) {
+      if (count > 0)
+         memcpy(dst, src, count * sizeof(T));
+   }
+};
+
+#if defined(__SSE2__)
+template <>
+struct UaElementConvert<double, float> {
+   static constexpr bool allowed = true;
+
+   static void run(double *dst, const float *src, size_t count) {
+      size_t i = 0;
+      for (; i + 4 <= count; i += 4) {
+         __m128 f = _mm_loadu_ps(src + i);
+         _mm_storeu_pd(dst + i, _mm_cvtps_pd(f));
+         _mm_storeu_pd(dst + i + 2, _mm_cvtps_pd(_mm_movehl_ps(f, f)));
+      }
+      for (; i < count; i++)
+         dst[i] = src[i];
+   }
+};
+
+template <>
+struct UaElementConvert<float, double> {
+   static constexpr bool allowed = true;
+
+   static void run(float *dst, const double *src, size_t count) {
+      size_t i = 0;
+      for (; i + 4 <= count; i += 4) {
+         __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(src + i));
+         __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(src + i + 2));
+         _mm_storeu_ps(dst + i, _mm_movelh_ps(lo, hi));
+      }
+      for (; i < count; i++)
+         dst[i] = static_cast<float>(src[i]);
+   }
+};
+
+template <>
+struct UaElementConvert<int32_t, int16_t> {
+   static constexpr bool allowed = true;
+
+   static void run(int32_t *dst, const int16_t *src, size_t count) {
+      size_t i = 0;
+      for (; i + 8 <= count; i += 8) {
+         __m128i v = _mm_loadu_si128(
+               reinterpret_cast<const __m128i *>(src + i));
+         /* move each value to the upper half and shift it back signed */
+         __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+         __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+         _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), lo);
+         _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 4), hi);
+      }
+      for (; i < count; i++)
+         dst[i] = src[i];
+   }
+};
+
+template <>
+struct UaElementConvert<double, int32_t> {
+   static constexpr bool allowed = true;
+
+   static void run(double *dst, const int32_t *src, size_t count) {
+      size_t i = 0;
+      for (; i + 4 <= count; i += 4) {
+         __m128i v = _mm_loadu_si128(
+               reinterpret_cast<const __m128i *>(src + i));
+         _mm_storeu_pd(dst + i, _mm_cvtepi32_pd(v));
+         _mm_storeu_pd(dst + i + 2, _mm_cvtepi32_pd(_mm_srli_si128(v, 8)));
+      }
+      for (; i < count; i++)
+         dst[i] = src[i];
+   }
+};
+
+template <>
+struct UaElementConvert<float, int32_t> {
+   static constexpr bool allowed = true;
+
+   static void run(float *dst, const int32_t *src, size_t count) {
+      size_t i = 0;
+      for (; i + 4 <= count; i += 4) {
+         __m128i v = _mm_loadu_si128(
+               reinterpret_cast<const __m128i *>(src + i));
+         _mm_storeu_ps(dst + i, _mm_cvtepi32_ps(v));
+      }
+      for (; i < count; i++)
+         dst[i] = static_cast<float>(src[i]);
+   }
+};
+#endif
+
+/**
+ * @brief Convert an array of numbers to another element type
+ * @param dst the array to write
+ * @param src the array to read
+ * @param count the count of elements
+ * @return true if converted, false if S does not convert to D
+ */
+template <typename D, typename S>
+bool convertElements(D *dst, const S *src, size_t count) {
+   if (!UaElementConvert<D, S>::allowed)
+      return false;
+   UaElementConvert<D, S>::run(dst, src, count);
+   return true;
+}
+
+/**
+ * @brief Return the index of a type in UA_TYPES, e.g. UA_TYPES_DOUBLE
+ * @param type the type, it may be a custom type outside of UA_TYPES
+ * @return the index or -1 for types outside of UA_TYPES
+ */
+inline int typeIndexOf(const UA_DataType *type) {
+   /* pointers into other arrays must not be subtracted from UA_TYPES */
+   std::less<const UA_DataType *> before;
+   if (!type || before(type, UA_TYPES) ||
+       !before(type, UA_TYPES + UA_TYPES_COUNT))
+      return -1;
+   return (int) (type - UA_TYPES);
+}
+
+/**
+ * @brief Convert the elements of a open62541 array of any numeric type, the
+ * source type is looked up once for the whole array
+ * @param dst the array to write
+ * @param src the variant to read, a scalar counts as one element
+ * @param count the count of elements to convert
+ * @return true if converted, false if the type does not convert to D
+ */
+template <typename D>
+bool convertElementsFromOPC(D *dst, const UA_Variant *src, size_t count) {
+   const void *data = src->data;
+   switch (typeIndexOf(src->type)) {
+   case UA_TYPES_BOOLEAN:
+      return convertElements(dst, static_cast<const bool *>(data), count);
+   case UA_TYPES_SBYTE:
+      return convertElements(dst, static_cast<const int8_t *>(data), count);
+   case UA_TYPES_BYTE:
+      return convertElements(dst, static_cast<const uint8_t *>(data), count);
+   case UA_TYPES_INT16:
+      return convertElements(dst, static_cast<const int16_t *>(data), count);
+   case UA_TYPES_UINT16:
+      return convertElements(dst, static_cast<const uint16_t *>(data), count);
+   case UA_TYPES_INT32:
+      return convertElements(dst, static_cast<const int32_t *>(data), count);
+   case UA_TYPES_UINT32:
+      return convertElements(dst, static_cast<const uint32_t *>(data), count);
+   case UA_TYPES_INT64:
+      return convertElements(dst, static_cast<const int64_t *>(data), count);
+   case UA_TYPES_UINT64:
+      return convertElements(dst, static_cast<const uint64_t *>(data), count);
+   case UA_TYPES_FLOAT:
+      return convertElements(dst, static_cast<const float *>(data), count);
+   case UA_TYPES_DOUBLE:
+      return convertElements(dst, static_cast<const double *>(data), count);
+   default:
+      return false;
+   }
+}
+
+/* the most dimensions of an array a NumericRange is resolved against */
+static const size_t maxRangeDimensions = 8;
+
+/**
+ * @brief Resolve a NumericRange against the dimensions of an array, the last
+ * index of a dimension is clamped to its length
+ * @param range the range, nullptr for the whole array
+ * @param dims the lengths of the dimensions, in row major order
+ * @param dimsSize the count of dimensions, at most maxRangeDimensions
+ * @param first the returned first index per dimension
+ * @param count the returned element count per dimension
+ * @return UA_STATUSCODE_GOOD or the error of the range
+ */
+inline UA_StatusCode resolveNumericRange(const UA_NumericRange *range,
+                                         const UA_UInt32 *dims,
+                                         size_t dimsSize, size_t *first,
+                                         size_t *count) {
+   if (dimsSize > maxRangeDimensions)
+      return UA_STATUSCODE_BADINDEXRANGEINVALID;
+
+   for (size_t i = 0; i < dimsSize; i++) {
+      first[i] = 0;
+      count[i] = dims[i];
+   }
+   if (!range)
+      return UA_STATUSCODE_GOOD;
+
+   if (range->dimensionsSize != dimsSize)
+      return UA_STATUSCODE_BADINDEXRANGEINVALID;
+
+   for (size_t i = 0; i < dimsSize; i++) {
+      size_t min = range->dimensions[i].min;
+      size_t max = range->dimensions[i].max;
+      if (min > max)
+         return UA_STATUSCODE_BADINDEXRANGEINVALID;
+      if (min >= dims[i])
+         return UA_STATUSCODE_BADINDEXRANGENODATA;
+      if (max >= dims[i])
+         max = dims[i] - 1;
+
+      first[i] = min;
+      count[i] = max - min + 1;
+   }
+   return UA_STATUSCODE_GOOD;
+}
+
+/**
+ * @brief Copy a slice of a row major multidimensional array to a dense array,
+ * converting the elements on the way. The innermost dimension is copied in
+ * runs, only the elements of the slice are touched.
+ * @param dst the array to write, the product of count elements long
+ * @param src the whole array to read
+ * @param dims the lengths of the dimensions of src
+ * @param dimsSize the count of dimensions, at least one
+ * @param first the first index per dimension, see resolveNumericRange()
+ * @param count the element count per dimension
+ * @return true if copied, false if S does not convert to D
+ */
+template <typename D, typename S>
+bool convertSlice(D *dst, const S *src, const UA_UInt32 *dims,
+                  size_t dimsSize, const size_t *first, const size_t *count) {
+   if (!UaElementConvert<D, S>::allowed)
+      return false;
+
+   size_t last = dimsSize - 1;
+   size_t rows = 1;
+   for (size_t i = 0; i < last; i++)
+      rows *= count[i];
+   if (rows == 0 || count[last] == 0)
+      return true;
+
+   /* the stride of each dimension in src */
+   size_t stride[maxRangeDimensions];
+   stride[last] = 1;
+   for (size_t i = last; i > 0; i--)
+      stride[i - 1] = stride[i] * dims[i];
+
+   /* walk the outer dimensions like an odometer */
+   size_t index[maxRangeDimensions] = {0};
+   for (size_t row = 0; row < rows; row++) {
+      size_t offset = first[last];
+      for (size_t i = 0; i < last; i++)
+         offset += (first[i] + index[i]) * stride[i];
+      UaElementConvert<D, S>::run(dst, src + offset, count[last]);
+      dst += count[last];
+
+      for (size_t i = last; i > 0; i--) {
+         if (++index[i - 1] < count[i - 1])
+            break;
+         index[i - 1] = 0;
+      }
+   }
+   return true;
+}
+
+} /* namespace n_opcua */
+
+#endif /* SRC_OPCUAARRAYCONVERT_H_ */
@@ -0,0 +1,106 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#ifndef SRC_OPCUABORROWEDARRAY_H_
+#define SRC_OPCUABORROWEDARRAY_H_
+
+#include <atomic>
+#include <vector>
+#include <type_traits>
+#include "OpcUANodeContext.h"
+
+namespace n_opcua {
+
+/**
+ * Double buffered array which is read by the server without copying.
+ *
+ * The server is lent the front buffer, while the producer fills the back
+ * buffer and publishes it. A published buffer becomes the back buffer again
+ * only after the server finished the loop iteration it could have been read
+ * in (see OpcUAServer::epochPassed()), so the server never encodes from memory
+ * that is being written.
+ *
+ * beginUpdate()/publish() may be called from any single producer thread,
+ * lend() is called from the server thread. Called from within the server
+ * thread, beginUpdate() fails until the current iteration is done.
+ */
+template <typename T>
+class OpcUABorrowedArray {
+   static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value,
+                 "Only numeric types share their memory layout with open62541");
+private:
+   OpcUAServer *server;
+   std::vector<T> buffers[2];
+   /* index of the buffer lent to the server */
+   std::atomic<unsigned> front;
+   /* if the back buffer was lent before, and in which epoch last */
+   bool backLent;
+   uint64_t backEpoch;
+
+public:
+   /**
+    * @brief Constructor for this class
+    * @param serv The server the buffers are lent to
+    * @param length The initial element count of both buffers
+    */
+   OpcUABorrowedArray(OpcUAServer *serv, size_t length = 0):
+      server(serv), front(0), backLent(false), backEpoch(0) {
+      buffers[0].resize(length);
+      buffers[1].resize(length);
+   }
+
+   /**
+    * @brief Return the back buffer to write the next value to
+    * @return the back buffer or nullptr, if the server may still encode from
+    * it, try again later in that case
+    */
+   std::vector<T> *beginUpdate() {
+      if (backLent && !server->epochPassed(backEpoch))
+         return nullptr;
+      return &buffers[front.load(std::memory_order_relaxed) ^ 1];
+   }
+
+   /**
+    * @brief Lend the back buffer to the server, the former front buffer
+    * becomes the back buffer
+    */
+   void publish() {
+      front.store(front.load(std::memory_order_relaxed) ^ 1,
+                  std::memory_order_seq_cst);
+      /* a reader which still got the old front is in this epoch or before */
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      backEpoch = server->getEpoch();
+      backLent = true;
+   }
+
+   /**
+    * @brief Lend the front buffer, use this as borrowed read method
+    * @param buffer the buffer description to fill
+    * @return always true
+    */
+   bool lend(OpcUABorrowedBuffer *buffer) {
+      const std::vector<T> &f = buffers[front.load(std::memory_order_acquire)];
+      buffer->data = f.data();
+      buffer->length = f.size();
+      buffer->type = UaTypeTraits<T>::dataType();
+      return true;
+   }
+
+   /**
+    * @brief Return a read method lending this array, for
+    * OpcUAVarNodeContext::setReadMethodBorrowed()
+    * @return the read method
+    */
+   OpcUAVarDataSourceReadCallbackBorrowed getReadMethod() {
+      return [this](OpcUABorrowedBuffer *buffer) { return lend(buffer); };
+   }
+};
+
+} /* namespace n_opcua */
+
+#endif /* SRC_OPCUABORROWEDARRAY_H_ */
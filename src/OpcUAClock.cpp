@@ -0,0 +1,34 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include "OpcUAClock.h"
+
+namespace n_opcua {
+
+thread_local UA_DateTime OpcUAClock::cycleTime = 0;
+thread_local unsigned OpcUAClock::cycleDepth = 0;
+
+UA_DateTime OpcUAClock::cycleNow() {
+   if (cycleDepth == 0)
+      return now();
+   if (cycleTime == 0)
+      cycleTime = now();
+   return cycleTime;
+}
+
+void OpcUAClock::beginCycle() {
+   if (cycleDepth++ == 0)
+      cycleTime = 0;
+}
+
+void OpcUAClock::endCycle() {
+   if (cycleDepth > 0)
+      cycleDepth--;
+}
+
+} /* namespace n_opcua */
@@ -0,0 +1,113 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#ifndef SRC_OPCUACLOCK_H_
+#define SRC_OPCUACLOCK_H_
+
+#include <open62541/ua_types.h>
+
+#include <chrono>
+#include <ctime>
+
+namespace n_opcua {
+
+/**
+ * The time source of all timestamps we set, in the 100 ns resolution of
+ * UA_DateTime.
+ *
+ * Inside a cycle, see beginCycle(), cycleNow() reads the clock once, at its
+ * first call, and returns that time for the rest of the cycle. All values
+ * read or published by a thread during one cycle, like the reads of one
+ * server loop iteration, then carry the same timestamp for the cost of a
+ * single clock read. A cycle waiting for network input first does not stamp
+ * its values with the time it began waiting.
+ */
+class OpcUAClock {
+private:
+   /* the first time read in the outermost cycle of this thread, 0 if the
+    * clock was not read in the cycle yet */
+   static thread_local UA_DateTime cycleTime;
+   /* the count of cycles this thread is in */
+   static thread_local unsigned cycleDepth;
+
+public:
+   /**
+    * @brief Read the system clock
+    * @return the current time
+    */
+   static UA_DateTime now() {
+      return fromTimePoint(std::chrono::system_clock::now());
+   }
+
+   /**
+    * @brief Return the time of the cycle of this thread, read at the first
+    * call in the cycle, outside of a cycle the current time
+    */
+   static UA_DateTime cycleNow();
+
+   /**
+    * @brief Begin a cycle of this thread, cycles nest and only the outermost
+    * one reads the clock, at the first cycleNow()
+    */
+   static void beginCycle();
+
+   /**
+    * @brief End the cycle begun last by this thread
+    */
+   static void endCycle();
+
+   /**
+    * @brief Check if this thread is in a cycle
+    */
+   static bool inCycle() {
+      return cycleDepth > 0;
+   }
+
+   /**
+    * @brief Convert a time of the system clock, e.g. the acquisition time of
+    * a value
+    * @param time the time to convert
+    * @return the time in 100 ns since 1601
+    */
+   static UA_DateTime fromTimePoint(std::chrono::system_clock::time_point time) {
+      return UA_DATETIME_UNIX_EPOCH +
+             std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   time.time_since_epoch()).count() / 100;
+   }
+
+   /**
+    * @brief Convert a time in seconds since 1970
+    * @param time the time to convert
+    * @return the time in 100 ns since 1601
+    */
+   static UA_DateTime fromUnixTime(std::time_t time) {
+      return UA_DateTime_fromUnixTime(time);
+   }
+};
+
+/**
+ * A cycle of OpcUAClock for the lifetime of this object, e.g. around
+ * publishing the values of one poll of a PLC.
+ */
+class OpcUAClockCycle {
+public:
+   OpcUAClockCycle() {
+      OpcUAClock::beginCycle();
+   }
+
+   ~OpcUAClockCycle() {
+      OpcUAClock::endCycle();
+   }
+
+   OpcUAClockCycle(const OpcUAClockCycle &) = delete;
+   OpcUAClockCycle &operator=(const OpcUAClockCycle &) = delete;
+};
+
+} /* namespace n_opcua */
+
+#endif /* SRC_OPCUACLOCK_H_ */
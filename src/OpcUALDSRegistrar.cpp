@@ -0,0 +1,204 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include <open62541/ua_config_default.h>
+
+#include <chrono>
+#include <memory>
+
+#include "OpcUALDSRegistrar.h"
+
+namespace n_opcua {
+
+/* a request handed to the server loop, shared as the registration thread
+ * may give up on it before the loop picks it up */
+struct OpcUALDSRequest {
+   std::mutex lock;
+   std::condition_variable changed;
+   bool taken;
+   bool done;
+   bool abandoned;
+   UA_StatusCode status;
+
+   OpcUALDSRequest() :
+      taken(false), done(false), abandoned(false),
+      status(UA_STATUSCODE_GOOD) {}
+};
+
+OpcUALDSRegistrar::OpcUALDSRegistrar(UA_Server *server,
+                                     const OpcUALoopDispatch &dispatch,
+                                     const std::string &ldsServerURI,
+                                     const OpcUALDSOptions &options,
+                                     const OpcUALDSCall &call) :
+   server(server), dispatch(dispatch), uri(ldsServerURI), options(options),
+   call(call),
+   stopping(false), stats() {
+   stats.lastStatus = UA_STATUSCODE_GOOD;
+}
+
+OpcUALDSRegistrar::~OpcUALDSRegistrar() {
+   stop();
+}
+
+bool OpcUALDSRegistrar::start() {
+   if (worker.joinable())
+      return false;
+
+   std::lock_guard<std::mutex> guard(lock);
+   stopping = false;
+   stats.nextDelay = options.firstDelay;
+   worker = std::thread(&OpcUALDSRegistrar::loop, this);
+   return true;
+}
+
+bool OpcUALDSRegistrar::stop() {
+   if (!worker.joinable())
+      return false;
+
+   {
+      std::lock_guard<std::mutex> guard(lock);
+      stopping = true;
+   }
+   changed.notify_all();
+   worker.join();
+
+   /* only a good unregistration leaves a registration good and gone */
+   std::lock_guard<std::mutex> guard(lock);
+   return stats.attempts > 0 && !stats.registered &&
+          stats.lastStatus == UA_STATUSCODE_GOOD;
+}
+
+OpcUALDSStats OpcUALDSRegistrar::getStats() {
+   std::lock_guard<std::mutex> guard(lock);
+   return stats;
+}
+
+UA_StatusCode OpcUALDSRegistrar::callLDS(bool unregister) {
+   UA_Client *client = nullptr;
+   UA_StatusCode ret = UA_STATUSCODE_GOOD;
+
+   /* the client is ours alone, so it connects on our thread */
+   if (!call) {
+      UA_ClientConfig clientConfig = UA_ClientConfig_default;
+      clientConfig.timeout = options.timeout;
+      client = UA_Client_new(clientConfig);
+      if (!client)
+         return UA_STATUSCODE_BADOUTOFMEMORY;
+      ret = UA_Client_connect(client, uri.c_str());
+   }
+
+   if (ret == UA_STATUSCODE_GOOD) {
+      std::shared_ptr<OpcUALDSRequest> request =
+            std::make_shared<OpcUALDSRequest>();
+      UA_Server *target = server;
+      OpcUALDSCall standIn = call;
+      std::string lds = uri;
+      std::function<void()> task = [=] {
+         {
+            std::lock_guard<std::mutex> guard(request->lock);
+            if (request->abandoned)
+               return;
+            request->taken = true;
+         }
+         UA_StatusCode status;
+         if (standIn)
+            status = standIn(lds, unregister);
+         else if (unregister)
+            status = UA_Server_unregister_discovery(target, client);
+         else
+            status = UA_Server_register_discovery(target, client, nullptr);
+
+         std::lock_guard<std::mutex> guard(request->lock);
+         request->status = status;
+         request->done = true;
+         request->changed.notify_all();
+      };
+      if (dispatch)
+         dispatch(task);
+      else
+         task();
+
+      /* a request in progress is bounded by the client timeout */
+      std::unique_lock<std::mutex> guard(request->lock);
+      if (!request->changed.wait_for(guard,
+            std::chrono::milliseconds(options.timeout),
+            [&request] { return request->taken; })) {
+         request->abandoned = true;
+         ret = UA_STATUSCODE_BADTIMEOUT;
+      } else {
+         request->changed.wait(guard, [&request] { return request->done; });
+         ret = request->status;
+      }
+   }
+
+   if (client) {
+      UA_Client_disconnect(client);
+      UA_Client_delete(client);
+   }
+   return ret;
+}
+
+uint32_t OpcUALDSRegistrar::backoff(uint64_t failures) {
+   uint64_t delay = options.minBackoff;
+   for (uint64_t i = 1; i < failures && delay < options.maxBackoff; i++)
+      delay *= 2;
+   if (delay > options.maxBackoff)
+      delay = options.maxBackoff;
+   return (uint32_t) delay;
+}
+
+void OpcUALDSRegistrar::loop() {
+   typedef std::chrono::steady_clock clock;
+
+   std::unique_lock<std::mutex> guard(lock);
+   clock::time_point next = clock::now() +
+                            std::chrono::milliseconds(options.firstDelay);
+
+   while (!changed.wait_until(guard, next, [this] { return stopping; })) {
+      guard.unlock();
+      clock::time_point begin = clock::now();
+      UA_StatusCode ret = callLDS(false);
+      clock::time_point end = clock::now();
+      guard.lock();
+
+      uint64_t latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            end - begin).count();
+      stats.attempts++;
+      stats.lastLatency = latency;
+      stats.totalLatency += latency;
+      if (latency > stats.maxLatency)
+         stats.maxLatency = latency;
+      stats.lastStatus = ret;
+
+      if (ret == UA_STATUSCODE_GOOD) {
+         stats.registrations++;
+         stats.consecutiveFailures = 0;
+         stats.registered = true;
+         stats.nextDelay = options.period;
+      } else {
+         stats.failures++;
+         stats.consecutiveFailures++;
+         stats.registered = false;
+         stats.nextDelay = backoff(stats.consecutiveFailures);
+      }
+      next = end + std::chrono::milliseconds(stats.nextDelay);
+   }
+
+   stats.nextDelay = 0;
+   if (!stats.registered || !options.unregisterOnStop)
+      return;
+
+   guard.unlock();
+   UA_StatusCode ret = callLDS(true);
+   guard.lock();
+   stats.lastStatus = ret;
+   if (ret == UA_STATUSCODE_GOOD)
+      stats.registered = false;
+}
+
+} /* namespace n_opcua */
@@ -0,0 +1,193 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#ifndef SRC_OPCUALDSREGISTRAR_H_
+#define SRC_OPCUALDSREGISTRAR_H_
+
+#include <open62541/ua_server.h>
+#include <open62541/ua_client.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace n_opcua {
+
+/**
+ * The timing of the registration at a local discovery service (LDS), all
+ * times in ms
+ */
+struct OpcUALDSOptions {
+   /* the time from registerAtLDS() to the first registration */
+   uint32_t firstDelay;
+   /* the time between two successful registrations */
+   uint32_t period;
+   /* the time until the retry of a failed registration, doubled with each
+    * further failure up to maxBackoff */
+   uint32_t minBackoff;
+   uint32_t maxBackoff;
+   /* the time a connect or request to the LDS may take */
+   uint32_t timeout;
+   /* if the server unregisters when the registration stops */
+   bool unregisterOnStop;
+
+   /**
+    * @brief Constructor for the defaults: first registration after 500 ms,
+    * then every 10 minutes, retries after 1 s up to 5 minutes
+    */
+   OpcUALDSOptions() :
+      firstDelay(500), period(10 * 60 * 1000), minBackoff(1000),
+      maxBackoff(5 * 60 * 1000), timeout(2000), unregisterOnStop(true) {}
+};
+
+/**
+ * The course of the registration at a LDS so far, the latencies in ns
+ */
+struct OpcUALDSStats {
+   uint64_t attempts;
+   uint64_t registrations;
+   uint64_t failures;
+   /* failures since the last registration, deciding the backoff */
+   uint64_t consecutiveFailures;
+   /* the status of the last registration or unregistration */
+   UA_StatusCode lastStatus;
+   /* if the last registration succeeded and was not unregistered yet */
+   bool registered;
+   /* the time until the next attempt in ms, 0 if stopped */
+   uint32_t nextDelay;
+   /* the time of attempts, failures included */
+   uint64_t lastLatency;
+   uint64_t maxLatency;
+   uint64_t totalLatency;
+
+   /**
+    * @brief Return the mean time of an attempt in ns
+    */
+   uint64_t meanLatency() const {
+      return attempts ? totalLatency / attempts : 0;
+   }
+};
+
+/**
+ * The call doing a registration at the LDS, or the unregistration if
+ * unregister is true. Set to stand in for the LDS, e.g. to test a server
+ * without one. It runs on the server loop thread, like the request it
+ * stands in for
+ */
+typedef std::function<UA_StatusCode(const std::string &ldsServerURI,
+                                    bool unregister)> OpcUALDSCall;
+
+/**
+ * Runs a task on the server loop thread, see OpcUAServer::runInLoop()
+ */
+typedef std::function<void(const std::function<void()> &task)>
+      OpcUALoopDispatch;
+
+/**
+ * Registers a server at a LDS, timed by a thread of its own, so the caller
+ * does not wait for the LDS. The thread also connects to the LDS, but
+ * hands the request to the server loop, since open62541 is not thread
+ * safe, so the loop waits only for the answer of the LDS.
+ *
+ * The server registers after firstDelay and then every period. A failed
+ * registration is retried after minBackoff, doubling with each further
+ * failure up to maxBackoff. Each registration connects anew, so a
+ * restarted LDS is found again. stop() waits for the registration in
+ * progress, which the timeouts bound, and unregisters only if the last
+ * registration succeeded, so an unreachable LDS does not delay the
+ * shutdown by another timeout.
+ */
+class OpcUALDSRegistrar {
+private:
+   UA_Server *server;
+   OpcUALoopDispatch dispatch;
+   std::string uri;
+   OpcUALDSOptions options;
+   OpcUALDSCall call;
+
+   std::mutex lock;
+   std::condition_variable changed;
+   bool stopping;
+   OpcUALDSStats stats;
+   std::thread worker;
+
+   /**
+    * @brief Register or unregister once, the request runs on the server
+    * loop thread and counts as timed out if the loop does not pick it up
+    * within the timeout (helper)
+    */
+   UA_StatusCode callLDS(bool unregister);
+
+   /**
+    * @brief Return the time until the retry after a count of failures
+    * (helper)
+    */
+   uint32_t backoff(uint64_t failures);
+
+   /**
+    * @brief The loop of the registration thread (helper)
+    */
+   void loop();
+
+public:
+   /**
+    * @brief Constructor for a registration, start() begins it
+    * @param server the server to register, only the tasks given to
+    * dispatch use it
+    * @param dispatch runs a task on the server loop thread, empty to run
+    * it on the registration thread, which is safe only without a loop
+    * @param ldsServerURI the LDS (e.g. "opc.tcp://localhost:4840")
+    * @param options the timing
+    * @param call the call to use instead of a client connecting to the
+    * LDS, empty for none
+    */
+   OpcUALDSRegistrar(UA_Server *server, const OpcUALoopDispatch &dispatch,
+                     const std::string &ldsServerURI,
+                     const OpcUALDSOptions &options,
+                     const OpcUALDSCall &call = OpcUALDSCall());
+
+   /**
+    * @brief Stop the registration, see stop()
+    */
+   virtual ~OpcUALDSRegistrar();
+
+   OpcUALDSRegistrar(const OpcUALDSRegistrar &) = delete;
+   OpcUALDSRegistrar &operator=(const OpcUALDSRegistrar &) = delete;
+
+   /**
+    * @brief Start the registration thread
+    * @return true if started, false if already started
+    */
+   bool start();
+
+   /**
+    * @brief Stop the registration thread and unregister if registered and
+    * unregisterOnStop is set. Returns within the timeout for a registration
+    * in progress plus the timeout for the unregistration
+    * @return true if unregistered, else false
+    */
+   bool stop();
+
+   /**
+    * @brief Return the course of the registration so far
+    */
+   OpcUALDSStats getStats();
+
+   /**
+    * @brief Return the LDS registered at
+    */
+   const std::string &getURI() {
+      return uri;
+   }
+};
+
+} /* namespace n_opcua */
+
+#endif /* SRC_OPCUALDSREGISTRAR_H_ */
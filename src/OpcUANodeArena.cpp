@@ -0,0 +1,118 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include <new>
+#include <cstdlib>
+#include "OpcUANodeArena.h"
+
+namespace n_opcua {
+
+OpcUANodeArena::OpcUANodeArena() :
+   cursor(nullptr),
+   end(nullptr),
+   liveBlocks(0) {
+   for (size_t i = 0; i < sizeClasses; i++)
+      freeBlocks[i] = nullptr;
+}
+
+OpcUANodeArena::~OpcUANodeArena() {
+   /* the handler deletes its contexts before, a block still in use goes
+    * with its slab */
+   for (size_t i = 0; i < slabs.size(); i++)
+      free(slabs[i]);
+}
+
+void *OpcUANodeArena::allocate(size_t size) {
+   size_t total = (headerSize + size + granule - 1) & ~(granule - 1);
+   if (total > maxBlock)
+      return allocateHeap(size);
+
+   size_t sizeClass = total / granule - 1;
+   char *block;
+   {
+      std::lock_guard<std::mutex> guard(lock);
+      if (freeBlocks[sizeClass]) {
+         block = static_cast<char *>(freeBlocks[sizeClass]);
+         freeBlocks[sizeClass] = *reinterpret_cast<void **>(block);
+      } else {
+         if (cursor + total > end) {
+            /* the rest of the slab is left unused */
+            char *slab = static_cast<char *>(malloc(slabSize));
+            if (!slab)
+               return nullptr;
+            slabs.push_back(slab);
+            cursor = slab;
+            end = slab + slabSize;
+         }
+         block = cursor;
+         cursor += total;
+      }
+      liveBlocks++;
+   }
+
+   Header *header = reinterpret_cast<Header *>(block);
+   header->arena = this;
+   header->sizeClass = sizeClass;
+   return block + headerSize;
+}
+
+void *OpcUANodeArena::allocateHeap(size_t size) {
+   char *block = static_cast<char *>(malloc(headerSize + size));
+   if (!block)
+      return nullptr;
+
+   Header *header = reinterpret_cast<Header *>(block);
+   header->arena = nullptr;
+   header->sizeClass = 0;
+   return block + headerSize;
+}
+
+void OpcUANodeArena::deallocate(void *ptr) {
+   if (!ptr)
+      return;
+
+   char *block = static_cast<char *>(ptr) - headerSize;
+   Header *header = reinterpret_cast<Header *>(block);
+   OpcUANodeArena *arena = header->arena;
+   if (!arena) {
+      free(block);
+      return;
+   }
+
+   std::lock_guard<std::mutex> guard(arena->lock);
+   size_t sizeClass = header->sizeClass;
+   *reinterpret_cast<void **>(block) = arena->freeBlocks[sizeClass];
+   arena->freeBlocks[sizeClass] = block;
+   arena->liveBlocks--;
+}
+
+bool OpcUANodeArena::release() {
+   std::lock_guard<std::mutex> guard(lock);
+   if (liveBlocks > 0)
+      return false;
+
+   for (size_t i = 0; i < slabs.size(); i++)
+      free(slabs[i]);
+   slabs.clear();
+   cursor = end = nullptr;
+   for (size_t i = 0; i < sizeClasses; i++)
+      freeBlocks[i] = nullptr;
+   return true;
+}
+
+size_t OpcUANodeArena::getSlabBytes() {
+   std::lock_guard<std::mutex> guard(lock);
+   return slabs.size() * slabSize;
+}
+
+size_t OpcUANodeArena::getLiveBlocks() {
+   std::lock_guard<std::mutex> guard(lock);
+   return liveBlocks;
+}
+
+} /* namespace n_opcua */
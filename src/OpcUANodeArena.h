@@ -0,0 +1,101 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#ifndef SRC_OPCUANODEARENA_H_
+#define SRC_OPCUANODEARENA_H_
+
+#include <mutex>
+#include <vector>
+#include <cstddef>
+
+namespace n_opcua {
+
+/**
+ * Slab allocator for the node contexts of a node handler.
+ *
+ * Blocks are carved one after another from large slabs, so contexts created
+ * together lie next to each other. Freed blocks go to a free list of their
+ * size and are reused by the next block of that size. The slabs themselves
+ * are only given back by release() or the destructor, in one go.
+ *
+ * Every block starts with a header naming its arena, so deallocate() also
+ * takes blocks from allocateHeap(), which come from the global heap.
+ */
+class OpcUANodeArena {
+private:
+   struct Header {
+      /* the arena of the block, nullptr for the global heap */
+      OpcUANodeArena *arena;
+      size_t sizeClass;
+   };
+
+   /* blocks are a multiple of this, which keeps them aligned */
+   static const size_t granule = 16;
+   static const size_t headerSize = (sizeof(Header) + granule - 1) &
+                                    ~(granule - 1);
+   /* larger blocks come from the global heap */
+   static const size_t maxBlock = 4096;
+   static const size_t sizeClasses = maxBlock / granule;
+   static const size_t slabSize = 2 * 1024 * 1024;
+
+   std::mutex lock;
+   std::vector<char *> slabs;
+   /* the unused rest of the newest slab */
+   char *cursor;
+   char *end;
+   /* the first free block of every size class, linked through the blocks */
+   void *freeBlocks[sizeClasses];
+   size_t liveBlocks;
+
+public:
+   OpcUANodeArena();
+   virtual ~OpcUANodeArena();
+
+   OpcUANodeArena(const OpcUANodeArena &) = delete;
+   OpcUANodeArena &operator=(const OpcUANodeArena &) = delete;
+
+   /**
+    * @brief Allocate a block from the arena
+    * @param size the size of the block
+    * @return the block, nullptr if out of memory
+    */
+   void *allocate(size_t size);
+
+   /**
+    * @brief Allocate a block from the global heap, which deallocate() takes
+    * @param size the size of the block
+    * @return the block, nullptr if out of memory
+    */
+   static void *allocateHeap(size_t size);
+
+   /**
+    * @brief Give a block back to where it came from
+    * @param block the block from allocate() or allocateHeap()
+    */
+   static void deallocate(void *block);
+
+   /**
+    * @brief Free all slabs at once, only done if no block is in use
+    * @return true if freed, else false
+    */
+   bool release();
+
+   /**
+    * @brief Return the bytes taken by the slabs
+    */
+   size_t getSlabBytes();
+
+   /**
+    * @brief Return the count of blocks in use
+    */
+   size_t getLiveBlocks();
+};
+
+} /* namespace n_opcua */
+
+#endif /* SRC_OPCUANODEARENA_H_ */
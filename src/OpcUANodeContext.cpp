@@ -6,6 +6,9 @@
  * <tobias.johannes.klausmann@mni.thm.de>
  */
 
+#include <new>
+#include <cmath>
+#include <cstring>
 #include "OpcUANodeContext.h"
 #include "OpcUANodeHandler.h"
 
@@ -35,32 +38,40 @@ void OpcUANodeContext::setDefaultParent() {
 OpcUANodeContext::OpcUANodeContext(UA_NodeId* node,
                                    OpcUANodeHandler *nodeHandler) :
    _node(node),
+   _nodeStorage(),
+   _qualifiedName(),
    _parent(nullptr),
-   _default_parent(nullptr),
+   _parentCtx(nullptr),
+   _default_parent_storage(),
+   _default_parent(&_default_parent_storage),
    server(nullptr),
    _nodeHandler(nodeHandler),
+   _stats(nullptr),
    _dataTypeNr(-1),
    _readable(false),
    _writeable(false),
    _active(false) {
-   _default_parent = new UA_NodeId();
    initDefault();
 }
 
 OpcUANodeContext::OpcUANodeContext(OpcUANodeHandler *nodeHandler) :
+   _node(&_nodeStorage),
+   _nodeStorage(),
+   _qualifiedName(),
    _parent(nullptr),
-   _default_parent(nullptr),
+   _parentCtx(nullptr),
+   _default_parent_storage(),
+   _default_parent(&_default_parent_storage),
    server(nullptr),
    _nodeHandler(nodeHandler),
+   _stats(nullptr),
    _dataTypeNr(-1),
    _readable(false),
    _writeable(false),
    _active(false) {
-   _node = new UA_NodeId();
    _node->namespaceIndex = 0;
    _node->identifierType = UA_NODEIDTYPE_NUMERIC;
 
-   _default_parent = new UA_NodeId();
    initDefault();
 }
 
@@ -68,24 +79,82 @@ OpcUANodeContext::~OpcUANodeContext() {
 
    _nodeHandler->removeNodeFromIndex(this);
 
-   if (_node)
+   if (_parentCtx || !childset.empty()) {
+      /* deleted on its own, see OpcUANodeHandler::deleteNode() */
+      std::lock_guard<std::recursive_mutex> guard(_nodeHandler->getLock());
+      _nodeHandler->unindexPaths(this);
+      if (_parentCtx)
+         _parentCtx->childset.erase(this);
+      for (OpcUANodeContext *child : childset) {
+         child->_parent = nullptr;
+         child->_parentCtx = nullptr;
+         _nodeHandler->indexPaths(child);
+      }
+   } else {
+      _nodeHandler->unindexPaths(this);
+   }
+
+   if (_node && _node != &_nodeStorage)
       delete _node;
-   if (_default_parent)
-      delete _default_parent;
+   UA_NodeId_deleteMembers(_default_parent);
+   delete _stats.load(std::memory_order_relaxed);
+}
+
+void *OpcUANodeContext::operator new(size_t size) {
+   void *ptr = OpcUANodeArena::allocateHeap(size);
+   if (!ptr)
+      throw std::bad_alloc();
+   return ptr;
+}
+
+void *OpcUANodeContext::operator new(size_t size,
+                                     OpcUANodeHandler *nodeHandler) {
+   void *ptr = nodeHandler ? nodeHandler->getArena()->allocate(size) :
+                             OpcUANodeArena::allocateHeap(size);
+   if (!ptr)
+      throw std::bad_alloc();
+   return ptr;
+}
+
+void OpcUANodeContext::operator delete(void *ptr) {
+   OpcUANodeArena::deallocate(ptr);
+}
+
+void OpcUANodeContext::operator delete(void *ptr, OpcUANodeHandler *) {
+   OpcUANodeArena::deallocate(ptr);
 }
 
 bool OpcUANodeContext::setNode(UA_NodeId *node) {
    if (_node)
       return false;
    _node = node;
+   _nodeHandler->indexNodeId(this);
    return true;
 }
 
+bool OpcUANodeContext::setNodeId(const UA_NodeId *node) {
+   if (!_node || !node)
+      return false;
+
+   _nodeHandler->unindexNodeId(this);
+   *_node = *node;
+   nsID = node->namespaceIndex;
+   if (node->identifierType == UA_NODEIDTYPE_STRING ||
+       node->identifierType == UA_NODEIDTYPE_BYTESTRING) {
+      /* we keep the identifier ourself, like the name */
+      _nodeIdStr.assign((const char *) node->identifier.string.data,
+                        node->identifier.string.length);
+      _node->identifier.string.data = (UA_Byte *) _nodeIdStr.data();
+   }
+   return _nodeHandler->indexNodeId(this);
+}
+
 bool OpcUANodeContext::setParent(OpcUANodeContext *parent_ctx) {
    if (!parent_ctx || !parent_ctx->getNodeId() || _parent != nullptr)
       return false;
 
    _parent = parent_ctx->getNodeId();
+   _parentCtx = parent_ctx;
    return true;
 }
 
@@ -93,9 +162,18 @@ bool OpcUANodeContext::removeParent() {
    if (!_parent)
       return false;
    _parent = nullptr;
+   _parentCtx = nullptr;
    return true;
 }
 
+bool OpcUANodeContext::setParentNodeId(const UA_NodeId *parent) {
+   if (!parent)
+      return false;
+
+   UA_NodeId_deleteMembers(_default_parent);
+   return UA_NodeId_copy(parent, _default_parent) == UA_STATUSCODE_GOOD;
+}
+
 UA_NodeId *OpcUANodeContext::getParent() {
    if (!_parent)
       return _default_parent;
@@ -113,15 +191,18 @@ bool OpcUANodeContext::setServer(OpcUAServer *serv) {
 }
 
 bool OpcUANodeContext::setName(std::string name) {
+   /* Our NodeId refers to the name, so it leaves the handlers index first */
+   _nodeHandler->unindexNodeId(this);
    _name = name;
    /* Set node name */
    if (!_node)
       return false;
    *_node = UA_NODEID_STRING(getNamespace(), (char *) _name.c_str());
+   bool ret = _nodeHandler->indexNodeId(this);
 
    setAttrName();
 
-   return true;
+   return ret;
 }
 
 void OpcUANodeContext::setDescription(std::string description) {
@@ -129,22 +210,71 @@ void OpcUANodeContext::setDescription(std::string description) {
    setAttrDescription();
 }
 
-void OpcUANodeContext::setQualifiedName(std::string qualifiedName) {
+bool OpcUANodeContext::setQualifiedName(std::string qualifiedName) {
+   /* Our browse paths refer to the name, so they leave the handler first */
+   _nodeHandler->unindexPaths(this);
    _qualifiedNameStr = qualifiedName;
    /* Set qualified name for node */
    _qualifiedName = UA_QUALIFIEDNAME(getNamespace(), (char *)_qualifiedNameStr.c_str());
+   return _nodeHandler->indexPaths(this);
+}
+
+OpcUANodeStats *OpcUANodeContext::getStats() {
+   OpcUANodeStats *stats = _stats.load(std::memory_order_acquire);
+   if (stats || !_nodeHandler->isStatsEnabled())
+      return stats;
+
+   /* two worker threads may get here at once, only one wins */
+   OpcUANodeStats *created = new OpcUANodeStats();
+   if (_stats.compare_exchange_strong(stats, created,
+                                      std::memory_order_acq_rel))
+      return created;
+   delete created;
+   return stats;
+}
+
+bool OpcUANodeContext::getStatsSnapshot(OpcUANodeStatsSnapshot *snapshot) {
+   OpcUANodeStats *stats = _stats.load(std::memory_order_acquire);
+   if (!stats || !snapshot)
+      return false;
+
+   stats->read.snapshot(&snapshot->read);
+   stats->write.snapshot(&snapshot->write);
+   stats->call.snapshot(&snapshot->call);
+   return true;
 }
 
 bool OpcUANodeContext::addChild(OpcUANodeContext *child) {
-   if (isChild(child))
+   std::lock_guard<std::recursive_mutex> guard(_nodeHandler->getLock());
+   if (!child || child == this || isChild(child))
       return false;
 
-   child->setParent(this);
+   /* a child of another parent would be in two child sets, and deleted
+    * twice or left dangling in the other one */
+   _nodeHandler->unindexPaths(child);
+   if (!child->setParent(this)) {
+      _nodeHandler->indexPaths(child);
+      return false;
+   }
    childset.insert(child);
+   _nodeHandler->indexPaths(child);
    return true;
 }
 
 bool OpcUANodeContext::removeChild(OpcUANodeContext *child) {
+   std::lock_guard<std::recursive_mutex> guard(_nodeHandler->getLock());
+   if (!isChild(child))
+      return false;
+
+   _nodeHandler->unindexPaths(child);
+   child->removeParent();
+   childset.erase(child);
+   _nodeHandler->indexPaths(child);
+   return true;
+}
+
+bool OpcUANodeContext::detachChild(OpcUANodeContext *child) {
+   std::lock_guard<std::recursive_mutex> guard(_nodeHandler->getLock());
    if (!isChild(child))
       return false;
 
@@ -154,11 +284,23 @@ bool OpcUANodeContext::removeChild(OpcUANodeContext *child) {
 }
 
 bool OpcUANodeContext::isChild(OpcUANodeContext *node) {
+   std::lock_guard<std::recursive_mutex> guard(_nodeHandler->getLock());
    if (childset.find(node) != childset.end())
       return true;
    return false;
 }
 
+void OpcUANodeContext::detachChildren(
+      std::vector<OpcUANodeContext *> *children) {
+   std::lock_guard<std::recursive_mutex> guard(_nodeHandler->getLock());
+   for (OpcUANodeContext *child : childset) {
+      child->_parent = nullptr;
+      child->_parentCtx = nullptr;
+      children->push_back(child);
+   }
+   childset.clear();
+}
+
 void OpcUANodeContext::setDataTypeNumber(int16_t dataTypeNr) {
    _dataTypeNr = dataTypeNr;
    setAttrDataType();
@@ -166,8 +308,11 @@ void OpcUANodeContext::setDataTypeNumber(int16_t dataTypeNr) {
 
 void OpcUANodeContext::setNamespace(uint16_t namespaceID) {
    nsID = namespaceID;
-   if (_node)
+   if (_node) {
+      _nodeHandler->unindexNodeId(this);
       _node->namespaceIndex = nsID;
+      _nodeHandler->indexNodeId(this);
+   }
 }
 
 uint16_t OpcUANodeContext::getNamespace() {
@@ -183,9 +328,8 @@ void OpcUANodeContext::convertFromOPC(std::string *value,
 
 void OpcUANodeContext::convertToOPC(UA_Variant *value,
                                     const std::string *userval) {
-   int datatypenr = convertTypeToOpen62541Type(*userval);
    UA_String str = UA_String_fromChars(userval->c_str());
-   UA_Variant_setScalarCopy(value, &str, &UA_TYPES[datatypenr]);
+   UA_Variant_setScalarCopy(value, &str, UaTypeTraits<std::string>::dataType());
    UA_String_deleteMembers(&str);
 }
 
@@ -196,11 +340,11 @@ void OpcUANodeContext::convertToOPC(UA_Variant *value,
    if (uservec->size() < 1)
       return;
 
-   int datatypenr = convertTypeToOpen62541Type(*uservec->begin());
+   const UA_DataType *datatype = UaTypeTraits<std::string>::dataType();
 
     UA_String *arr =
           reinterpret_cast<UA_String*>(UA_Array_new(uservec->size(),
-                                                    &UA_TYPES[datatypenr]));
+                                                    datatype));
 
    if (value == nullptr)
       return;
@@ -214,23 +358,104 @@ void OpcUANodeContext::convertToOPC(UA_Variant *value,
       it++;
    }
 
-   UA_Variant_setArray(value, arr, uservec->size(), &UA_TYPES[datatypenr]);
+   UA_Variant_setArray(value, arr, uservec->size(), datatype);
+}
+
+void OpcUANodeContext::convertToOPC(UA_Variant *value,
+                                    const std::vector<bool> *uservec) {
+   if (uservec->size() < 1)
+      return;
+
+   const UA_DataType *datatype = &UA_TYPES[UA_TYPES_BOOLEAN];
+   UA_Boolean *arr = static_cast<UA_Boolean *>(UA_Array_new(uservec->size(),
+                                                            datatype));
+   if (!arr)
+      return;
+
+   /* std::vector<bool> packs its bits, so one by one */
+   for (size_t i = 0; i < uservec->size(); i++)
+      arr[i] = (*uservec)[i];
+
+   UA_Variant_setArray(value, arr, uservec->size(), datatype);
+}
+
+bool OpcUANodeContext::convertFromOPC(std::vector<bool> *value,
+                                      const UA_Variant *opcval) {
+   if (opcval->type != &UA_TYPES[UA_TYPES_BOOLEAN] ||
+       UA_Variant_isScalar(opcval))
+      return false;
+
+   const UA_Boolean *arr = static_cast<const UA_Boolean *>(opcval->data);
+   value->resize(opcval->arrayLength);
+   for (size_t i = 0; i < opcval->arrayLength; i++)
+      (*value)[i] = arr[i];
+   return true;
 }
 
+UA_StatusCode OpcUANodeContext::lendToOPC(UA_Variant *value,
+                                          const OpcUABorrowedBuffer *buffer,
+                                          const UA_NumericRange *range) {
+   const UA_Byte *data = static_cast<const UA_Byte *>(buffer->data);
+   size_t length = buffer->length;
+
+   if (range) {
+      UA_UInt32 dims = static_cast<UA_UInt32>(length);
+      size_t first;
+      UA_StatusCode retval = resolveNumericRange(range, &dims, 1, &first,
+                                                 &length);
+      if (retval != UA_STATUSCODE_GOOD)
+         return retval;
+
+      /* the slice is lent as well */
+      data += first * buffer->type->memSize;
+   }
+
+   if (length == 0)
+      data = static_cast<const UA_Byte *>(UA_EMPTY_ARRAY_SENTINEL);
 
+   UA_Variant_setArray(value, const_cast<UA_Byte *>(data), length,
+                       buffer->type);
+   value->storageType = UA_VARIANT_DATA_NODELETE;
+   return UA_STATUSCODE_GOOD;
+}
 
 void OpcUANodeContext::setOPCSourceTimeStamp(UA_DataValue *value,
                                              time_t time_point) {
-   value->sourceTimestamp = UA_DateTime_fromUnixTime(time_point);
+   value->sourceTimestamp = OpcUAClock::fromUnixTime(time_point);
+   value->hasSourceTimestamp = true;
+}
+
+void OpcUANodeContext::setOPCSourceTimeStamp(
+      UA_DataValue *value, std::chrono::system_clock::time_point time_point) {
+   value->sourceTimestamp = OpcUAClock::fromTimePoint(time_point);
+   value->hasSourceTimestamp = true;
 }
 
 void OpcUANodeContext::setOPCSourceTimeStampNow(UA_DataValue *value) {
-   std::time_t time_point = std::time(nullptr);
-   setOPCSourceTimeStamp(value, time_point);
+   value->sourceTimestamp = OpcUAClock::cycleNow();
+   value->hasSourceTimestamp = true;
+}
+
+void OpcUANodeContext::setOPCServerTimeStampNow(UA_DataValue *value) {
+   value->serverTimestamp = OpcUAClock::cycleNow();
+   value->hasServerTimestamp = true;
+}
+
+void OpcUANodeContext::setOPCTimeStampsNow(UA_DataValue *value,
+                                           bool includeSourceTimeStamp) {
+   UA_DateTime now = OpcUAClock::cycleNow();
+   if (includeSourceTimeStamp && !value->hasSourceTimestamp) {
+      value->sourceTimestamp = now;
+      value->hasSourceTimestamp = true;
+   }
+   value->serverTimestamp = now;
+   value->hasServerTimestamp = true;
 }
 
 void OpcUANodeContext::writeToServer(UA_Variant var) {
-   UA_Server_writeValue(server->getServer(), *getNodeId(), var);
+   if (!acceptWrite(&var))
+      return;
+   server->writeValue(getNodeId(), &var);
 }
 
 /*
@@ -240,6 +465,176 @@ void OpcUANodeContext::writeToServer(UA_Variant var) {
 OpcUAVarNodeContext::~OpcUAVarNodeContext() {
    deleteAttrName();
    deleteAttrDescription();
+   UA_Variant_deleteMembers(&lastWritten);
+   delete memo.load(std::memory_order_relaxed);
+}
+
+void OpcUAVarNodeContext::setReadMaxAge(std::chrono::nanoseconds maxAge) {
+   OpcUAReadMemo *current = memo.load(std::memory_order_acquire);
+   if (!current) {
+      /* variables never memoized don't carry a memo */
+      if (maxAge.count() <= 0)
+         return;
+      OpcUAReadMemo *created = new OpcUAReadMemo();
+      if (memo.compare_exchange_strong(current, created,
+                                       std::memory_order_acq_rel))
+         current = created;
+      else
+         delete created;
+   }
+   current->setMaxAge(maxAge);
+}
+
+/* element count of a variant, 1 for a scalar */
+static size_t elementCount(const UA_Variant *value) {
+   if (UA_Variant_isScalar(value))
+      return 1;
+   return value->arrayLength;
+}
+
+/* read an element of a numeric variant as double */
+static bool numericElement(const UA_Variant *value, size_t i, double *out) {
+   const void *p = static_cast<const UA_Byte *>(value->data) +
+                   i * value->type->memSize;
+
+   switch (typeIndexOf(value->type)) {
+   case UA_TYPES_SBYTE:  *out = *static_cast<const UA_SByte *>(p); return true;
+   case UA_TYPES_BYTE:   *out = *static_cast<const UA_Byte *>(p); return true;
+   case UA_TYPES_INT16:  *out = *static_cast<const UA_Int16 *>(p); return true;
+   case UA_TYPES_UINT16: *out = *static_cast<const UA_UInt16 *>(p); return true;
+   case UA_TYPES_INT32:  *out = *static_cast<const UA_Int32 *>(p); return true;
+   case UA_TYPES_UINT32: *out = *static_cast<const UA_UInt32 *>(p); return true;
+   case UA_TYPES_INT64:  *out = (double) *static_cast<const UA_Int64 *>(p);
+                         return true;
+   case UA_TYPES_UINT64: *out = (double) *static_cast<const UA_UInt64 *>(p);
+                         return true;
+   case UA_TYPES_FLOAT:  *out = *static_cast<const UA_Float *>(p); return true;
+   case UA_TYPES_DOUBLE: *out = *static_cast<const UA_Double *>(p); return true;
+   default:
+      return false;
+   }
+}
+
+/* compare the data of two variants of the same type and length */
+static bool equalElements(const UA_Variant *a, const UA_Variant *b,
+                          size_t count) {
+   if (a->type->pointerFree)
+      return memcmp(a->data, b->data, count * a->type->memSize) == 0;
+
+   if (a->type == &UA_TYPES[UA_TYPES_STRING] ||
+       a->type == &UA_TYPES[UA_TYPES_BYTESTRING]) {
+      const UA_String *sa = static_cast<const UA_String *>(a->data);
+      const UA_String *sb = static_cast<const UA_String *>(b->data);
+      for (size_t i = 0; i < count; i++) {
+         if (sa[i].length != sb[i].length ||
+             (sa[i].length > 0 &&
+              memcmp(sa[i].data, sb[i].data, sa[i].length) != 0))
+            return false;
+      }
+      return true;
+   }
+   /* other types are taken as changed */
+   return false;
+}
+
+/* the status of a data value, good if it has none */
+static UA_StatusCode statusOf(const UA_DataValue *value) {
+   return value->hasStatus ? value->status : UA_STATUSCODE_GOOD;
+}
+
+bool OpcUAVarNodeContext::filterValue(const UA_Variant *value,
+                                      const UA_Variant *last) {
+   bool passes = true;
+
+   if ((deadbandType != OpcUADeadbandNone || suppressUnchanged) && last &&
+       value->type && value->type == last->type &&
+       UA_Variant_isScalar(value) == UA_Variant_isScalar(last) &&
+       elementCount(value) == elementCount(last)) {
+      size_t count = elementCount(value);
+      double a, b;
+
+      /* element 0 of an empty array is no element, two empty arrays are
+       * unchanged whatever their type */
+      if (deadbandType != OpcUADeadbandNone &&
+          (count == 0 || numericElement(value, 0, &a))) {
+         /* a change of any element beyond the band passes */
+         passes = false;
+         for (size_t i = 0; i < count && !passes; i++) {
+            numericElement(value, i, &a);
+            numericElement(last, i, &b);
+            /* a NaN never compares beyond the band, so a change from or to
+             * NaN always passes */
+            if (std::isnan(a) || std::isnan(b))
+               passes = std::isnan(a) != std::isnan(b);
+            else
+               passes = std::fabs(a - b) > deadband;
+         }
+      } else if (suppressUnchanged) {
+         passes = !equalElements(value, last, count);
+      }
+   }
+
+   if (passes)
+      passedUpdates.fetch_add(1, std::memory_order_relaxed);
+   else
+      suppressedUpdates.fetch_add(1, std::memory_order_relaxed);
+   return passes;
+}
+
+bool OpcUAVarNodeContext::setDeadband(OpcUADeadbandType type, double value,
+                                      double euLow, double euHigh) {
+   if (value < 0)
+      return false;
+
+   switch (type) {
+   case OpcUADeadbandNone:
+      deadband = 0;
+      break;
+   case OpcUADeadbandAbsolute:
+      deadband = value;
+      break;
+   case OpcUADeadbandPercent:
+      if (value > 100 || euHigh <= euLow)
+         return false;
+      deadband = value / 100 * (euHigh - euLow);
+      break;
+   default:
+      return false;
+   }
+   deadbandType = type;
+   return true;
+}
+
+bool OpcUAVarNodeContext::publishDataValue(const UA_DataValue *value) {
+   if (!value)
+      return false;
+
+   /* a data source of its own never reads the cache */
+   UA_DataSource own;
+   if (getDataSource(&own))
+      return false;
+
+   /* only the value is filtered, a changed status passes with any value
+    * and an update without a value (status or timestamps only) is never
+    * filtered */
+   const UA_DataValue *last = cache.getPublished();
+   bool statusChanged = last && statusOf(value) != statusOf(last);
+   if (value->hasValue && !statusChanged &&
+       !filterValue(&value->value, last && last->hasValue ? &last->value :
+                                                            nullptr))
+      return true;
+   return cache.publish(value, getServer());
+}
+
+bool OpcUAVarNodeContext::acceptWrite(const UA_Variant *value) {
+   if (!filterValue(value, lastWritten.type ? &lastWritten : nullptr))
+      return false;
+
+   /* only kept while filtering, nothing is compared against it otherwise */
+   UA_Variant_deleteMembers(&lastWritten);
+   if (deadbandType != OpcUADeadbandNone || suppressUnchanged)
+      UA_Variant_copy(value, &lastWritten);
+   return true;
 }
 
 void OpcUAVarNodeContext::setAttrName() {
@@ -272,7 +667,7 @@ void OpcUAVarNodeContext::setAttrReadable() {
    if (_readable)
       varAttr.accessLevel |= UA_ACCESSLEVELMASK_READ;
    else
-      varAttr.accessLevel |= ~UA_ACCESSLEVELMASK_READ;
+      varAttr.accessLevel &= ~UA_ACCESSLEVELMASK_READ;
 }
 
 void OpcUAVarNodeContext::setAttrWriteable() {
@@ -280,7 +675,7 @@ void OpcUAVarNodeContext::setAttrWriteable() {
    if (_writeable)
       varAttr.accessLevel |= UA_ACCESSLEVELMASK_WRITE;
    else
-      varAttr.accessLevel |= ~UA_ACCESSLEVELMASK_WRITE;
+      varAttr.accessLevel &= ~UA_ACCESSLEVELMASK_WRITE;
 }
 
 void OpcUAVarNodeContext::setReadable(bool readable) {
@@ -402,7 +797,8 @@ void OpcUAMethodNodeContext::initArguments(uint64_t argCount,
       std::string str = "var" + std::to_string(count);
       args[count].description = UA_LOCALIZEDTEXT_ALLOC((char *)_locale.c_str(),
                                                        (char *)_description.c_str());
-      args[count].name = UA_STRING((char *)(_name.c_str()));
+      /* the arguments own their strings, they are freed with them */
+      args[count].name = UA_String_fromChars(_name.c_str());
       count++;
    }
 }
@@ -465,23 +861,26 @@ bool OpcUAMethodNodeContext::setOutputArgumentRank(uint64_t argNum,
 
 bool OpcUAMethodNodeContext::setInputArgumentName(uint64_t argNum,
                                                   std::string name) {
-   if (argNum > inArgumentCount)
+   if (argNum >= inArgumentCount)
       return false;
 
+   UA_String_deleteMembers(&inputArguments[argNum].name);
    inputArguments[argNum].name = UA_String_fromChars(name.c_str());
    return true;
 }
 
 bool OpcUAMethodNodeContext::setOutputArgumentName(uint64_t argNum,
                                                    std::string name) {
-   if (argNum > outArgumentCount)
+   if (argNum >= outArgumentCount)
       return false;
 
+   UA_String_deleteMembers(&outputArguments[argNum].name);
    outputArguments[argNum].name = UA_String_fromChars(name.c_str());
    return true;
 }
 
 void OpcUAMethodNodeContext::setAttrName() {
+   deleteAttrName();
    methodAttr.displayName = UA_LOCALIZEDTEXT_ALLOC(
             static_cast< const char *>(_locale.c_str()),
             static_cast<const char *>(_name.c_str()));
@@ -492,6 +891,7 @@ void OpcUAMethodNodeContext::deleteAttrName() {
 }
 
 void OpcUAMethodNodeContext::setAttrDescription() {
+   deleteAttrDescription();
    methodAttr.description = UA_LOCALIZEDTEXT_ALLOC(
             static_cast<const char *>(_locale.c_str()),
             static_cast<const char *>(_description.c_str()));
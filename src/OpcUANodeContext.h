@@ -9,36 +9,68 @@
 #ifndef OPCUANODECONTEXT_H
 #define OPCUANODECONTEXT_H
 
+#include <algorithm>
 #include <unordered_set>
 #include <vector>
 #include <functional>
 #include <cassert>
 #include <chrono>
 #include "OpcUAServer.h"
+#include "OpcUAClock.h"
+#include "OpcUATypeTraits.h"
+#include "OpcUAArrayConvert.h"
+#include "OpcUAValueCache.h"
+#include "OpcUANodeStats.h"
 
 
 namespace n_opcua {
 
 class OpcUANodeHandler;
 
+/**
+ * @brief A buffer lent to the server for a zero copy read
+ *
+ * The server encodes straight from data, so the buffer has to stay valid and
+ * unchanged until OpcUAServer::epochPassed() is true for the epoch it was
+ * lent in. See OpcUABorrowedArray for a producer side helper.
+ */
+struct OpcUABorrowedBuffer {
+   /* the first element */
+   const void *data;
+   /* the element count */
+   size_t length;
+   /* the open62541 type of the elements, has to match their memory layout */
+   const UA_DataType *type;
+};
+
 /* Class to hold additional information to a UA_Node */
 class OpcUANodeContext {
 private:
-   /* the node our Context belongs to */
+   /* the node our Context belongs to, _nodeStorage unless given to us */
    UA_NodeId *_node;
+   UA_NodeId _nodeStorage;
    /* the qualified name of the node */
    std::string _qualifiedNameStr;
    UA_QualifiedName _qualifiedName;
 
    /* The parent Node of ourself */
    UA_NodeId *_parent;
+   /* the context _parent belongs to */
+   OpcUANodeContext *_parentCtx;
+   UA_NodeId _default_parent_storage;
    UA_NodeId *_default_parent;
 
+   /* identifier of a string NodeId set by setNodeId() */
+   std::string _nodeIdStr;
+
    OpcUAServer *server;
    OpcUANodeHandler *_nodeHandler;
 
    std::unordered_set<OpcUANodeContext *> childset;
 
+   /* call statistics, created on the first call while they are enabled */
+   std::atomic<OpcUANodeStats *> _stats;
+
    /**
     * @brief Set a default node parent
     */
@@ -66,6 +98,15 @@ protected:
 
    uint16_t nsID;
 
+   /**
+    * @brief Check a value before writeToServer() writes it
+    * @param value the value to write
+    * @return true to write it, else false
+    */
+   virtual bool acceptWrite(const UA_Variant * /* value */) {
+      return true;
+   }
+
 public:
    /**
     * @brief Constructor for OpcUANodeContext with direct initialization of our node
@@ -86,6 +127,23 @@ public:
     */
    virtual ~OpcUANodeContext();
 
+   /**
+    * @brief Allocate a context from the global heap
+    */
+   static void *operator new(size_t size);
+
+   /**
+    * @brief Allocate a context from the arena of a handler, next to the other
+    * contexts of it: new (handler) OpcUAVarNodeContext(handler)
+    */
+   static void *operator new(size_t size, OpcUANodeHandler *nodeHandler);
+
+   /**
+    * @brief Free a context allocated by either operator new
+    */
+   static void operator delete(void *ptr);
+   static void operator delete(void *ptr, OpcUANodeHandler *nodeHandler);
+
    /**
     * @brief Set a node the Context belongs to, only works if the node is not
     * already set
@@ -94,6 +152,15 @@ public:
     */
    bool setNode(UA_NodeId *node);
 
+   /**
+    * @brief Give the node another NodeId, the identifier is copied. A later
+    * setName() replaces it with a string NodeId of the name again
+    * @param node the NodeId to copy
+    * @return true if the NodeId was set, else false. Also false if another
+    * node of the handler has the NodeId, which then still finds that node
+    */
+   bool setNodeId(const UA_NodeId *node);
+
    /**
     * @brief Set the parent node of our object in the Node tree
     * @param parent_ctx The parent of ourself
@@ -107,12 +174,28 @@ public:
     */
    bool removeParent();
 
+   /**
+    * @brief Set the parent by its NodeId, for a parent without context like
+    * the nodes of namespace 0. Used as long as no parent context is set
+    * @param parent the NodeId of the parent, it is copied
+    * @return true if the parent was set, else false
+    */
+   bool setParentNodeId(const UA_NodeId *parent);
+
    /**
     * @brief Returns the parent node
     * @return The parent node, if set, else NULL
     */
    UA_NodeId *getParent();
 
+   /**
+    * @brief Return the context of the parent set by setParent()
+    * @return The parent context, if set, else NULL
+    */
+   OpcUANodeContext *getParentContext() {
+      return _parentCtx;
+   }
+
    /**
     * @brief Set a server the node will be used with
     * @param serv the server to set
@@ -147,10 +230,19 @@ public:
    /**
     * @brief Set a new name for the node, only works if the node is set
     * @param name the new name to set
-    * @return true if the name was set, else false
+    * @return true if the name was set, else false. Also false if another
+    * node of the handler has the resulting NodeId, which then still finds
+    * that node
     */
    bool setName(std::string name);
 
+   /**
+    * @brief Return the name of the node
+    */
+   const std::string &getName() {
+      return _name;
+   }
+
 
    /**
     * @brief set the node description
@@ -162,9 +254,11 @@ public:
     * @brief Set a new qualified name for the node, only works if the node is
     * set
     * @param qualifiedName the new name to set
-    * @return true if the qualified name was set, else false
+    * @return true if the qualified name was set, false if another node
+    * already has one of the resulting browse paths, which then still finds
+    * that node
     */
-   void setQualifiedName(std::string qualifiedName);
+   bool setQualifiedName(std::string qualifiedName);
 
    /**
     * @brief Return the qualified node name
@@ -182,10 +276,25 @@ public:
       return _node;
    }
 
+   /**
+    * @brief Return the call statistics of the node, see
+    * OpcUANodeHandler::setStatsEnabled()
+    * @return the statistics, nullptr if not recorded
+    */
+   OpcUANodeStats *getStats();
+
+   /**
+    * @brief Copy the call statistics of the node
+    * @param snapshot the copy to fill
+    * @return true if statistics were recorded, else false
+    */
+   bool getStatsSnapshot(OpcUANodeStatsSnapshot *snapshot);
+
    /**
     * @brief Add a new child node to our index
     * @param child the child node
-    * @return true if the child was added, else false
+    * @return true if the child was added, false if it is already a child of
+    * another node (remove it there first) or this node has no NodeId
     */
    bool addChild(OpcUANodeContext *child);
 
@@ -203,6 +312,27 @@ public:
     */
    bool isChild(OpcUANodeContext *node);
 
+   /**
+    * @brief Return the children added by addChild()
+    */
+   const std::unordered_set<OpcUANodeContext *> &getChildren() {
+      return childset;
+   }
+
+   /**
+    * @brief Remove a child without updating the browse paths of the handler,
+    * for a child which is deleted with its paths
+    * @param child The child to remove
+    * @return true if removed, else false
+    */
+   bool detachChild(OpcUANodeContext *child);
+
+   /**
+    * @brief Remove all children at once, their parent is removed as well
+    * @param children the removed children are appended to it
+    */
+   void detachChildren(std::vector<OpcUANodeContext *> *children);
+
    /**
     * @brief return if the node is active
     * @return true if the node is active, else false
@@ -218,17 +348,14 @@ public:
    }
 
    /**
-    * @brief Set the type number by guessing the righ type internally, see
-    * UA_DataType to set it directly with setDataTypeNumber()
+    * @brief Set the type number by resolving the right type at compile time,
+    * see UA_DataType to set it directly with setDataTypeNumber()
     * @param dattype the dattye to set
     * @return true if the type got matched an set, else false
     */
    template <typename T>
-   bool setDataType(T dattype) {
-      int16_t type = convertTypeToOpen62541Type(dattype);
-      if (type == -1)
-         return false;
-      _dataTypeNr = type;
+   bool setDataType(const T & /* dattype */) {
+      _dataTypeNr = UaTypeTraits<T>::typeIndex;
 
       setAttrDataType();
 
@@ -283,6 +410,15 @@ public:
    virtual void setAttrWriteable() {
       //assert("Make sure nobody calls this virtual method" == "");
    }
+
+   /**
+    * @brief Return the node class of this node
+    * @return The node class, UA_NODECLASS_UNSPECIFIED for plain contexts
+    */
+   virtual UA_NodeClass getNodeClass() {
+      return UA_NODECLASS_UNSPECIFIED;
+   }
+
    virtual UA_VariableAttributes *getVariableAttr() {
       assert("Make sure nobody calls this virtual method" == "");
       return nullptr;
@@ -301,71 +437,16 @@ public:
    /**
     * @brief Convert a c++ type to an open62541 representation
     * @param type
-    * @return open62541 type definition or -1 if not found
+    * @return open62541 type definition
     *
-    * Return an open62514 type according to the typeid
+    * Return an open62514 type according to UaTypeTraits, resolved at compile
+    * time. Unsupported types fail to compile.
     *
-    * New types have to be implemented, as well as the corresponding setters for
-    * the new types!
-    */
-   int16_t convertTypeToOpen62541Type(T type) {
-      int16_t ret = -1;
-      /* bool */
-      if (typeid(type) == typeid(bool))
-            return UA_TYPES_BOOLEAN;
-      /* int8_t */
-      if (typeid(type) == typeid(int8_t))
-            return UA_TYPES_SBYTE;
-      if (typeid(type) == typeid(short))
-            return UA_TYPES_SBYTE;
-      if (typeid(type) == typeid(signed char))
-            return UA_TYPES_SBYTE;
-      /* uint8_t */
-      if (typeid(type) == typeid(uint8_t))
-            return UA_TYPES_BYTE;
-      if (typeid(type) == typeid(ushort))
-            return UA_TYPES_BYTE;
-      if (typeid(type) == typeid(char))
-            return UA_TYPES_BYTE;
-      if (typeid(type) == typeid(unsigned char))
-            return UA_TYPES_BYTE;
-      /* int16_t */
-      if (typeid(type) == typeid(int16_t))
-            return UA_TYPES_INT16;
-      /* uint16_t */
-      if (typeid(type) == typeid(uint16_t))
-            return UA_TYPES_UINT16;
-      /* int32_t */
-      if (typeid(type) == typeid(int32_t))
-            return UA_TYPES_INT32;
-      if (typeid(type) == typeid(int))
-            return UA_TYPES_INT32;
-      /* uint32_t */
-      if (typeid(type) == typeid(uint32_t))
-            return UA_TYPES_UINT32;
-      if (typeid(type) == typeid(uint))
-            return UA_TYPES_UINT32;
-      /* int64_t */
-      if (typeid(type) == typeid(int64_t))
-            return UA_TYPES_INT64;
-      /* uint64_t */
-      if (typeid(type) == typeid(uint64_t))
-            return UA_TYPES_UINT64;
-      /* float */
-      if (typeid(type) == typeid(float))
-            return UA_TYPES_FLOAT;
-      /* double */
-      if (typeid(type) == typeid(double))
-            return UA_TYPES_DOUBLE;
-      /* strings */
-      if (typeid(type) == typeid(std::string))
-            return UA_TYPES_STRING;
-      if (typeid(type) == typeid(char *))
-            return UA_TYPES_STRING;
-      if (typeid(type) == typeid(const char *))
-            return UA_TYPES_STRING;
-
-      return ret;
+    * New types have to be implemented in UaTypeTraits, as well as the
+    * corresponding setters for the new types!
+    */
+   static constexpr int16_t convertTypeToOpen62541Type(const T & /* type */) {
+      return UaTypeTraits<T>::typeIndex;
    }
 
    /**
@@ -388,25 +469,75 @@ public:
 
    template <typename V>
    /**
-    * @brief Convert a value to a templateable value
-    * @param value the templateable value, e.g. int
-    * @param opcval the value to copy from
-    */
-   void convertFromOPC(std::vector<V> *value, const UA_Variant *opcval) {
-
-      if (opcval->arrayLength < 1)
-         return;
+    * @brief Convert a open62541 array of any numeric type into a buffer,
+    * multidimensional arrays are read in row major order
+    * @param data the buffer to fill
+    * @param length the element count of the buffer
+    * @param opcval the array to copy from
+    * @return the count of elements converted, 0 if the array does not
+    * convert to V, see UaElementConvert
+    */
+   size_t convertFromOPC(V *data, size_t length, const UA_Variant *opcval) {
+      if (!opcval->type || UA_Variant_isScalar(opcval))
+         return 0;
+
+      size_t count = std::min<size_t>(length, opcval->arrayLength);
+      if (!convertElementsFromOPC(data, opcval, count))
+         return 0;
+      return count;
+   }
 
-      if (opcval->arrayDimensionsSize > 1)
-         return;
+   template <typename V>
+   /**
+    * @brief Convert a open62541 array of any numeric type to a std::vector,
+    * multidimensional arrays are flattened in row major order
+    * @param value the vector to fill, it is resized to the element count
+    * @param dimensions the returned lengths of the dimensions, or nullptr
+    * @param opcval the array to copy from
+    * @return true if converted, false if the array does not convert to V
+    */
+   bool convertFromOPC(std::vector<V> *value, std::vector<uint32_t> *dimensions,
+                       const UA_Variant *opcval) {
+      if (!opcval->type || UA_Variant_isScalar(opcval))
+         return false;
 
-      V *vec = reinterpret_cast<V>(opcval->data);
+      value->resize(opcval->arrayLength);
+      if (!convertElementsFromOPC(value->data(), opcval, value->size())) {
+         value->clear();
+         return false;
+      }
 
-      for (uint64_t i = 0; i < opcval->arrayLength; i++) {
-         *value->push_back(vec[i]);
+      if (dimensions) {
+         if (opcval->arrayDimensionsSize > 0)
+            dimensions->assign(opcval->arrayDimensions,
+                               opcval->arrayDimensions +
+                               opcval->arrayDimensionsSize);
+         else
+            dimensions->assign(1, static_cast<uint32_t>(opcval->arrayLength));
       }
+      return true;
+   }
+
+   template <typename V>
+   /**
+    * @brief Convert a open62541 array of any numeric type to a std::vector,
+    * multidimensional arrays are flattened in row major order
+    * @param value the vector to fill, it is resized to the element count
+    * @param opcval the array to copy from
+    * @return true if converted, false if the array does not convert to V
+    */
+   bool convertFromOPC(std::vector<V> *value, const UA_Variant *opcval) {
+      return convertFromOPC(value, nullptr, opcval);
    }
 
+   /**
+    * @brief Convert a open62541 Boolean array to a std::vector
+    * @param value the vector to fill, it is resized to the element count
+    * @param opcval the array to copy from
+    * @return true if converted, false if the array is no Boolean array
+    */
+   bool convertFromOPC(std::vector<bool> *value, const UA_Variant *opcval);
+
    template <typename V>
    /**
     * @brief Convert a value to a templateable value
@@ -426,9 +557,7 @@ public:
     * @param userval the value to copy from
     */
    void convertToOPC(UA_Variant *value, const W *userval) {
-      int datatypenr = convertTypeToOpen62541Type(*userval);
-      UA_Variant_setScalarCopy(value, userval,
-                           &UA_TYPES[datatypenr]);
+      UA_Variant_setScalarCopy(value, userval, UaTypeTraits<W>::dataType());
    }
 
    template <typename W>
@@ -449,6 +578,27 @@ public:
     */
    void convertToOPC(UA_Variant *value, const std::string *userval);
 
+   template <typename V>
+   /**
+    * @brief Convert an array of numbers to a open62541 Variant array with a
+    * single copy
+    * @param value the variant to fill
+    * @param data the first element to copy
+    * @param length the count of elements
+    * @return true if converted, else false
+    */
+   bool convertToOPC(UA_Variant *value, const V *data, size_t length) {
+      const UA_DataType *datatype = UaTypeTraits<V>::dataType();
+
+      V *arr = static_cast<V *>(UA_Array_new(length, datatype));
+      if (!arr)
+         return false;
+
+      convertElements(arr, data, length);
+      UA_Variant_setArray(value, arr, length, datatype);
+      return true;
+   }
+
    template <typename V>
    /**
     * @brief Convert a std::vector to a open62541 Variant array
@@ -456,30 +606,162 @@ public:
     * @param uservec the vector to copy from
     */
    void convertToOPC(UA_Variant *value, const std::vector<V> *uservec) {
-      uint64_t arraycount = 0;
-      V val;
-
       if (uservec->size() < 1)
          return;
 
-      int datatypenr = convertTypeToOpen62541Type(val);
+      convertToOPC(value, uservec->data(), uservec->size());
+   }
+
+   template <typename V>
+   /**
+    * @brief Convert a flat std::vector to a multidimensional open62541 array
+    * @param value the variant to fill
+    * @param uservec the elements in row major order
+    * @param dimensions the lengths of the dimensions
+    * @return true if converted, false if the dimensions do not match the
+    * element count
+    */
+   bool convertToOPC(UA_Variant *value, const std::vector<V> *uservec,
+                     const std::vector<uint32_t> &dimensions) {
+      size_t count = dimensions.empty() ? 0 : 1;
+      for (uint32_t length : dimensions)
+         count *= length;
+      if (count != uservec->size())
+         return false;
 
-      V *arr = static_cast<V*>(UA_Array_new(uservec->size(), &UA_TYPES[datatypenr]));
+      UA_UInt32 *dims = static_cast<UA_UInt32 *>(
+            UA_Array_new(dimensions.size(), &UA_TYPES[UA_TYPES_UINT32]));
+      if (!dims)
+         return false;
+      if (!convertToOPC(value, uservec->data(), uservec->size())) {
+         UA_Array_delete(dims, dimensions.size(), &UA_TYPES[UA_TYPES_UINT32]);
+         return false;
+      }
 
-      if (value == nullptr)
-         return;
+      memcpy(dims, dimensions.data(), dimensions.size() * sizeof(UA_UInt32));
+      value->arrayDimensions = dims;
+      value->arrayDimensionsSize = dimensions.size();
+      return true;
+   }
 
-      typename std::vector<V>::const_iterator it = uservec->begin();
+   template <typename V>
+   /**
+    * @brief Convert an index range of a multidimensional array to a open62541
+    * Variant array, only the elements of the range are copied
+    * @param value the variant to fill, multidimensional slices get the
+    * dimensions of the slice
+    * @param data the elements in row major order
+    * @param dims the lengths of the dimensions
+    * @param dimsSize the count of dimensions
+    * @param range the range to convert, nullptr for the whole array
+    * @return UA_STATUSCODE_GOOD or the error of the range
+    */
+   UA_StatusCode convertToOPC(UA_Variant *value, const V *data,
+                              const UA_UInt32 *dims, size_t dimsSize,
+                              const UA_NumericRange *range) {
+      if (dimsSize == 0)
+         return UA_STATUSCODE_BADINDEXRANGEINVALID;
+
+      size_t first[maxRangeDimensions];
+      size_t count[maxRangeDimensions];
+      UA_StatusCode retval = resolveNumericRange(range, dims, dimsSize, first,
+                                                 count);
+      if (retval != UA_STATUSCODE_GOOD)
+         return retval;
+
+      size_t length = 1;
+      for (size_t i = 0; i < dimsSize; i++)
+         length *= count[i];
+
+      UA_UInt32 *sliceDims = nullptr;
+      if (dimsSize > 1) {
+         sliceDims = static_cast<UA_UInt32 *>(
+               UA_Array_new(dimsSize, &UA_TYPES[UA_TYPES_UINT32]));
+         if (!sliceDims)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+         for (size_t i = 0; i < dimsSize; i++)
+            sliceDims[i] = static_cast<UA_UInt32>(count[i]);
+      }
+
+      const UA_DataType *datatype = UaTypeTraits<V>::dataType();
+      V *arr = static_cast<V *>(UA_Array_new(length, datatype));
+      if (!arr) {
+         UA_Array_delete(sliceDims, sliceDims ? dimsSize : 0,
+                         &UA_TYPES[UA_TYPES_UINT32]);
+         return UA_STATUSCODE_BADOUTOFMEMORY;
+      }
 
-      while (it != uservec->end()) {
-         arr[arraycount] = (*it);
-         arraycount++;
-         it++;
+      convertSlice(arr, data, dims, dimsSize, first, count);
+      UA_Variant_setArray(value, arr, length, datatype);
+      if (sliceDims) {
+         value->arrayDimensions = sliceDims;
+         value->arrayDimensionsSize = dimsSize;
       }
+      return UA_STATUSCODE_GOOD;
+   }
+
+   template <typename V>
+   /**
+    * @brief Convert an index range of an array of numbers to a open62541
+    * Variant array, only the elements of the range are copied
+    * @param value the variant to fill
+    * @param data the first element of the array
+    * @param length the count of elements
+    * @param range the range to convert, nullptr for the whole array
+    * @return UA_STATUSCODE_GOOD or the error of the range
+    */
+   UA_StatusCode convertToOPC(UA_Variant *value, const V *data, size_t length,
+                              const UA_NumericRange *range) {
+      UA_UInt32 dims = static_cast<UA_UInt32>(length);
+      return convertToOPC(value, data, &dims, 1, range);
+   }
+
+   template <typename V>
+   /**
+    * @brief Convert an index range of a std::vector to a open62541 Variant
+    * array, only the elements of the range are copied
+    * @param value the variant to fill
+    * @param uservec the vector to copy from
+    * @param range the range to convert, nullptr for the whole vector
+    * @return UA_STATUSCODE_GOOD or the error of the range
+    */
+   UA_StatusCode convertToOPC(UA_Variant *value, const std::vector<V> *uservec,
+                              const UA_NumericRange *range) {
+      return convertToOPC(value, uservec->data(), uservec->size(), range);
+   }
 
-      UA_Variant_setArray(value, arr, uservec->size(), &UA_TYPES[datatypenr]);
+   template <typename V>
+   /**
+    * @brief Convert an index range of a flat std::vector holding a
+    * multidimensional array to a open62541 Variant array, only the elements
+    * of the range are copied
+    * @param value the variant to fill
+    * @param uservec the elements in row major order
+    * @param dimensions the lengths of the dimensions
+    * @param range the range to convert, nullptr for the whole array
+    * @return UA_STATUSCODE_GOOD, UA_STATUSCODE_BADINTERNALERROR if the
+    * dimensions do not match the element count or the error of the range
+    */
+   UA_StatusCode convertToOPC(UA_Variant *value, const std::vector<V> *uservec,
+                              const std::vector<uint32_t> &dimensions,
+                              const UA_NumericRange *range) {
+      size_t count = dimensions.empty() ? 0 : 1;
+      for (uint32_t length : dimensions)
+         count *= length;
+      if (count != uservec->size())
+         return UA_STATUSCODE_BADINTERNALERROR;
+
+      return convertToOPC(value, uservec->data(), dimensions.data(),
+                          dimensions.size(), range);
    }
 
+   /**
+    * @brief Convert a std::vector of bools to a open62541 Variant array
+    * @param value the variant to fill
+    * @param uservec the vector to copy from
+    */
+   void convertToOPC(UA_Variant *value, const std::vector<bool> *uservec);
+
    /**
     * @brief Convert a std::vector to a open62541 Variant array
     * @param value the variant to fill
@@ -488,6 +770,17 @@ public:
    void convertToOPC(UA_Variant *value,
                      const std::vector<std::string> *uservec);
 
+   /**
+    * @brief Point a open62541 Variant at a borrowed buffer without copying,
+    * the variant does not own the data (UA_VARIANT_DATA_NODELETE)
+    * @param value the variant to fill
+    * @param buffer the buffer to lend
+    * @param range an optional one dimensional index range to lend
+    * @return UA_STATUSCODE_GOOD or the error of the range
+    */
+   UA_StatusCode lendToOPC(UA_Variant *value, const OpcUABorrowedBuffer *buffer,
+                           const UA_NumericRange *range = nullptr);
+
    /**
     * @brief Check if a open62541 Varaiant convertable to a std::vector
     * @param opcval the value to check
@@ -520,19 +813,45 @@ public:
     */
    void setOPCSourceTimeStamp(UA_DataValue *value, time_t time_point);
 
+   /**
+    * @brief Set the source timestamp of a value to an acquisition time
+    * @param value A value the timestamp should be set to
+    * @param time_point The timestamp to set, in the 100 ns of the system clock
+    */
+   void setOPCSourceTimeStamp(UA_DataValue *value,
+                              std::chrono::system_clock::time_point time_point);
+
    /**
     * @brief setOPCSourceTimeStampNow
     * @param value A value the timestamp should be set to
     *
-    * Set the source timestamp of a value to the current system time
+    * Set the source timestamp of a value to the current time, see
+    * OpcUAClock::cycleNow()
     */
    void setOPCSourceTimeStampNow(UA_DataValue *value);
 
+   /**
+    * @brief Set the server timestamp of a value to the current time, see
+    * OpcUAClock::cycleNow()
+    * @param value A value the timestamp should be set to
+    */
+   void setOPCServerTimeStampNow(UA_DataValue *value);
+
+   /**
+    * @brief Stamp a value read from its source with a single clock read,
+    * the server timestamp always and the source timestamp if requested and
+    * not already set by the source
+    * @param value A value the timestamps should be set to
+    * @param includeSourceTimeStamp if the source timestamp is set
+    */
+   void setOPCTimeStampsNow(UA_DataValue *value, bool includeSourceTimeStamp);
+
    /**
     * @brief writeToServer
     * @param var the varialbe to write to the server
     *
-    * Write a OPC Variable back to the server
+    * Write a OPC Variable back to the server, see
+    * OpcUANodeHandler::writeValues() to publish many values at once
     */
    void writeToServer(UA_Variant var);
 
@@ -558,6 +877,20 @@ OpcUAVarDataSourceReadCallback;
 typedef std::function<bool(UA_DataValue *value)>
 OpcUAVarDataSourceReadCallbackSimple;
 
+/**
+ * @brief Callback for a open62541 variable read method producing only the
+ * requested index range, see OpcUANodeContext::convertToOPC()
+ */
+typedef std::function<UA_StatusCode(const UA_NumericRange *range,
+                                    UA_DataValue *value)>
+OpcUAVarDataSourceReadCallbackRange;
+
+/**
+ * @brief Callback lending a buffer to the server for a variable read
+ */
+typedef std::function<bool(OpcUABorrowedBuffer *buffer)>
+OpcUAVarDataSourceReadCallbackBorrowed;
+
 /**
  * @brief Callback for a open62541 variable write method
  */
@@ -573,6 +906,17 @@ OpcUAVarDataSourceWriteCallback;
 typedef std::function<bool(const UA_DataValue *value)>
 OpcUAVarDataSourceWriteCallbackSimple;
 
+/**
+ * @brief The kind of deadband of a variable, like the OPC UA DeadbandType
+ */
+enum OpcUADeadbandType {
+   OpcUADeadbandNone,
+   /* a change up to the deadband value is suppressed */
+   OpcUADeadbandAbsolute,
+   /* the deadband value is a percentage of the engineering unit range */
+   OpcUADeadbandPercent
+};
+
 class OpcUAVarNodeContext: public OpcUANodeContext {
 private:
    /**
@@ -593,10 +937,58 @@ private:
     */
    OpcUAVarDataSourceReadCallbackSimple read_simple;
 
+   /**
+    * @brief Range aware read callback method for this variable
+    */
+   OpcUAVarDataSourceReadCallbackRange read_range;
+
+   /**
+    * @brief Borrowed (zero copy) read callback method for this variable
+    */
+   OpcUAVarDataSourceReadCallbackBorrowed read_borrowed;
+
+   /**
+    * @brief Last published value, served instead of the read callbacks
+    */
+   OpcUAValueCache cache;
+
+   /**
+    * @brief Last read callback result, reused for a while, see
+    * setReadMaxAge(). Created by the first max age set
+    */
+   std::atomic<OpcUAReadMemo *> memo;
+
    /**
     * @brief The variable node arrtibutes as used in open62541
     */
    UA_VariableAttributes varAttr;
+
+   /**
+    * @brief Producer side change filter, see setDeadband()
+    */
+   OpcUADeadbandType deadbandType;
+   /* the absolute band, also for percent deadbands */
+   double deadband;
+   bool suppressUnchanged;
+   /* the value of the last writeToServer() passing the filter */
+   UA_Variant lastWritten;
+   std::atomic<uint64_t> passedUpdates;
+   std::atomic<uint64_t> suppressedUpdates;
+
+   /**
+    * @brief Check a new value against the last one and count it
+    * @param value the new value
+    * @param last the last value passed, nullptr if none
+    * @return true if the value passes, else false
+    */
+   bool filterValue(const UA_Variant *value, const UA_Variant *last);
+
+protected:
+   /**
+    * @brief Check a value against the filter before writeToServer() writes it
+    */
+   bool acceptWrite(const UA_Variant *value);
+
 public:
    /**
     * @brief Constructor for this class
@@ -605,7 +997,15 @@ public:
     */
    OpcUAVarNodeContext(UA_NodeId *node, OpcUANodeHandler *nodeHandler):
       OpcUANodeContext(node, nodeHandler),
-      varAttr(UA_VariableAttributes_default) {}
+      memo(nullptr),
+      varAttr(UA_VariableAttributes_default),
+      deadbandType(OpcUADeadbandNone),
+      deadband(0),
+      suppressUnchanged(false),
+      passedUpdates(0),
+      suppressedUpdates(0) {
+      UA_Variant_init(&lastWritten);
+   }
 
    /**
     * @brief Constructor for this class
@@ -613,7 +1013,15 @@ public:
     */
    OpcUAVarNodeContext(OpcUANodeHandler *nodeHandler):
       OpcUANodeContext(nodeHandler),
-      varAttr(UA_VariableAttributes_default) {}
+      memo(nullptr),
+      varAttr(UA_VariableAttributes_default),
+      deadbandType(OpcUADeadbandNone),
+      deadband(0),
+      suppressUnchanged(false),
+      passedUpdates(0),
+      suppressedUpdates(0) {
+      UA_Variant_init(&lastWritten);
+   }
 
    /**
     * @brief Default deconstructor
@@ -642,6 +1050,26 @@ public:
       read_simple = method;
    }
 
+   /**
+    * @brief Set the range aware read method for this variable, it is given
+    * the index range of the read (nullptr for the whole value) and has to
+    * return only that slice. Reads of a simple read method are sliced after
+    * the whole value was converted.
+    * @param method The range aware read callback method
+    */
+   void setReadMethodRange(OpcUAVarDataSourceReadCallbackRange method) {
+      read_range = method;
+   }
+
+   /**
+    * @brief Set the borrowed read method for this variable, the buffer it
+    * returns is encoded without being copied
+    * @param method The borrowed read callback method
+    */
+   void setReadMethodBorrowed(OpcUAVarDataSourceReadCallbackBorrowed method) {
+      read_borrowed = method;
+   }
+
    /**
     * @brief Set the simple write method for this variable
     * @param method The simple write callback method
@@ -678,6 +1106,196 @@ public:
       return read_simple;
    }
 
+   /**
+    * @brief Return the range aware read callback method
+    * @return The range aware read callback method
+    */
+   OpcUAVarDataSourceReadCallbackRange getReadRange() {
+      return read_range;
+   }
+
+   /**
+    * @brief Return the borrowed read callback method
+    * @return The borrowed read callback method
+    */
+   OpcUAVarDataSourceReadCallbackBorrowed getReadBorrowed() {
+      return read_borrowed;
+   }
+
+   /**
+    * @brief Return a data source of its own, used instead of the callbacks
+    * of the node handler, see OpcUATypedVar
+    * @param source the data source to fill
+    * @return true if filled, else false
+    */
+   virtual bool getDataSource(UA_DataSource * /* source */) {
+      return false;
+   }
+
+   /**
+    * @brief Publish a new value of this variable, once a value is published
+    * all reads are served from it without calling the read callbacks, for
+    * the lifetime of the context. Only the value is filtered, see
+    * setDeadband(), a value with another status than the published one or
+    * without a value always passes
+    * @param value The value to publish
+    * @return true if published or suppressed by the filter, false if the
+    * variable has a data source of its own (see getDataSource()), which
+    * would not serve it, or the value could not be copied
+    */
+   bool publishDataValue(const UA_DataValue *value);
+
+   /**
+    * @brief Set a deadband for the values published or written to the
+    * server, numeric values changing less are suppressed. For arrays a
+    * change of any element counts
+    * @param type the kind of deadband, OpcUADeadbandNone to remove it
+    * @param value the band, or for OpcUADeadbandPercent the percentage
+    * @param euLow the low end of the engineering unit range, for percent
+    * @param euHigh the high end of the engineering unit range, for percent
+    * @return true if set, else false
+    */
+   bool setDeadband(OpcUADeadbandType type, double value, double euLow = 0,
+                    double euHigh = 0);
+
+   /**
+    * @brief Suppress values equal to the last one passed, for all types
+    * @param suppress true to suppress, else false
+    */
+   void setSuppressUnchanged(bool suppress) {
+      suppressUnchanged = suppress;
+   }
+
+   /**
+    * @brief Return the count of values which passed the filter
+    */
+   uint64_t getPassedCount() {
+      return passedUpdates.load(std::memory_order_relaxed);
+   }
+
+   /**
+    * @brief Return the count of values suppressed by the filter
+    */
+   uint64_t getSuppressedCount() {
+      return suppressedUpdates.load(std::memory_order_relaxed);
+   }
+
+   template <typename T>
+   /**
+    * @brief Publish a new value of this variable, stamped with the current
+    * time as source timestamp
+    * @param value The value to publish
+    * @return true if published, else false
+    */
+   bool publishValue(const T &value) {
+      return publishValue(value, OpcUAClock::cycleNow());
+   }
+
+   template <typename T>
+   /**
+    * @brief Publish a new value of this variable with the time it was
+    * acquired as source timestamp
+    * @param value The value to publish
+    * @param sourceTimestamp the acquisition time, see OpcUAClock
+    * @return true if published, else false
+    */
+   bool publishValue(const T &value, UA_DateTime sourceTimestamp) {
+      UA_DataValue dv;
+      UA_DataValue_init(&dv);
+      convertToOPC(&dv, &value);
+      dv.sourceTimestamp = sourceTimestamp;
+      dv.hasSourceTimestamp = true;
+
+      bool ret = publishDataValue(&dv);
+      UA_DataValue_deleteMembers(&dv);
+      return ret;
+   }
+
+   template <typename V>
+   /**
+    * @brief Update elements of the published array of this variable in
+    * place, the change is seen by readers after publishRanges(). Changes of
+    * overlapping or adjacent elements are merged until then. Elements equal
+    * to the staged ones are not marked as changed if setSuppressUnchanged()
+    * is set, the deadband does not apply
+    * @param first the first element to update
+    * @param data the new elements
+    * @param count the count of elements
+    * @return true if updated or unchanged, false if the published value is
+    * no array of V or the range is out of its bounds
+    */
+   bool updateRange(size_t first, const V *data, size_t count) {
+      static_assert(std::is_arithmetic<V>::value,
+                    "Only arrays of numbers can be updated in place");
+
+      size_t length = 0;
+      V *staged = static_cast<V *>(
+            cache.stage(UaTypeTraits<V>::dataType(), &length));
+      if (!staged || first > length || count > length - first)
+         return false;
+
+      if (suppressUnchanged &&
+          memcmp(staged + first, data, count * sizeof(V)) == 0) {
+         suppressedUpdates.fetch_add(1, std::memory_order_relaxed);
+         return true;
+      }
+      convertElements(staged + first, data, count);
+      cache.markDirty(first, count);
+      passedUpdates.fetch_add(1, std::memory_order_relaxed);
+      return true;
+   }
+
+   /**
+    * @brief Publish the elements changed by updateRange() since the last
+    * publish, stamped with the current time as source timestamp. Only the
+    * changed elements are copied, see OpcUAValueCache::publishStaged()
+    * @return true if published or nothing changed, else false
+    */
+   bool publishRanges() {
+      return cache.publishStaged(OpcUAClock::cycleNow(), getServer());
+   }
+
+   /**
+    * @brief Publish the elements changed by updateRange() since the last
+    * publish with the time they were acquired as source timestamp
+    * @param sourceTimestamp the acquisition time, see OpcUAClock
+    * @return true if published or nothing changed, else false
+    */
+   bool publishRanges(UA_DateTime sourceTimestamp) {
+      return cache.publishStaged(sourceTimestamp, getServer());
+   }
+
+   /**
+    * @brief Return the published value cache of this variable
+    * @return The cache
+    */
+   OpcUAValueCache *getCache() {
+      return &cache;
+   }
+
+   /**
+    * @brief Reuse the result of the read, range read or simple read callback
+    * for a while. Reads of a fresh result don't call the callback, reads
+    * while the callback runs wait for its result. A successful write drops
+    * the result. The callback is called for the whole value and the result
+    * is shared by all sessions. Reads of an index range are sliced from the
+    * whole value, except for the read and range read callbacks, which are
+    * called with the range instead, so a small range never costs a copy of
+    * a large array
+    * @param maxAge how long a result is reused, 0 to call the callback for
+    * every read
+    */
+   void setReadMaxAge(std::chrono::nanoseconds maxAge);
+
+   /**
+    * @brief Return the reused read result of this variable and its hit and
+    * miss counters
+    * @return The memo, nullptr if no max age was set yet
+    */
+   OpcUAReadMemo *getReadMemo() {
+      return memo.load(std::memory_order_acquire);
+   }
+
 
    /**
     * @brief Set the attribute name to the node
@@ -714,6 +1332,14 @@ public:
     */
    void setAttrWriteable();
 
+   /**
+    * @brief Return the node class of this node
+    * @return UA_NODECLASS_VARIABLE
+    */
+   UA_NodeClass getNodeClass() {
+      return UA_NODECLASS_VARIABLE;
+   }
+
    /**
     * @brief Return the Attributes for this variable node
     * @return The Variable Attriibute structure
@@ -830,6 +1456,14 @@ public:
       return objtype;
    }
 
+   /**
+    * @brief Return the node class of this node
+    * @return UA_NODECLASS_OBJECT
+    */
+   UA_NodeClass getNodeClass() {
+      return UA_NODECLASS_OBJECT;
+   }
+
    /**
     * @brief Returns the objects attrubute structure
     * @return the object structure
@@ -977,6 +1611,14 @@ public:
     */
    ~OpcUAMethodNodeContext();
 
+   /**
+    * @brief Return the node class of this node
+    * @return UA_NODECLASS_METHOD
+    */
+   UA_NodeClass getNodeClass() {
+      return UA_NODECLASS_METHOD;
+   }
+
    /**
     * @brief Return the Method nodes attribute structure
     * @return the method node structure
@@ -1016,15 +1658,11 @@ public:
     * @param argType The templateble type of the argument
     * @return True if the argument got initialized, else false
     */
-   bool initInputArgumentType(uint64_t argNum, T argType) {
+   bool initInputArgumentType(uint64_t argNum, const T & /* argType */) {
       if (argNum > inArgumentCount)
          return false;
 
-      int16_t type = convertTypeToOpen62541Type(argType);
-      if ((type < 0) && (type > UA_TYPES_COUNT))
-         return false;
-
-      inputArguments[argNum].dataType = UA_TYPES[type].typeId;
+      inputArguments[argNum].dataType = UaTypeTraits<T>::dataType()->typeId;
 
       return true;
    }
@@ -1036,17 +1674,12 @@ public:
     * @param argType The templateble type of the argument
     * @return True if the argument got initialized, else false
     */
-   bool initInputArgumentType(uint64_t argNum, std::vector<T> argType) {
+   bool initInputArgumentType(uint64_t argNum,
+                              const std::vector<T> & /* argType */) {
       if (argNum > inArgumentCount)
          return false;
 
-      T element;
-
-      int16_t type = convertTypeToOpen62541Type(element);
-      if ((type < 0) && (type > UA_TYPES_COUNT))
-         return false;
-
-      inputArguments[argNum].dataType = UA_TYPES[type].typeId;
+      inputArguments[argNum].dataType = UaTypeTraits<T>::dataType()->typeId;
 
       return true;
    }
@@ -1058,15 +1691,11 @@ public:
     * @param argType The templateble type of the argument
     * @return True if the argument got initialized, else false
     */
-   bool initOutputArgumentType(uint64_t argNum, T argType) {
+   bool initOutputArgumentType(uint64_t argNum, const T & /* argType */) {
       if (argNum > outArgumentCount)
          return false;
 
-      int16_t type = convertTypeToOpen62541Type(argType);
-      if ((type < 0) && (type > UA_TYPES_COUNT))
-         return false;
-
-      outputArguments[argNum].dataType = UA_TYPES[type].typeId;
+      outputArguments[argNum].dataType = UaTypeTraits<T>::dataType()->typeId;
 
       return true;
    }
@@ -1078,18 +1707,12 @@ public:
     * @param argType The templateble type of the argument
     * @return True if the argument got initialized, else false
     */
-   bool initOutputArgumentType(uint64_t argNum, std::vector<T> argType) {
+   bool initOutputArgumentType(uint64_t argNum,
+                               const std::vector<T> & /* argType */) {
       if (argNum > outArgumentCount)
          return false;
 
-      T element;
-
-      int16_t type = convertTypeToOpen62541Type(element);
-
-      if ((type < 0) && (type > UA_TYPES_COUNT))
-         return false;
-
-      outputArguments[argNum].dataType = UA_TYPES[type].typeId;
+      outputArguments[argNum].dataType = UaTypeTraits<T>::dataType()->typeId;
 
       return true;
    }
@@ -1233,6 +1856,15 @@ public:
    OpcUAMethodCallbackSimple getCallbackSimple() {
       return callbackSimple;
    }
+
+   /**
+    * @brief Return a method callback of its own, used instead of the
+    * callbacks of the node handler, see OpcUATypedMethod
+    * @return The callback or nullptr
+    */
+   virtual UA_MethodCallback getMethodCallback() {
+      return nullptr;
+   }
 };
 
 } /* namespace n_opcua */
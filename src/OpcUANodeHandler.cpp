@@ -6,11 +6,19 @@
  * <tobias.johannes.klausmann@mni.thm.de>
  */
 
+#include <algorithm>
+#include <cstring>
+#include <memory>
 #include "OpcUANodeHandler.h"
 
 namespace n_opcua {
 
-OpcUANodeHandler::OpcUANodeHandler(OpcUAServer *server): _server(server) {
+OpcUANodeHandler::OpcUANodeHandler(OpcUAServer *server):
+   _server(server),
+   nodesAdded(false),
+   statsEnabled(false),
+   statsNamespace(0),
+   statsRoot(nullptr) {
 
 }
 
@@ -18,27 +26,36 @@ OpcUANodeHandler::~OpcUANodeHandler() {
    deleteAllNodes();
 }
 
-bool OpcUANodeHandler::findNodeInIndex(UA_NodeId* node, nodeMapIterator *mapIter) {
-   nodeMapIterator lIter;
-   lIter = nodemap.find(node);
-   if (lIter == nodemap.end())
+bool OpcUANodeHandler::findNodeInIndex(const UA_NodeId* node, OpcUANodeContext **ctx) {
+   std::lock_guard<std::recursive_mutex> guard(lock);
+   OpcUANodeContext *found = nodeindex.find(node);
+   if (!found)
       return false;
 
-   if (mapIter)
-      *mapIter = lIter;
+   if (ctx)
+      *ctx = found;
    return true;
 }
 
 bool OpcUANodeHandler::addNodeToIndex(UA_NodeId *node, OpcUANodeContext *ctx) {
-   if (findNodeInIndex(node))
-      // Node already in index
+   std::lock_guard<std::recursive_mutex> guard(lock);
+   if (!ctx)
       return false;
 
-   using namespace std;
+   if (node != ctx->getNodeId() && !UA_NodeId_equal(node, ctx->getNodeId()))
+      // The index only knows the NodeId of the context itself
+      return false;
 
-   pair<unordered_map<UA_NodeId*, OpcUANodeContext*>::iterator, bool> p;
-   p = nodemap.emplace(node, ctx);
-   return p.second;
+   if (!nodeset.insert(ctx).second)
+      // Node already in index
+      return false;
+
+   // Contexts without a valid NodeId yet are indexed once they got one
+   if (OpcUANodeIndex::keyOf(ctx->getNodeId()) == 0)
+      return true;
+   // A NodeId of another context is not taken over, the caller has to
+   // know that lookups of the NodeId do not find this context
+   return nodeindex.insert(ctx->getNodeId(), ctx);
 }
 
 bool OpcUANodeHandler::addNodeToIndex(OpcUANodeContext *ctx) {
@@ -46,37 +63,133 @@ bool OpcUANodeHandler::addNodeToIndex(OpcUANodeContext *ctx) {
 }
 
 bool OpcUANodeHandler::removeNodeFromIndex(UA_NodeId *node) {
-   nodeMapIterator lIter;
-   if (!findNodeInIndex(node, &lIter))
+   OpcUANodeContext *ctx;
+   if (!findNodeInIndex(node, &ctx))
       // Node not found in Index, we can't remove it
       return false;
-   nodemap.erase(lIter);
+   return removeNodeFromIndex(ctx);
+}
+
+bool OpcUANodeHandler::removeNodeFromIndex(OpcUANodeContext *ctx) {
+   std::lock_guard<std::recursive_mutex> guard(lock);
+   if (nodeset.erase(ctx) == 0)
+      return false;
+
+   nodeindex.erase(ctx->getNodeId(), ctx);
    return true;
+}
+
+bool OpcUANodeHandler::indexNodeId(OpcUANodeContext *ctx) {
+   std::lock_guard<std::recursive_mutex> guard(lock);
+   if (nodeset.find(ctx) == nodeset.end())
+      return false;
+   // A NodeId for the server to assign is indexed once it is assigned
+   if (OpcUANodeIndex::keyOf(ctx->getNodeId()) == 0)
+      return true;
+   return nodeindex.insert(ctx->getNodeId(), ctx);
+}
+
+bool OpcUANodeHandler::unindexNodeId(OpcUANodeContext *ctx) {
+   std::lock_guard<std::recursive_mutex> guard(lock);
+   return nodeindex.erase(ctx->getNodeId(), ctx);
+}
+
+std::string OpcUANodeHandler::getNodePath(OpcUANodeContext *ctx) {
+   std::lock_guard<std::recursive_mutex> guard(lock);
+   std::vector<const UA_String *> names;
+   for (; ctx; ctx = ctx->getParentContext()) {
+      const UA_String *name = &ctx->getQualifiedName()->name;
+      if (name->length == 0)
+         return std::string();
+      names.push_back(name);
+   }
 
+   std::string path;
+   for (size_t i = names.size(); i > 0; i--) {
+      if (!path.empty())
+         path.push_back('/');
+      path.append(reinterpret_cast<const char *>(names[i - 1]->data),
+                  names[i - 1]->length);
+   }
+   return path;
+}
+
+bool OpcUANodeHandler::findNodeByPath(const std::string &path,
+                                      OpcUANodeContext **ctx) {
+   std::lock_guard<std::recursive_mutex> guard(lock);
+   OpcUANodeContext *found = pathindex.find(path);
+   if (!found)
+      return false;
+
+   if (ctx)
+      *ctx = found;
+   return true;
+}
+
+size_t OpcUANodeHandler::findNodesByPathPrefix(
+      const std::string &prefix, std::vector<OpcUANodeContext *> *nodes) {
+   std::lock_guard<std::recursive_mutex> guard(lock);
+   return pathindex.findPrefix(prefix, nodes);
+}
+
+bool OpcUANodeHandler::updatePaths(OpcUANodeContext *ctx, std::string *path,
+                                   bool add) {
+   bool ret = true;
+   if (add)
+      ret = pathindex.insert(*path, ctx);
+   else
+      pathindex.erase(*path, ctx);
+
+   size_t length = path->size();
+   for (OpcUANodeContext *child : ctx->getChildren()) {
+      const UA_String *name = &child->getQualifiedName()->name;
+      /* a child keeping another parent is not on this path */
+      if (name->length == 0 || child->getParentContext() != ctx)
+         continue;
+
+      path->push_back('/');
+      path->append(reinterpret_cast<const char *>(name->data), name->length);
+      if (!updatePaths(child, path, add))
+         ret = false;
+      path->resize(length);
+   }
+   return ret;
+}
+
+bool OpcUANodeHandler::indexPaths(OpcUANodeContext *ctx) {
+   std::lock_guard<std::recursive_mutex> guard(lock);
+   std::string path = getNodePath(ctx);
+   if (path.empty())
+      return true;
+   return updatePaths(ctx, &path, true);
+}
+
+void OpcUANodeHandler::unindexPaths(OpcUANodeContext *ctx) {
+   std::lock_guard<std::recursive_mutex> guard(lock);
+   std::string path = getNodePath(ctx);
+   if (!path.empty())
+      updatePaths(ctx, &path, false);
 }
 
 bool OpcUANodeHandler::getNodePairFromIndex(UA_NodeId *node, nodeMapPair *p) {
-   nodeMapIterator lIter;
-   if (!findNodeInIndex(node, &lIter)) {
+   OpcUANodeContext *ctx;
+   if (!findNodeInIndex(node, &ctx)) {
       // Not found in the Index, we can't return it
       return false;
    }
 
    if (p) {
-      p->first = lIter->first;
-      p->second = lIter->second;
+      p->first = ctx->getNodeId();
+      p->second = ctx;
    }
    return true;
 }
 
-bool OpcUANodeHandler::getCtxFromIndexByNode(UA_NodeId *node, OpcUANodeContext *ctx) {
-   nodeMapIterator lIter;
-   if (!findNodeInIndex(node, &lIter)) {
+bool OpcUANodeHandler::getCtxFromIndexByNode(UA_NodeId *node, OpcUANodeContext **ctx) {
+   if (!findNodeInIndex(node, ctx)) {
       // Not found in the Index, we can't return it
       return false;
    }
-
-   ctx = lIter->second;
    return true;
 }
 
@@ -84,34 +197,73 @@ bool OpcUANodeHandler::getCtxFromIndexByNode(UA_NodeId *node, OpcUANodeContext *
  *
  */
 OpcUANodeContext *OpcUANodeHandler::initNewNodeAndAddToIndex(OpcUANodeContext *ctx) {
+   std::lock_guard<std::recursive_mutex> guard(lock);
    if (!ctx)
-      ctx = new OpcUANodeContext(this);
+      ctx = new (this) OpcUANodeContext(this);
 
-   if (!addNodeToIndex(ctx->getNodeId(), ctx)) {
+   // Contexts of this handler already add themselves on construction
+   if (nodeset.find(ctx) == nodeset.end() &&
+       !addNodeToIndex(ctx->getNodeId(), ctx)) {
       delete ctx;
       return NULL;
    }
    return ctx;
 }
 
+bool OpcUANodeHandler::addReplica(OpcUAServer *replica) {
+   std::lock_guard<std::recursive_mutex> guard(lock);
+   if (!checkServer() || nodesAdded || !replica || !replica->getServer() ||
+       replica == _server ||
+       std::find(replicas.begin(), replicas.end(), replica) != replicas.end())
+      return false;
+
+   replicas.push_back(replica);
+   /* the loops of the replicas read the contexts of our server */
+   _server->setSharedNodes(true);
+   return true;
+}
+
+uint16_t OpcUANodeHandler::addNamespace(const std::string &ns) {
+   std::lock_guard<std::recursive_mutex> guard(lock);
+   uint16_t index = _server->addNamespace(ns);
+   /* the replicas share the NodeIds, so they need the same index */
+   for (size_t i = 0; i < replicas.size(); i++)
+      if (replicas[i]->addNamespace(ns) != index)
+         return 0;
+   return index;
+}
+
+/* give a context the NodeId the server assigned, which reindexes it */
+static UA_StatusCode adoptNodeId(OpcUANodeContext *ctx,
+                                 const UA_NodeId *assigned) {
+   if (UA_NodeId_equal(assigned, ctx->getNodeId()) ||
+       ctx->setNodeId(assigned))
+      return UA_STATUSCODE_GOOD;
+   return UA_STATUSCODE_BADNODEIDEXISTS;
+}
+
 bool OpcUANodeHandler::addVariableCallbackNodeDataSourceToServer(OpcUAVarNodeContext *ctx) {
 
    if (!checkServer())
       return false;
 
-   if (!ctx->getReadable() && !ctx->getWriteable())
-      return false;
-
+   /* a variable neither readable nor writeable is valid, e.g. an
+    * AccessLevel of 0 in a NodeSet, the server then refuses all access */
    ctx->setServer(getServer());
 
    UA_DataSource dataSource;
-   dataSource.read = readCallback;
-   dataSource.write = writeCallback;
+   if (!ctx->getDataSource(&dataSource)) {
+      dataSource.read = readCallback;
+      dataSource.write = writeCallback;
+   }
 
    UA_NodeId parentReferenceNodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
    UA_NodeId variableTypeNodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE);
 
-   UA_Server_addDataSourceVariableNode(_server->getServer(),
+   UA_NodeId assigned;
+   UA_NodeId_init(&assigned);
+   UA_StatusCode retval;
+   retval = UA_Server_addDataSourceVariableNode(_server->getServer(),
                                        *ctx->getNodeId(),
                                        *ctx->getParent(),
                                        parentReferenceNodeId,
@@ -120,8 +272,24 @@ bool OpcUANodeHandler::addVariableCallbackNodeDataSourceToServer(OpcUAVarNodeCon
                                        *ctx->getVariableAttr(),
                                        dataSource,
                                        ctx,
-                                       nullptr);
-   return true;
+                                       &assigned);
+   /* the context and the replicas get the NodeId the server assigned */
+   if (retval == UA_STATUSCODE_GOOD)
+      retval = adoptNodeId(ctx, &assigned);
+   for (size_t i = 0; i < replicas.size() && retval == UA_STATUSCODE_GOOD; i++)
+      retval = UA_Server_addDataSourceVariableNode(replicas[i]->getServer(),
+                                          assigned,
+                                          *ctx->getParent(),
+                                          parentReferenceNodeId,
+                                          *ctx->getQualifiedName(),
+                                          variableTypeNodeId,
+                                          *ctx->getVariableAttr(),
+                                          dataSource,
+                                          ctx,
+                                          nullptr);
+   UA_NodeId_deleteMembers(&assigned);
+   nodesAdded = true;
+   return retval == UA_STATUSCODE_GOOD;
 
 }
 
@@ -129,12 +297,26 @@ bool OpcUANodeHandler::addObjectNodeToServer(OpcUAObjectNodeContext *ctx) {
    if (!checkServer())
       return false;
 
-   UA_Server_addObjectNode(_server->getServer(), *ctx->getNodeId(), *ctx->getParent(),
+   UA_NodeId assigned;
+   UA_NodeId_init(&assigned);
+   UA_StatusCode retval;
+   retval = UA_Server_addObjectNode(_server->getServer(), *ctx->getNodeId(), *ctx->getParent(),
             UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES), *ctx->getQualifiedName(),
             UA_NODEID_NUMERIC(0, ctx->getObjectType()), *ctx->getObjectAttr(),
-            ctx, ctx->getNodeId());
-
-   return true;
+            ctx, &assigned);
+   /* the context and the replicas get the NodeId the server assigned */
+   if (retval == UA_STATUSCODE_GOOD)
+      retval = adoptNodeId(ctx, &assigned);
+   for (size_t i = 0; i < replicas.size() && retval == UA_STATUSCODE_GOOD; i++)
+      retval = UA_Server_addObjectNode(replicas[i]->getServer(),
+               assigned, *ctx->getParent(),
+               UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES), *ctx->getQualifiedName(),
+               UA_NODEID_NUMERIC(0, ctx->getObjectType()), *ctx->getObjectAttr(),
+               ctx, nullptr);
+   UA_NodeId_deleteMembers(&assigned);
+
+   nodesAdded = true;
+   return retval == UA_STATUSCODE_GOOD;
 }
 
 bool OpcUANodeHandler::addMethodNodeToServer(OpcUAMethodNodeContext *ctx) {
@@ -143,10 +325,14 @@ bool OpcUANodeHandler::addMethodNodeToServer(OpcUAMethodNodeContext *ctx) {
 
    ctx->setServer(getServer());
 
-   UA_MethodCallback callback;
-   callback = &onMethodCallCallback;
+   UA_MethodCallback callback = ctx->getMethodCallback();
+   if (!callback)
+      callback = &onMethodCallCallback;
 
-   UA_Server_addMethodNode(_server->getServer(), *ctx->getNodeId(),
+   UA_NodeId assigned;
+   UA_NodeId_init(&assigned);
+   UA_StatusCode retval;
+   retval = UA_Server_addMethodNode(_server->getServer(), *ctx->getNodeId(),
                            *ctx->getParent(),
                            UA_NODEID_NUMERIC(0, UA_NS0ID_HASORDEREDCOMPONENT),
                            *ctx->getQualifiedName(),
@@ -155,9 +341,118 @@ bool OpcUANodeHandler::addMethodNodeToServer(OpcUAMethodNodeContext *ctx) {
                            ctx->getOutputArgumentCount(),
                            ctx->getOutputArguments(),
                            ctx,
-                           ctx->getNodeId());
+                           &assigned);
+   /* the context and the replicas get the NodeId the server assigned */
+   if (retval == UA_STATUSCODE_GOOD)
+      retval = adoptNodeId(ctx, &assigned);
+   for (size_t i = 0; i < replicas.size() && retval == UA_STATUSCODE_GOOD; i++)
+      retval = UA_Server_addMethodNode(replicas[i]->getServer(),
+                           assigned, *ctx->getParent(),
+                           UA_NODEID_NUMERIC(0, UA_NS0ID_HASORDEREDCOMPONENT),
+                           *ctx->getQualifiedName(),
+                           *ctx->getMethodAttr(), callback,
+                           ctx->getInputArgumentCount(), ctx->getInputArguments(),
+                           ctx->getOutputArgumentCount(),
+                           ctx->getOutputArguments(),
+                           ctx,
+                           nullptr);
+   UA_NodeId_deleteMembers(&assigned);
 
-   return true;
+   nodesAdded = true;
+   return retval == UA_STATUSCODE_GOOD;
+}
+
+bool OpcUANodeHandler::addNodeToServer(OpcUANodeContext *ctx) {
+   switch (ctx->getNodeClass()) {
+   case UA_NODECLASS_VARIABLE:
+      return addVariableCallbackNodeDataSourceToServer(
+            static_cast<OpcUAVarNodeContext *>(ctx));
+   case UA_NODECLASS_OBJECT:
+      return addObjectNodeToServer(static_cast<OpcUAObjectNodeContext *>(ctx));
+   case UA_NODECLASS_METHOD:
+      return addMethodNodeToServer(static_cast<OpcUAMethodNodeContext *>(ctx));
+   default:
+      return false;
+   }
+}
+
+size_t OpcUANodeHandler::addNodesToServer(OpcUANodeContext *const *ctxs,
+                                          size_t count) {
+   if (!checkServer() || !ctxs)
+      return 0;
+
+   /* the setters keep the attributes ready, so this is the server's work
+    * only, and the server itself is not thread safe */
+   size_t added = 0;
+   for (size_t i = 0; i < count; i++) {
+      if (ctxs[i] && addNodeToServer(ctxs[i]))
+         added++;
+   }
+   return added;
+}
+
+size_t OpcUANodeHandler::addNodesToServer(
+      const std::vector<OpcUANodeContext *> &ctxs) {
+   return addNodesToServer(ctxs.data(), ctxs.size());
+}
+
+size_t OpcUANodeHandler::writeValues(const OpcUAValueUpdate *updates,
+                                     size_t count) {
+   if (!updates || count == 0)
+      return 0;
+
+   std::lock_guard<std::recursive_mutex> guard(lock);
+
+   /* room for twice the updates keeps the probe sequences short */
+   size_t slots = 16;
+   while (slots < count * 2)
+      slots <<= 1;
+   batchSeen.assign(slots, nullptr);
+
+   /* one timestamp for the whole batch, like one PLC poll cycle */
+   UA_DataValue dv;
+   UA_DataValue_init(&dv);
+   dv.hasValue = true;
+   dv.sourceTimestamp = OpcUAClock::cycleNow();
+   dv.hasSourceTimestamp = true;
+   dv.serverTimestamp = dv.sourceTimestamp;
+   dv.hasServerTimestamp = true;
+   UA_DateTime batchTimestamp = dv.sourceTimestamp;
+
+   size_t published = 0;
+   /* backwards, so the last update of a variable is the one kept */
+   for (size_t i = count; i-- > 0;) {
+      OpcUAVarNodeContext *ctx = updates[i].ctx;
+      if (!ctx || !updates[i].value)
+         continue;
+
+      uint64_t key = (uint64_t) reinterpret_cast<uintptr_t>(ctx);
+      size_t slot = (key * 0x9E3779B97F4A7C15ull >> 32) & (slots - 1);
+      while (batchSeen[slot] && batchSeen[slot] != ctx)
+         slot = (slot + 1) & (slots - 1);
+      if (batchSeen[slot])
+         continue;
+      batchSeen[slot] = ctx;
+
+      /* a shallow copy, the cache takes its own deep copy */
+      dv.value = *updates[i].value;
+      dv.sourceTimestamp = updates[i].sourceTimestamp ?
+                           updates[i].sourceTimestamp : batchTimestamp;
+      if (ctx->publishDataValue(&dv))
+         published++;
+   }
+   return published;
+}
+
+size_t OpcUANodeHandler::writeValues(
+      const std::vector<OpcUAValueUpdate> &updates) {
+   return writeValues(updates.data(), updates.size());
+}
+
+void OpcUANodeHandler::reserveNodes(size_t count) {
+   std::lock_guard<std::recursive_mutex> guard(lock);
+   nodeset.reserve(count);
+   nodeindex.reserve(count);
 }
 
 /**
@@ -165,35 +460,335 @@ bool OpcUANodeHandler::addMethodNodeToServer(OpcUAMethodNodeContext *ctx) {
  * \ node The node to delete
  */
 bool OpcUANodeHandler::deleteNode(UA_NodeId *node) {
-   nodeMapPair pair;
+   std::lock_guard<std::recursive_mutex> guard(lock);
    OpcUANodeContext *ctx = nullptr;
-   if (getNodePairFromIndex(node, &pair)) {
-      ctx = pair.second;
-      removeNodeFromIndex(node);
-   }
-
-   // TODO: Update parent and all children and modify in the server instance and
-   // change the below
+   if (findNodeInIndex(node, &ctx))
+      return deleteNode(ctx);
 
    if (checkServer())
       UA_Server_deleteNode(_server->getServer(), *node, true);
+   for (size_t i = 0; i < replicas.size(); i++)
+      UA_Server_deleteNode(replicas[i]->getServer(), *node, true);
 
-   if (ctx)
+   return true;
+}
+
+void OpcUANodeHandler::collectSubtree(OpcUANodeContext *root,
+                                      std::vector<OpcUANodeContext *> *order) {
+   /* level by level, every parent is unlinked from its children on the way
+    * and comes before them */
+   size_t next = order->size();
+   order->push_back(root);
+   while (next < order->size())
+      (*order)[next++]->detachChildren(order);
+}
+
+void OpcUANodeHandler::deleteContexts(
+      const std::vector<OpcUANodeContext *> &order) {
+   bool onServer = checkServer();
+
+   /* children first, so the server never walks references of a node whose
+    * children are deleted after it */
+   for (size_t i = order.size(); i > 0; i--) {
+      OpcUANodeContext *ctx = order[i - 1];
+      removeNodeFromIndex(ctx);
+      if (ctx == statsRoot)
+         statsRoot = nullptr;
+      if (onServer)
+         UA_Server_deleteNode(_server->getServer(), *ctx->getNodeId(), true);
+      for (size_t r = 0; r < replicas.size(); r++)
+         UA_Server_deleteNode(replicas[r]->getServer(), *ctx->getNodeId(),
+                              true);
       delete ctx;
+   }
+}
 
-   return true;
+bool OpcUANodeHandler::deleteNode(OpcUANodeContext *ctx) {
+   std::lock_guard<std::recursive_mutex> guard(lock);
+   if (!ctx)
+      return false;
 
+   unindexPaths(ctx);
+   if (ctx->getParentContext())
+      ctx->getParentContext()->detachChild(ctx);
+
+   std::vector<OpcUANodeContext *> subtree;
+   collectSubtree(ctx, &subtree);
+   deleteContexts(subtree);
+   return true;
 }
 
 void OpcUANodeHandler::deleteAllNodes() {
-   nodeMapIterator lIter = nodemap.begin();
+   std::lock_guard<std::recursive_mutex> guard(lock);
+   std::vector<OpcUANodeContext *> roots;
+   for (OpcUANodeContext *ctx : nodeset) {
+      OpcUANodeContext *parent = ctx->getParentContext();
+      if (!parent || nodeset.find(parent) == nodeset.end())
+         roots.push_back(ctx);
+   }
+
+   /* collecting unlinks the children, so the roots are known before */
+   std::vector<OpcUANodeContext *> order;
+   order.reserve(nodeset.size());
+   for (size_t i = 0; i < roots.size(); i++)
+      collectSubtree(roots[i], &order);
+
+   /* every context goes, so the index is dropped as a whole */
+   nodeindex.clear();
+   pathindex.clear();
+   nodeset.clear();
+   deleteContexts(order);
+   /* no context is left, so the slabs are freed at once */
+   arena.release();
+}
 
-   while (lIter != nodemap.end()) {
-      UA_NodeId *node = lIter->first;
-      OpcUANodeContext *ctx = lIter->second;
-      deleteNode(node);
-      lIter = nodemap.begin();
+/* slot count of the type name table, a power of two */
+static const size_t typeNameSlots = 64;
+
+/* hash of a type name, the multiplier is chosen so no two names below share
+ * a slot */
+static inline size_t typeNameHash(const char *name) {
+   uint32_t h = 0;
+   while (*name)
+      h = (h ^ (uint8_t) *name++) * 3609u;
+   return (h >> 16) & (typeNameSlots - 1);
+}
+
+/* NodeSet2 names of the builtin types and their common aliases, each in the
+ * slot of its hash */
+static const struct {
+   const char *name;
+   int16_t typeIndex;
+} typeNameTable[typeNameSlots] = {
+   {nullptr, -1},
+   {"UtcTime", UA_TYPES_DATETIME},
+   {nullptr, -1},
+   {nullptr, -1},
+   {"Duration", UA_TYPES_DOUBLE},
+   {"LocalizedText", UA_TYPES_LOCALIZEDTEXT},
+   {"Boolean", UA_TYPES_BOOLEAN},
+   {nullptr, -1},
+   {nullptr, -1},
+   {"Int16", UA_TYPES_INT16},
+   {nullptr, -1},
+   {nullptr, -1},
+   {"UInt64", UA_TYPES_UINT64},
+   {"String", UA_TYPES_STRING},
+   {nullptr, -1},
+   {nullptr, -1},
+   {nullptr, -1},
+   {nullptr, -1},
+   {nullptr, -1},
+   {nullptr, -1},
+   {nullptr, -1},
+   {"ByteString", UA_TYPES_BYTESTRING},
+   {nullptr, -1},
+   {nullptr, -1},
+   {"Byte", UA_TYPES_BYTE},
+   {"NodeId", UA_TYPES_NODEID},
+   {nullptr, -1},
+   {"Int64", UA_TYPES_INT64},
+   {nullptr, -1},
+   {"Float", UA_TYPES_FLOAT},
+   {"DiagnosticInfo", UA_TYPES_DIAGNOSTICINFO},
+   {"Variant", UA_TYPES_VARIANT},
+   {nullptr, -1},
+   {"Guid", UA_TYPES_GUID},
+   {nullptr, -1},
+   {"SByte", UA_TYPES_SBYTE},
+   {nullptr, -1},
+   {"StatusCode", UA_TYPES_STATUSCODE},
+   {"XmlElement", UA_TYPES_XMLELEMENT},
+   {"QualifiedName", UA_TYPES_QUALIFIEDNAME},
+   {nullptr, -1},
+   {nullptr, -1},
+   {"DataValue", UA_TYPES_DATAVALUE},
+   {"LocaleId", UA_TYPES_STRING},
+   {nullptr, -1},
+   {nullptr, -1},
+   {"UInt32", UA_TYPES_UINT32},
+   {nullptr, -1},
+   {nullptr, -1},
+   {"DateTime", UA_TYPES_DATETIME},
+   {"ExpandedNodeId", UA_TYPES_EXPANDEDNODEID},
+   {"BaseDataType", UA_TYPES_VARIANT},
+   {nullptr, -1},
+   {nullptr, -1},
+   {"ExtensionObject", UA_TYPES_EXTENSIONOBJECT},
+   {nullptr, -1},
+   {nullptr, -1},
+   {nullptr, -1},
+   {"Int32", UA_TYPES_INT32},
+   {nullptr, -1},
+   {"UInt16", UA_TYPES_UINT16},
+   {nullptr, -1},
+   {"Structure", UA_TYPES_EXTENSIONOBJECT},
+   {"Double", UA_TYPES_DOUBLE},
+};
+
+int16_t OpcUANodeHandler::mapDataTypeToName(const char* datatypename) {
+   if (!datatypename)
+      return -1;
+
+   size_t slot = typeNameHash(datatypename);
+   if (!typeNameTable[slot].name ||
+       strcmp(typeNameTable[slot].name, datatypename) != 0)
+      return -1;
+   return typeNameTable[slot].typeIndex;
+}
+
+void OpcUANodeHandler::setStatsEnabled(bool enabled, unsigned sampleShift) {
+   if (enabled)
+      OpcUACallStats::calibrate();
+   OpcUACallStats::setSampling(sampleShift);
+   statsEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool OpcUANodeHandler::getNodeStats(const UA_NodeId *node,
+                                    OpcUANodeStatsSnapshot *snapshot) {
+   std::lock_guard<std::recursive_mutex> guard(lock);
+   OpcUANodeContext *ctx = nullptr;
+   if (!findNodeInIndex(node, &ctx))
+      return false;
+   return ctx->getStatsSnapshot(snapshot);
+}
+
+void OpcUANodeHandler::resetNodeStats() {
+   std::lock_guard<std::recursive_mutex> guard(lock);
+   for (OpcUANodeContext *ctx : nodeset) {
+      OpcUANodeStats *stats = ctx->getStats();
+      if (!stats)
+         continue;
+      stats->read.reset();
+      stats->write.reset();
+      stats->call.reset();
+   }
+}
+
+/* the fields of a statistic published by addNodeStatsToServer() */
+static uint64_t statsCalls(const OpcUACallStatsSnapshot &s) {
+   return s.calls;
+}
+
+static uint64_t statsErrors(const OpcUACallStatsSnapshot &s) {
+   return s.errors;
+}
+
+static uint64_t statsMeanNs(const OpcUACallStatsSnapshot &s) {
+   return (uint64_t) s.meanNs();
+}
+
+static uint64_t statsP99Ns(const OpcUACallStatsSnapshot &s) {
+   return s.percentileNs(0.99);
+}
+
+static uint64_t statsMaxNs(const OpcUACallStatsSnapshot &s) {
+   return s.maxNs;
+}
+
+bool OpcUANodeHandler::addStatsVariable(OpcUAObjectNodeContext *parent,
+      const std::string &name, const UA_NodeId *target,
+      OpcUACallStats OpcUANodeStats::*kind,
+      uint64_t (*field)(const OpcUACallStatsSnapshot &)) {
+   /* the target is looked up on every read, it may be deleted meanwhile */
+   std::shared_ptr<UA_NodeId> id(UA_NodeId_new(), UA_NodeId_delete);
+   if (!id || UA_NodeId_copy(target, id.get()) != UA_STATUSCODE_GOOD)
+      return false;
+
+   OpcUAVarNodeContext *var = new (this) OpcUAVarNodeContext(this);
+   var->setNamespace(statsNamespace);
+   var->setName(parent->getName() + "." + name);
+   var->setQualifiedName(name);
+   var->setDataType(uint64_t());
+   var->setReadable(true);
+   var->setReadMethodSimple([this, var, id, kind, field](UA_DataValue *value) {
+      OpcUANodeContext *ctx = nullptr;
+      if (!findNodeInIndex(id.get(), &ctx))
+         return false;
+
+      OpcUACallStatsSnapshot snapshot = OpcUACallStatsSnapshot();
+      OpcUANodeStats *stats = ctx->getStats();
+      if (stats)
+         (stats->*kind).snapshot(&snapshot);
+      uint64_t v = field(snapshot);
+      var->convertToOPC(value, &v);
+      return true;
+   });
+   parent->addChild(var);
+
+   if (!addNodeToServer(var)) {
+      deleteNode(var);
+      return false;
    }
+   return true;
+}
+
+bool OpcUANodeHandler::addNodeStatsToServer(OpcUANodeContext *ctx) {
+   static const struct {
+      const char *name;
+      uint64_t (*field)(const OpcUACallStatsSnapshot &);
+   } fields[] = {
+      {"Calls", statsCalls},
+      {"Errors", statsErrors},
+      {"MeanNs", statsMeanNs},
+      {"P99Ns", statsP99Ns},
+      {"MaxNs", statsMaxNs},
+   };
+
+   if (!ctx || !checkServer())
+      return false;
+
+   std::string label = ctx->getName();
+   if (label.empty() && ctx->getNodeId()->identifierType == UA_NODEIDTYPE_NUMERIC)
+      label = "i=" + std::to_string(ctx->getNodeId()->identifier.numeric);
+   if (label.empty())
+      return false;
+
+   std::lock_guard<std::recursive_mutex> guard(lock);
+   if (!statsRoot) {
+      statsNamespace = addNamespace("urn:opcuawrap:diagnostics");
+      if (!statsNamespace)
+         return false;
+      statsRoot = new (this) OpcUAObjectNodeContext(this);
+      statsRoot->setNamespace(statsNamespace);
+      statsRoot->setName("NodeStats");
+      statsRoot->setQualifiedName("NodeStats");
+      UA_NodeId objects = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+      statsRoot->setParentNodeId(&objects);
+      if (!addObjectNodeToServer(statsRoot)) {
+         deleteNode(statsRoot);
+         statsRoot = nullptr;
+         return false;
+      }
+   }
+
+   OpcUAObjectNodeContext *obj = new (this) OpcUAObjectNodeContext(this);
+   obj->setNamespace(statsNamespace);
+   obj->setName("NodeStats." + std::to_string(ctx->getNamespace()) + "." +
+                label);
+   obj->setQualifiedName(label);
+   statsRoot->addChild(obj);
+   if (!addObjectNodeToServer(obj)) {
+      deleteNode(obj);
+      return false;
+   }
+
+   std::vector<std::pair<std::string, OpcUACallStats OpcUANodeStats::*> > kinds;
+   if (ctx->getNodeClass() == UA_NODECLASS_METHOD) {
+      kinds.push_back(std::make_pair("Call", &OpcUANodeStats::call));
+   } else {
+      kinds.push_back(std::make_pair("Read", &OpcUANodeStats::read));
+      kinds.push_back(std::make_pair("Write", &OpcUANodeStats::write));
+   }
+
+   bool added = true;
+   for (size_t k = 0; k < kinds.size(); k++) {
+      for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); f++)
+         added &= addStatsVariable(obj, kinds[k].first + fields[f].name,
+                                   ctx->getNodeId(), kinds[k].second,
+                                   fields[f].field);
+   }
+   return added;
 }
 
 UA_StatusCode OpcUANodeHandler::readCallback(UA_Server *server, const UA_NodeId *sessionId,
@@ -201,8 +796,68 @@ UA_StatusCode OpcUANodeHandler::readCallback(UA_Server *server, const UA_NodeId
                            void *nodeContext, UA_Boolean includeSourceTimeStamp,
                            const UA_NumericRange *range, UA_DataValue *value) {
    OpcUAVarNodeContext *obj = static_cast<OpcUAVarNodeContext*>(nodeContext);
+   OpcUANodeStats *stats = obj ? obj->getStats() : nullptr;
+
+   if (!stats)
+      return dispatchRead(obj, sessionId, sessionContext,
+                          includeSourceTimeStamp, range, value);
+
+   uint64_t start = OpcUACallStats::start();
+   UA_StatusCode retval = dispatchRead(obj, sessionId, sessionContext,
+                                       includeSourceTimeStamp, range, value);
+   stats->read.record(start, retval == UA_STATUSCODE_GOOD);
+   return retval;
+}
+
+UA_StatusCode OpcUANodeHandler::dispatchRead(OpcUAVarNodeContext *obj,
+                                             const UA_NodeId *sessionId,
+                                             void *sessionContext,
+                                             UA_Boolean includeSourceTimeStamp,
+                                             const UA_NumericRange *range,
+                                             UA_DataValue *value) {
+   /* worker threads read outside of the loop iterations and have to hold a
+    * reader slot while touching published memory */
+   OpcUAServer *owner = obj ? obj->getServer() : nullptr;
+   bool worker = owner && owner->isMultithreaded();
+
+   if (obj && obj->getCache()->isPublished()) {
+      if (!worker)
+         return obj->getCache()->read(value, includeSourceTimeStamp, range);
+
+      unsigned slot = owner->enterReader();
+      UA_StatusCode retval = obj->getCache()->read(value,
+                                                   includeSourceTimeStamp,
+                                                   range);
+      owner->leaveReader(slot);
+      return retval;
+   }
+
+   /* the memo keeps whole values, a range read or read callback asked for
+    * a range produces just the range, which beats slicing a whole value */
+   OpcUAReadMemo *memo = obj ? obj->getReadMemo() : nullptr;
+   bool rangedSource = obj && range &&
+                       (obj->getRead() || obj->getReadRange());
+   if (memo && memo->isEnabled() && !rangedSource &&
+       (obj->getRead() || obj->getReadRange() || obj->getReadSimple())) {
+      return memo->read(value, includeSourceTimeStamp, range,
+                        [&](UA_DataValue *result) {
+         return readSource(obj, sessionId, sessionContext, true, nullptr,
+                           result);
+      });
+   }
+   return readSource(obj, sessionId, sessionContext, includeSourceTimeStamp,
+                     range, value);
+}
 
+UA_StatusCode OpcUANodeHandler::readSource(OpcUAVarNodeContext *obj,
+                                           const UA_NodeId *sessionId,
+                                           void *sessionContext,
+                                           UA_Boolean includeSourceTimeStamp,
+                                           const UA_NumericRange *range,
+                                           UA_DataValue *value) {
    bool ret = false;
+   OpcUAServer *owner = obj ? obj->getServer() : nullptr;
+   bool worker = owner && owner->isMultithreaded();
 
    if (obj && obj->getRead()) {
       ret = obj->getRead()(sessionId, sessionContext, includeSourceTimeStamp,
@@ -211,14 +866,54 @@ UA_StatusCode OpcUANodeHandler::readCallback(UA_Server *server, const UA_NodeId
          return UA_STATUSCODE_GOOD;
       return UA_STATUSCODE_BADMETHODINVALID;
    }
+   if (obj && obj->getReadRange()) {
+      UA_StatusCode retval = obj->getReadRange()(range, value);
+      if (retval != UA_STATUSCODE_GOOD)
+         return retval;
+
+      value->hasValue = true;
+      obj->setOPCTimeStampsNow(value, includeSourceTimeStamp);
+      return UA_STATUSCODE_GOOD;
+   }
    if (obj && obj->getReadSimple()) {
       ret = obj->getReadSimple()(value);
-      if (includeSourceTimeStamp) {
-         obj->setOPCSourceTimeStampNow(value);
+      if (!ret)
+         return UA_STATUSCODE_BADMETHODINVALID;
+      if (range) {
+         /* the simple read produced the whole value, cut out the range */
+         UA_Variant whole = value->value;
+         UA_Variant_init(&value->value);
+         UA_StatusCode retval = UA_Variant_copyRange(&whole, &value->value,
+                                                     *range);
+         UA_Variant_deleteMembers(&whole);
+         if (retval != UA_STATUSCODE_GOOD)
+            return retval;
       }
-      if (ret)
-         return UA_STATUSCODE_GOOD;
-      return UA_STATUSCODE_BADMETHODINVALID;
+      obj->setOPCTimeStampsNow(value, includeSourceTimeStamp);
+      return UA_STATUSCODE_GOOD;
+   }
+   if (obj && obj->getReadBorrowed()) {
+      /* the slot is held before the buffer is fetched, else the producer
+       * could reuse it in between */
+      unsigned slot = worker ? owner->enterReader() : 0;
+      OpcUABorrowedBuffer buffer;
+      UA_StatusCode retval = UA_STATUSCODE_BADMETHODINVALID;
+      if (obj->getReadBorrowed()(&buffer))
+         retval = obj->lendToOPC(&value->value, &buffer, range);
+      if (worker) {
+         /* the buffer may be reused once we leave, so lend a copy */
+         if (retval == UA_STATUSCODE_GOOD) {
+            UA_Variant lent = value->value;
+            retval = UA_Variant_copy(&lent, &value->value);
+         }
+         owner->leaveReader(slot);
+      }
+      if (retval != UA_STATUSCODE_GOOD)
+         return retval;
+
+      value->hasValue = true;
+      obj->setOPCTimeStampsNow(value, includeSourceTimeStamp);
+      return UA_STATUSCODE_GOOD;
    }
    return UA_STATUSCODE_BADMETHODINVALID;
 }
@@ -228,19 +923,40 @@ UA_StatusCode OpcUANodeHandler::writeCallback(UA_Server *server, const UA_NodeId
                             void *nodeContext, const UA_NumericRange *range,
                             const UA_DataValue *value) {
    OpcUAVarNodeContext *obj = static_cast<OpcUAVarNodeContext*>(nodeContext);
+   OpcUANodeStats *stats = obj ? obj->getStats() : nullptr;
+
+   if (!stats)
+      return dispatchWrite(obj, sessionId, sessionContext, range, value);
+
+   uint64_t start = OpcUACallStats::start();
+   UA_StatusCode retval = dispatchWrite(obj, sessionId, sessionContext, range,
+                                        value);
+   stats->write.record(start, retval == UA_STATUSCODE_GOOD);
+   return retval;
+}
+
+UA_StatusCode OpcUANodeHandler::dispatchWrite(OpcUAVarNodeContext *obj,
+                                              const UA_NodeId *sessionId,
+                                              void *sessionContext,
+                                              const UA_NumericRange *range,
+                                              const UA_DataValue *value) {
    bool ret = false;
 
    if (obj && obj->getWrite()) {
       ret = obj->getWrite()(sessionId, sessionContext, range, value);
-      if (ret)
-         return UA_STATUSCODE_GOOD;
-      return UA_STATUSCODE_BADMETHODINVALID;
+      if (!ret)
+         return UA_STATUSCODE_BADMETHODINVALID;
+      if (obj->getReadMemo())
+         obj->getReadMemo()->invalidate();
+      return UA_STATUSCODE_GOOD;
    }
    if (obj && obj->getWriteSimple()) {
       ret = obj->getWriteSimple()(value);
-      if (ret)
-         return UA_STATUSCODE_GOOD;
-      return UA_STATUSCODE_BADMETHODINVALID;
+      if (!ret)
+         return UA_STATUSCODE_BADMETHODINVALID;
+      if (obj->getReadMemo())
+         obj->getReadMemo()->invalidate();
+      return UA_STATUSCODE_GOOD;
    }
 
    return UA_STATUSCODE_BADMETHODINVALID;
@@ -259,6 +975,29 @@ UA_StatusCode OpcUANodeHandler::onMethodCallCallback(UA_Server *server,
                                                      UA_Variant *output) {
 
    OpcUAMethodNodeContext *obj = static_cast<OpcUAMethodNodeContext*>(nodeContext);
+   OpcUANodeStats *stats = obj ? obj->getStats() : nullptr;
+
+   if (!stats)
+      return dispatchCall(obj, sessionId, sessionContext, objectId,
+                          objectContext, inputSize, input, outputSize, output);
+
+   uint64_t start = OpcUACallStats::start();
+   UA_StatusCode retval = dispatchCall(obj, sessionId, sessionContext,
+                                       objectId, objectContext, inputSize,
+                                       input, outputSize, output);
+   stats->call.record(start, retval == UA_STATUSCODE_GOOD);
+   return retval;
+}
+
+UA_StatusCode OpcUANodeHandler::dispatchCall(OpcUAMethodNodeContext *obj,
+                                             const UA_NodeId *sessionId,
+                                             void *sessionContext,
+                                             const UA_NodeId *objectId,
+                                             void *objectContext,
+                                             size_t inputSize,
+                                             const UA_Variant *input,
+                                             size_t outputSize,
+                                             UA_Variant *output) {
    bool ret = false;
 
    if (obj && obj->getCallback()) {
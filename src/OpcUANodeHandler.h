@@ -8,7 +8,11 @@
 
 #include <unordered_map>
 #include <unordered_set>
+#include <mutex>
 #include "OpcUANodeContext.h"
+#include "OpcUANodeIndex.h"
+#include "OpcUAPathIndex.h"
+#include "OpcUANodeArena.h"
 #include "OpcUAServer.h"
 
 
@@ -17,13 +21,101 @@
 
 namespace n_opcua {
 
-typedef std::unordered_map<UA_NodeId*, OpcUANodeContext*>::iterator nodeMapIterator;
 typedef std::pair<UA_NodeId*, OpcUANodeContext*> nodeMapPair;
 
+/**
+ * @brief A new value of a variable, see OpcUANodeHandler::writeValues()
+ */
+struct OpcUAValueUpdate {
+   /* the context of the variable */
+   OpcUAVarNodeContext *ctx;
+   /* the value, it is copied */
+   const UA_Variant *value;
+   /* the time the value was acquired, 0 for the time of the batch */
+   UA_DateTime sourceTimestamp;
+};
+
 class OpcUANodeHandler {
 private:
-   std::unordered_map<UA_NodeId*, OpcUANodeContext*> nodemap;
+   /* all contexts handled (and owned) by us */
+   std::unordered_set<OpcUANodeContext*> nodeset;
+   /* lookup of the contexts by the content of their NodeId */
+   OpcUANodeIndex nodeindex;
+   /* lookup of the contexts by their browse path, see getNodePath() */
+   OpcUAPathIndex pathindex;
+   /* memory of the contexts created with new (handler) */
+   OpcUANodeArena arena;
+   /* the contexts seen by the running writeValues(), open addressed */
+   std::vector<OpcUANodeContext *> batchSeen;
    OpcUAServer *_server;
+   /* servers showing the same nodes as _server, see addReplica() */
+   std::vector<OpcUAServer *> replicas;
+   /* if a node was added to the servers, replicas are fixed from then on */
+   bool nodesAdded;
+   /* guards the index and the node tree against worker threads */
+   std::recursive_mutex lock;
+   /* if the callbacks record call statistics */
+   std::atomic<bool> statsEnabled;
+   /* the diagnostics namespace and its root object, see addNodeStatsToServer */
+   uint16_t statsNamespace;
+   OpcUAObjectNodeContext *statsRoot;
+
+   /**
+    * @brief Call the read, write or method callbacks of a context (helper)
+    */
+   static UA_StatusCode dispatchRead(OpcUAVarNodeContext *obj,
+                                     const UA_NodeId *sessionId,
+                                     void *sessionContext,
+                                     UA_Boolean includeSourceTimeStamp,
+                                     const UA_NumericRange *range,
+                                     UA_DataValue *value);
+   static UA_StatusCode readSource(OpcUAVarNodeContext *obj,
+                                   const UA_NodeId *sessionId,
+                                   void *sessionContext,
+                                   UA_Boolean includeSourceTimeStamp,
+                                   const UA_NumericRange *range,
+                                   UA_DataValue *value);
+   static UA_StatusCode dispatchWrite(OpcUAVarNodeContext *obj,
+                                      const UA_NodeId *sessionId,
+                                      void *sessionContext,
+                                      const UA_NumericRange *range,
+                                      const UA_DataValue *value);
+   static UA_StatusCode dispatchCall(OpcUAMethodNodeContext *obj,
+                                     const UA_NodeId *sessionId,
+                                     void *sessionContext,
+                                     const UA_NodeId *objectId,
+                                     void *objectContext,
+                                     size_t inputSize,
+                                     const UA_Variant *input,
+                                     size_t outputSize,
+                                     UA_Variant *output);
+
+   /**
+    * @brief Add a diagnostics variable of a node statistic (helper)
+    */
+   bool addStatsVariable(OpcUAObjectNodeContext *parent,
+                         const std::string &name, const UA_NodeId *target,
+                         OpcUACallStats OpcUANodeStats::*kind,
+                         uint64_t (*field)(const OpcUACallStatsSnapshot &));
+
+   /**
+    * @brief Unlink a context and all contexts below it from each other and
+    * append them to order, parents before their children (helper)
+    */
+   void collectSubtree(OpcUANodeContext *root,
+                       std::vector<OpcUANodeContext *> *order);
+
+   /**
+    * @brief Delete collected contexts from the server and free them, from
+    * the back of order (helper)
+    */
+   void deleteContexts(const std::vector<OpcUANodeContext *> &order);
+
+   /**
+    * @brief Add or remove the paths of a context and the contexts below it,
+    * the path of ctx is given (helper)
+    */
+   bool updatePaths(OpcUANodeContext *ctx, std::string *path, bool add);
 
 public:
    /**
@@ -54,6 +146,14 @@ public:
       return _server;
    }
 
+   /**
+    * @brief Get the arena contexts created with new (handler) are placed in
+    * @return the arena
+    */
+   OpcUANodeArena *getArena() {
+      return &arena;
+   }
+
    /**
     * @brief Check if a valid server is set
     * @return true if set, else false
@@ -64,22 +164,57 @@ public:
       return true;
    }
 
+   /**
+    * @brief Show our nodes on another server too, nodes added to the server
+    * from now on are added to it as well and share their contexts. Has to be
+    * called before the first node is added, see OpcUAServerGroup
+    * @param replica the server, created with setBaseConfigDone()
+    * @return true if added, else false
+    */
+   bool addReplica(OpcUAServer *replica);
+
+   /**
+    * @brief Return the servers added with addReplica()
+    */
+   const std::vector<OpcUAServer *> &getReplicas() {
+      return replicas;
+   }
+
+   /**
+    * @brief Add a namespace to the server and all replicas
+    * @param ns the name for the new namespace
+    * @return the namespace index on the server and all replicas, 0 if a
+    * replica assigned another index
+    */
+   uint16_t addNamespace(const std::string &ns);
+
+   /**
+    * @brief Get the lock guarding the index and the node tree, hold it to
+    * change several nodes at once while the server runs multithreaded
+    * @return the lock
+    */
+   std::recursive_mutex &getLock() {
+      return lock;
+   }
+
    /**
     * @brief Default deconstructor for OpcUANodeHandler
     */
    virtual ~OpcUANodeHandler();
    /**
-    * @brief Find a indexed node
+    * @brief Find a indexed node, nodes are compared by their content so any
+    * NodeId equal to the indexed one matches
     * @param node the node to find
-    * @param mapIter the mapIterator to use
+    * @param ctx the context of the node, if found
     * @return true if the node was found, else false
     */
-   bool findNodeInIndex(UA_NodeId* node, nodeMapIterator *mapIter = NULL);
+   bool findNodeInIndex(const UA_NodeId* node, OpcUANodeContext **ctx = NULL);
    /**
     * @brief Add a node to the index
-    * @param node the node to add
+    * @param node the node to add, has to equal the NodeId of the context
     * @param ctx the context for the node
-    * @return if the action was successful
+    * @return if the action was successful, false if another context is
+    * already indexed under the NodeId
     */
    bool addNodeToIndex(UA_NodeId *node, OpcUANodeContext *ctx);
    /**
@@ -99,9 +234,63 @@ public:
     * @param ctx the context of the node
     * @return if the action was successful
     */
-   bool inline removeNodeFromIndex(OpcUANodeContext *ctx) {
-      return removeNodeFromIndex(ctx->getNodeId());
-   }
+   bool removeNodeFromIndex(OpcUANodeContext *ctx);
+   /**
+    * @brief Add the NodeId of an indexed context to the lookup again, call
+    * this after the NodeId of the context changed
+    * @param ctx the context of the node
+    * @return true if the NodeId was added or has no key yet (null or i=0,
+    * indexed once the server assigned it), false if another context is
+    * already indexed under it
+    */
+   bool indexNodeId(OpcUANodeContext *ctx);
+   /**
+    * @brief Remove the NodeId of a context from the lookup, call this before
+    * the NodeId of the context changes
+    * @param ctx the context of the node
+    * @return true if the NodeId was removed, else false
+    */
+   bool unindexNodeId(OpcUANodeContext *ctx);
+   /**
+    * @brief Return the browse path of a context, the qualified names of its
+    * parent contexts and itself joined by '/', e.g. "Plant/Line3/Speed"
+    * @param ctx the context
+    * @return the path, empty if a context on the way has no qualified name
+    */
+   std::string getNodePath(OpcUANodeContext *ctx);
+   /**
+    * @brief Find a node by its browse path, in time proportional to the
+    * length of the path
+    * @param path the path, see getNodePath()
+    * @param ctx the context of the node, if found
+    * @return true if the node was found, else false
+    */
+   bool findNodeByPath(const std::string &path,
+                       OpcUANodeContext **ctx = NULL);
+   /**
+    * @brief Find all nodes whose browse path starts with a prefix, e.g.
+    * "Plant/Line3/" for all nodes below Line3 or "Plant/Line3/Motor" for the
+    * motors and their nodes
+    * @param prefix the start of the paths
+    * @param nodes the found contexts are appended to it
+    * @return the count of found nodes
+    */
+   size_t findNodesByPathPrefix(const std::string &prefix,
+                                std::vector<OpcUANodeContext *> *nodes);
+   /**
+    * @brief Add the browse paths of a context and all contexts below it to
+    * the lookup, call this after the path of the context changed
+    * @param ctx the context of the node
+    * @return true if all paths were added, false if another context already
+    * claimed one of them, it then keeps the path
+    */
+   bool indexPaths(OpcUANodeContext *ctx);
+   /**
+    * @brief Remove the browse paths of a context and all contexts below it
+    * from the lookup, call this before the path of the context changes
+    * @param ctx the context of the node
+    */
+   void unindexPaths(OpcUANodeContext *ctx);
    /**
     * @brief Get the node and the context from the index by searching for the node
     * @param node the node to look for
@@ -115,7 +304,7 @@ public:
     * @param ctx the retuning context
     * @return if the action was successful
     */
-   bool getCtxFromIndexByNode(UA_NodeId *node,  OpcUANodeContext *ctx);
+   bool getCtxFromIndexByNode(UA_NodeId *node,  OpcUANodeContext **ctx);
    /**
     * @brief Initialize a new node and add it to the index
     * @param ctx the context for the node to use, if any
@@ -127,6 +316,50 @@ public:
     * @return true if added, else false
     */
    virtual bool addNodeToServer() { return false; }
+   /**
+    * @brief Add a node to the server by the node class of its context
+    * @param ctx the context of the node
+    * @return true if added, else false
+    */
+   bool addNodeToServer(OpcUANodeContext *ctx);
+   /**
+    * @brief Add many nodes to the server in one pass
+    * @param ctxs the contexts of the nodes, parents before their children
+    * @param count the count of contexts
+    * @return the count of nodes added
+    */
+   size_t addNodesToServer(OpcUANodeContext *const *ctxs, size_t count);
+   /**
+    * @brief Add many nodes to the server in one pass, see above
+    * @param ctxs the contexts of the nodes, parents before their children
+    * @return the count of nodes added
+    */
+   size_t addNodesToServer(const std::vector<OpcUANodeContext *> &ctxs);
+   /**
+    * @brief Make room for a count of nodes, call this before creating the
+    * contexts of a large address space to index them without rehashing
+    * @param count the total count of nodes
+    */
+   void reserveNodes(size_t count);
+   /**
+    * @brief Publish the values of many variables in one pass, see
+    * OpcUAVarNodeContext::publishDataValue(). Clients read them from the
+    * value caches, the server nodes are not written. From its first
+    * published value on, a variable is only read from its cache, its read
+    * callbacks are not called anymore
+    * @param updates the new values, a later update of the same variable
+    * replaces an earlier one
+    * @param count the count of updates
+    * @return the count of variables published, variables with a data
+    * source of their own (e.g. OpcUATypedVar) are skipped and not counted
+    */
+   size_t writeValues(const OpcUAValueUpdate *updates, size_t count);
+   /**
+    * @brief Publish the values of many variables in one pass, see above
+    * @param updates the new values
+    * @return the count of variables published
+    */
+   size_t writeValues(const std::vector<OpcUAValueUpdate> &updates);
    /**
     * @brief Add a Variable Node with a Callback to the server
     * @param ctx the context of the variable
@@ -153,24 +386,61 @@ public:
     */
    bool deleteNode(UA_NodeId *node);
    /**
-    * @brief Delete a node by its context
+    * @brief Delete a node by its context together with the subtree of its
+    * children, the node is removed from its parent
     * @param ctx the nodes context
     * @return true if deleted, else false
     */
-   bool inline deleteNode(OpcUANodeContext *ctx) {
-      return deleteNode(ctx->getNodeId());
-   }
+   bool deleteNode(OpcUANodeContext *ctx);
    /**
-    * @brief Delete all nodes on the index
+    * @brief Delete all nodes on the index in one pass over their trees, the
+    * arena memory of their contexts is freed at once
     */
    void deleteAllNodes();
    /**
     * @brief Map a datatype name to a name integer (open62541)
-    * @param datatypename the name to match
-    * @return the integer representation if found
+    * @param datatypename the name to match, a NodeSet2 name of a builtin type
+    * like "Double" or one of its aliases like "Duration"
+    * @return the integer representation if found, else -1
     */
    int16_t mapDataTypeToName(const char* datatypename);
 
+   /**
+    * @brief Enable recording of call counts and latencies of all nodes
+    * @param enabled true to record, false to stop recording
+    * @param sampleShift time only every 2^sampleShift-th call of a thread,
+    * all calls are counted
+    */
+   void setStatsEnabled(bool enabled, unsigned sampleShift = 0);
+
+   /**
+    * @brief Check if call statistics are recorded
+    */
+   bool isStatsEnabled() {
+      return statsEnabled.load(std::memory_order_relaxed);
+   }
+
+   /**
+    * @brief Copy the call statistics of a node
+    * @param node the node
+    * @param snapshot the copy to fill
+    * @return true if the node has statistics, else false
+    */
+   bool getNodeStats(const UA_NodeId *node, OpcUANodeStatsSnapshot *snapshot);
+
+   /**
+    * @brief Reset the call statistics of all nodes
+    */
+   void resetNodeStats();
+
+   /**
+    * @brief Publish the call statistics of a node as variables, in the
+    * namespace "urn:opcuawrap:diagnostics" below its NodeStats object
+    * @param ctx the node, has a name or a numeric NodeId
+    * @return true if added, else false
+    */
+   bool addNodeStatsToServer(OpcUANodeContext *ctx);
+
    /**
     * @brief Static read callback for a opcua variable
     */
@@ -0,0 +1,222 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include <cstring>
+#include "OpcUANodeIndex.h"
+
+namespace n_opcua {
+
+/* marks keys which are a hash and have to be verified against the NodeId */
+static const uint64_t hashedKeyFlag = 1ULL << 63;
+
+static const size_t minCapacity = 16;
+
+/* 64 bit finalizer of MurmurHash3 */
+static inline uint64_t mix64(uint64_t k) {
+   k ^= k >> 33;
+   k *= 0xff51afd7ed558ccdULL;
+   k ^= k >> 33;
+   k *= 0xc4ceb9fe1a85ec53ULL;
+   k ^= k >> 33;
+   return k;
+}
+
+/* multiply-xor hash over a byte range, a word at a time */
+static inline uint64_t hashBytes(uint64_t h, const UA_Byte *data, size_t len) {
+   const uint64_t mul = 0x9e3779b97f4a7c15ULL;
+   uint64_t w;
+
+   h ^= len * mul;
+   while (len >= sizeof(w)) {
+      memcpy(&w, data, sizeof(w));
+      h = (h ^ w) * mul;
+      h ^= h >> 32;
+      data += sizeof(w);
+      len -= sizeof(w);
+   }
+   if (len > 0) {
+      w = 0;
+      memcpy(&w, data, len);
+      h = (h ^ w) * mul;
+      h ^= h >> 32;
+   }
+   return h;
+}
+
+OpcUANodeIndex::OpcUANodeIndex(size_t expected) : mask(0), count(0) {
+   reserve(expected);
+}
+
+const UA_Byte *OpcUANodeIndex::identityOf(const UA_NodeId *node,
+                                          uint64_t *shape) {
+   const UA_Byte *data = nullptr;
+   size_t length = 0;
+
+   switch (node->identifierType) {
+   case UA_NODEIDTYPE_STRING:
+      data = node->identifier.string.data;
+      length = node->identifier.string.length;
+      break;
+   case UA_NODEIDTYPE_BYTESTRING:
+      data = node->identifier.byteString.data;
+      length = node->identifier.byteString.length;
+      break;
+   case UA_NODEIDTYPE_GUID:
+      data = reinterpret_cast<const UA_Byte *>(&node->identifier.guid);
+      length = sizeof(UA_Guid);
+      break;
+   default:
+      break;
+   }
+
+   *shape = ((uint64_t) length << 24) |
+            ((uint64_t) node->namespaceIndex << 8) |
+            (uint8_t) node->identifierType;
+   return data;
+}
+
+uint64_t OpcUANodeIndex::keyOf(const UA_NodeId *node) {
+   if (!node)
+      return 0;
+
+   /* i=0 asks the server to assign a NodeId, so it names no node yet */
+   if (node->identifierType == UA_NODEIDTYPE_NUMERIC &&
+       node->identifier.numeric == 0)
+      return 0;
+   if (node->identifierType == UA_NODEIDTYPE_NUMERIC)
+      /* lossless, the namespace only covers bits 32 - 47 */
+      return ((uint64_t) node->namespaceIndex << 32) |
+             node->identifier.numeric;
+
+   uint64_t shape;
+   const UA_Byte *data = identityOf(node, &shape);
+   if (!data || (shape >> 24) == 0)
+      return 0;
+
+   return mix64(hashBytes(shape, data, shape >> 24)) | hashedKeyFlag;
+}
+
+size_t OpcUANodeIndex::homeOf(uint64_t key) const {
+   return mix64(key) & mask;
+}
+
+bool OpcUANodeIndex::matches(const Slot &slot, uint64_t key,
+                             const UA_Byte *data, uint64_t shape) {
+   if (slot.key != key)
+      return false;
+   if (!(key & hashedKeyFlag))
+      return true;
+   return slot.shape == shape && memcmp(slot.data, data, shape >> 24) == 0;
+}
+
+OpcUANodeContext *OpcUANodeIndex::find(const UA_NodeId *node) const {
+   uint64_t key = keyOf(node);
+   if (key == 0 || count == 0)
+      return nullptr;
+
+   uint64_t shape;
+   const UA_Byte *data = identityOf(node, &shape);
+
+   size_t i = homeOf(key);
+   while (slots[i].key != 0) {
+      if (matches(slots[i], key, data, shape))
+         return slots[i].ctx;
+      i = (i + 1) & mask;
+   }
+   return nullptr;
+}
+
+bool OpcUANodeIndex::insert(const UA_NodeId *node, OpcUANodeContext *ctx) {
+   uint64_t key = keyOf(node);
+   if (key == 0 || !ctx)
+      return false;
+
+   uint64_t shape;
+   const UA_Byte *data = identityOf(node, &shape);
+
+   /* keep the load factor below 0.7 */
+   if ((count + 1) * 10 > slots.size() * 7)
+      rehash(slots.size() ? slots.size() * 2 : minCapacity);
+
+   size_t i = homeOf(key);
+   while (slots[i].key != 0) {
+      if (matches(slots[i], key, data, shape))
+         return false;
+      i = (i + 1) & mask;
+   }
+
+   slots[i].key = key;
+   slots[i].ctx = ctx;
+   slots[i].data = data;
+   slots[i].shape = shape;
+   count++;
+   return true;
+}
+
+bool OpcUANodeIndex::erase(const UA_NodeId *node, OpcUANodeContext *ctx) {
+   uint64_t key = keyOf(node);
+   if (key == 0 || count == 0)
+      return false;
+
+   size_t i = homeOf(key);
+   while (slots[i].key != key || slots[i].ctx != ctx) {
+      if (slots[i].key == 0)
+         return false;
+      i = (i + 1) & mask;
+   }
+
+   /* shift following entries back until one sits in its home slot */
+   size_t j = i;
+   for (;;) {
+      j = (j + 1) & mask;
+      if (slots[j].key == 0)
+         break;
+      size_t home = homeOf(slots[j].key);
+      if (((j - home) & mask) >= ((j - i) & mask)) {
+         slots[i] = slots[j];
+         i = j;
+      }
+   }
+
+   slots[i] = Slot {0, nullptr, nullptr, 0};
+   count--;
+   return true;
+}
+
+void OpcUANodeIndex::rehash(size_t capacity) {
+   std::vector<Slot> old;
+   old.swap(slots);
+
+   slots.assign(capacity, Slot {0, nullptr, nullptr, 0});
+   mask = capacity - 1;
+
+   for (size_t k = 0; k < old.size(); k++) {
+      if (old[k].key == 0)
+         continue;
+      size_t i = homeOf(old[k].key);
+      while (slots[i].key != 0)
+         i = (i + 1) & mask;
+      slots[i] = old[k];
+   }
+}
+
+void OpcUANodeIndex::reserve(size_t expected) {
+   size_t capacity = minCapacity;
+   while (expected * 10 > capacity * 7)
+      capacity *= 2;
+
+   if (capacity > slots.size())
+      rehash(capacity);
+}
+
+void OpcUANodeIndex::clear() {
+   slots.assign(slots.size(), Slot {0, nullptr, nullptr, 0});
+   count = 0;
+}
+
+} /* namespace n_opcua */
@@ -0,0 +1,143 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#ifndef SRC_OPCUANODEINDEX_H_
+#define SRC_OPCUANODEINDEX_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "OpcUAServer.h"
+
+namespace n_opcua {
+
+class OpcUANodeContext;
+
+/**
+ * Open addressing (linear probing) index from the content of a UA_NodeId to
+ * its OpcUANodeContext.
+ *
+ * Every slot holds a precomputed 64 bit key next to the context pointer, so a
+ * probe sequence only touches the slot array. Numeric NodeIds are packed
+ * losslessly into the key and never need a second look. All other identifier
+ * types store a hash plus a pointer to the identifier bytes of the indexed
+ * NodeId, so a hit costs the slot and the identifier bytes but never the
+ * context itself. Removal uses backward shifting, so there are no tombstones.
+ *
+ * The indexed NodeId has to stay unchanged while it is in the index.
+ */
+class OpcUANodeIndex {
+private:
+   struct Slot {
+      /* 0 marks a free slot */
+      uint64_t key;
+      OpcUANodeContext *ctx;
+      /* identifier bytes of hashed keys */
+      const UA_Byte *data;
+      /* identifier length, namespace and identifier type of hashed keys */
+      uint64_t shape;
+   };
+
+   std::vector<Slot> slots;
+   size_t mask;
+   size_t count;
+
+   /**
+    * @brief Return the home slot of a key
+    */
+   size_t homeOf(uint64_t key) const;
+
+   /**
+    * @brief Return the identifier bytes and shape of a NodeId
+    * @param node the NodeId
+    * @param shape the returned shape
+    * @return the identifier bytes
+    */
+   static const UA_Byte *identityOf(const UA_NodeId *node, uint64_t *shape);
+
+   /**
+    * @brief Check if a slot matches a key and the identity of its NodeId
+    */
+   static bool matches(const Slot &slot, uint64_t key, const UA_Byte *data,
+                       uint64_t shape);
+
+   /**
+    * @brief Resize the slot array to a new power of two capacity
+    * @param capacity the new slot count
+    */
+   void rehash(size_t capacity);
+
+public:
+   /**
+    * @brief Constructor for an empty index
+    * @param expected the node count to reserve room for
+    */
+   OpcUANodeIndex(size_t expected = 0);
+
+   /**
+    * @brief Compute the index key of a NodeId
+    * @param node the NodeId
+    * @return the key, 0 if the NodeId is null or numeric 0, i.e. left for
+    * the server to assign, and can not be indexed
+    */
+   static uint64_t keyOf(const UA_NodeId *node);
+
+   /**
+    * @brief Find the context indexed under a NodeId
+    * @param node the NodeId to look for, compared by content
+    * @return the context or nullptr if not found
+    */
+   OpcUANodeContext *find(const UA_NodeId *node) const;
+
+   /**
+    * @brief Index a context under its NodeId, the first context claiming a
+    * NodeId wins
+    * @param node the NodeId of the context
+    * @param ctx the context to index
+    * @return true if inserted, false if the NodeId is null or already taken
+    */
+   bool insert(const UA_NodeId *node, OpcUANodeContext *ctx);
+
+   /**
+    * @brief Remove a context from the index
+    * @param node the NodeId the context was indexed under
+    * @param ctx the context to remove, another context claiming the same
+    * NodeId is left alone
+    * @return true if removed, else false
+    */
+   bool erase(const UA_NodeId *node, OpcUANodeContext *ctx);
+
+   /**
+    * @brief Make room for a node count without further rehashing
+    * @param expected the node count
+    */
+   void reserve(size_t expected);
+
+   /**
+    * @brief Remove all entries
+    */
+   void clear();
+
+   /**
+    * @brief Return the count of indexed nodes
+    */
+   size_t size() const {
+      return count;
+   }
+
+   /**
+    * @brief Return the memory used by the slot array in bytes
+    */
+   size_t memoryUsage() const {
+      return slots.size() * sizeof(Slot);
+   }
+};
+
+} /* namespace n_opcua */
+
+#endif /* SRC_OPCUANODEINDEX_H_ */
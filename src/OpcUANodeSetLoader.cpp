@@ -0,0 +1,618 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include "OpcUANodeSetLoader.h"
+
+namespace n_opcua {
+
+/* size of the chunks the file is read in */
+static const size_t chunkSize = 65536;
+/* longest text kept of an element, longer texts are cut */
+static const size_t maxTextLength = 65536;
+/* longest tag accepted */
+static const size_t maxTagLength = 65536;
+
+static inline bool isSpace(char c) {
+   return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static std::string trim(const std::string &str) {
+   size_t begin = 0;
+   size_t end = str.size();
+
+   while (begin < end && isSpace(str[begin]))
+      begin++;
+   while (end > begin && isSpace(str[end - 1]))
+      end--;
+   return str.substr(begin, end - begin);
+}
+
+/* encode a code point as UTF-8 */
+static void appendUtf8(std::string *out, unsigned long cp) {
+   if (cp < 0x80) {
+      *out += (char) cp;
+   } else if (cp < 0x800) {
+      *out += (char) (0xc0 | (cp >> 6));
+      *out += (char) (0x80 | (cp & 0x3f));
+   } else if (cp < 0x10000) {
+      *out += (char) (0xe0 | (cp >> 12));
+      *out += (char) (0x80 | ((cp >> 6) & 0x3f));
+      *out += (char) (0x80 | (cp & 0x3f));
+   } else {
+      *out += (char) (0xf0 | (cp >> 18));
+      *out += (char) (0x80 | ((cp >> 12) & 0x3f));
+      *out += (char) (0x80 | ((cp >> 6) & 0x3f));
+      *out += (char) (0x80 | (cp & 0x3f));
+   }
+}
+
+/* replace the XML entities of a text in place */
+static void decodeEntities(std::string *str) {
+   size_t amp = str->find('&');
+   if (amp == std::string::npos)
+      return;
+
+   std::string out(*str, 0, amp);
+   for (size_t i = amp; i < str->size(); i++) {
+      char c = (*str)[i];
+      size_t semi;
+      if (c != '&' || (semi = str->find(';', i)) == std::string::npos) {
+         out += c;
+         continue;
+      }
+
+      std::string entity = str->substr(i + 1, semi - i - 1);
+      if (entity == "lt")
+         out += '<';
+      else if (entity == "gt")
+         out += '>';
+      else if (entity == "amp")
+         out += '&';
+      else if (entity == "quot")
+         out += '"';
+      else if (entity == "apos")
+         out += '\'';
+      else if (entity.size() > 1 && entity[0] == '#')
+         appendUtf8(&out, entity[1] == 'x' ?
+                          strtoul(entity.c_str() + 2, nullptr, 16) :
+                          strtoul(entity.c_str() + 1, nullptr, 10));
+      else
+         out.append(*str, i, semi - i + 1);
+      i = semi;
+   }
+   str->swap(out);
+}
+
+OpcUANodeSetLoader::OpcUANodeSetLoader(OpcUANodeHandler *nodeHandler) :
+   _nodeHandler(nodeHandler),
+   state(StateText),
+   keepText(false),
+   quote(0),
+   attrCount(0),
+   inNamespaceUris(false),
+   current(nullptr),
+   accessLevel(0),
+   refForward(true),
+   skipped(0) {
+   tail[0] = tail[1] = 0;
+}
+
+bool OpcUANodeSetLoader::loadFile(const std::string &path, bool addToServer) {
+   FILE *file = fopen(path.c_str(), "rb");
+   if (!file) {
+      error = "can not open " + path;
+      return false;
+   }
+
+   bool ret = load(file, addToServer);
+   fclose(file);
+   return ret;
+}
+
+bool OpcUANodeSetLoader::load(FILE *file, bool addToServer) {
+   state = StateText;
+   tag.clear();
+   text.clear();
+   keepText = false;
+   quote = 0;
+   nsMap.clear();
+   inNamespaceUris = false;
+   aliases.clear();
+   current = nullptr;
+   loaded.clear();
+   pending.clear();
+   skipped = 0;
+   error.clear();
+
+   std::vector<char> chunk(chunkSize);
+   size_t length;
+   while (error.empty() &&
+          (length = fread(chunk.data(), 1, chunk.size(), file)) > 0)
+      feed(chunk.data(), length);
+
+   if (error.empty() && ferror(file))
+      error = "read error";
+   if (error.empty() && (current || state != StateText))
+      error = "unexpected end of the document";
+
+   if (current) {
+      delete current;
+      current = nullptr;
+   }
+
+   /* the parents of these did not come later, so they are not ours */
+   for (size_t i = 0; i < pending.size(); i++)
+      linkParent(pending[i].first, pending[i].second, true);
+   pending.clear();
+
+   orderLoaded();
+
+   if (!error.empty())
+      return false;
+
+   if (addToServer && _nodeHandler->addNodesToServer(loaded) != loaded.size()) {
+      error = "not all nodes were added to the server";
+      return false;
+   }
+   return true;
+}
+
+void OpcUANodeSetLoader::feed(const char *data, size_t length) {
+   const char *p = data;
+   const char *end = data + length;
+
+   while (p < end && error.empty()) {
+      switch (state) {
+      case StateText: {
+         /* text is skipped or copied in whole runs up to the next tag */
+         const char *lt = (const char *) memchr(p, '<', end - p);
+         const char *stop = lt ? lt : end;
+         if (keepText && text.size() < maxTextLength)
+            text.append(p, std::min<size_t>(stop - p,
+                                            maxTextLength - text.size()));
+         p = stop;
+         if (lt) {
+            state = StateTag;
+            tag.clear();
+            quote = 0;
+            p++;
+         }
+         break;
+      }
+
+      case StateTag: {
+         if (tag.empty() && *p == '!') {
+            state = StateDeclaration;
+            break;
+         }
+
+         const char *q = p;
+         if (quote)
+            while (q < end && *q != quote)
+               q++;
+         else
+            while (q < end && *q != '>' && *q != '"' && *q != '\'')
+               q++;
+         tag.append(p, q - p);
+         p = q;
+
+         if (tag.size() > maxTagLength) {
+            error = "tag too long";
+         } else if (q < end && *q == '>' && !quote) {
+            state = StateText;
+            p++;
+            flushTag();
+         } else if (q < end) {
+            /* a quote starts or ends */
+            quote = quote ? 0 : *q;
+            tag += *q;
+            p++;
+         }
+         break;
+      }
+
+      case StateDeclaration:
+         /* rare, so this goes a character at a time */
+         if (*p == '>') {
+            state = StateText;
+         } else {
+            tag += *p;
+            if (tag == "!--") {
+               state = StateComment;
+               tail[0] = tail[1] = 0;
+            } else if (tag == "![CDATA[") {
+               state = StateCData;
+               tail[0] = tail[1] = 0;
+            } else if (tag.size() > maxTagLength) {
+               error = "tag too long";
+            }
+         }
+         p++;
+         break;
+
+      case StateComment:
+         if (*p == '>' && tail[0] == '-' && tail[1] == '-')
+            state = StateText;
+         tail[0] = tail[1];
+         tail[1] = *p++;
+         break;
+
+      case StateCData:
+         if (*p == '>' && tail[0] == ']' && tail[1] == ']') {
+            state = StateText;
+            /* drop the "]]" kept already */
+            if (keepText && text.size() >= 2 &&
+                text.compare(text.size() - 2, 2, "]]") == 0)
+               text.resize(text.size() - 2);
+         } else if (keepText && text.size() < maxTextLength) {
+            text += *p;
+         }
+         tail[0] = tail[1];
+         tail[1] = *p++;
+         break;
+      }
+   }
+}
+
+void OpcUANodeSetLoader::setElement(size_t begin, size_t end) {
+   for (size_t i = begin; i < end; i++) {
+      if (tag[i] == ':')
+         begin = i + 1;
+   }
+   element.assign(tag, begin, end - begin);
+}
+
+void OpcUANodeSetLoader::flushTag() {
+   if (tag.empty() || tag[0] == '?')
+      /* processing instructions */
+      return;
+
+   if (tag[0] == '/') {
+      size_t end = tag.size();
+      while (end > 1 && isSpace(tag[end - 1]))
+         end--;
+      setElement(1, end);
+      endElement(element);
+      return;
+   }
+
+   bool empty = tag[tag.size() - 1] == '/';
+   size_t end = empty ? tag.size() - 1 : tag.size();
+
+   size_t i = 0;
+   while (i < end && !isSpace(tag[i]))
+      i++;
+   setElement(0, i);
+
+   attrCount = 0;
+   while (i < end) {
+      while (i < end && isSpace(tag[i]))
+         i++;
+      size_t nameBegin = i;
+      while (i < end && tag[i] != '=' && !isSpace(tag[i]))
+         i++;
+      size_t nameEnd = i;
+      while (i < end && (isSpace(tag[i]) || tag[i] == '='))
+         i++;
+      if (i >= end || (tag[i] != '"' && tag[i] != '\''))
+         break;
+
+      char q = tag[i++];
+      size_t valueEnd = tag.find(q, i);
+      if (valueEnd == std::string::npos || valueEnd > end)
+         break;
+
+      if (attrCount == attrs.size())
+         attrs.resize(attrCount + 1);
+      attrs[attrCount].first.assign(tag, nameBegin, nameEnd - nameBegin);
+      attrs[attrCount].second.assign(tag, i, valueEnd - i);
+      decodeEntities(&attrs[attrCount].second);
+      attrCount++;
+      i = valueEnd + 1;
+   }
+
+   startElement(element);
+   if (empty)
+      endElement(element);
+}
+
+const std::string *OpcUANodeSetLoader::getAttr(const char *name) const {
+   for (size_t i = 0; i < attrCount; i++) {
+      if (attrs[i].first == name)
+         return &attrs[i].second;
+   }
+   return nullptr;
+}
+
+void OpcUANodeSetLoader::startElement(const std::string &name) {
+   keepText = false;
+   text.clear();
+
+   if (name == "UAObject") {
+      beginNode(new (_nodeHandler) OpcUAObjectNodeContext(_nodeHandler));
+   } else if (name == "UAVariable") {
+      beginNode(new (_nodeHandler) OpcUAVarNodeContext(_nodeHandler));
+   } else if (name == "UAMethod") {
+      beginNode(new (_nodeHandler) OpcUAMethodNodeContext(_nodeHandler));
+   } else if (name.compare(0, 2, "UA") == 0 && name != "UANodeSet") {
+      /* types and views are not handled by us */
+      skipped++;
+   } else if (name == "NamespaceUris") {
+      inNamespaceUris = true;
+   } else if (name == "Uri" && inNamespaceUris) {
+      keepText = true;
+   } else if (name == "Alias") {
+      const std::string *alias = getAttr("Alias");
+      aliasName = alias ? *alias : "";
+      keepText = true;
+   } else if (current && (name == "DisplayName" || name == "Description")) {
+      keepText = true;
+   } else if (current && name == "Reference") {
+      const std::string *type = getAttr("ReferenceType");
+      const std::string *forward = getAttr("IsForward");
+      refType = type ? *type : "";
+      refForward = !forward || *forward != "false";
+      keepText = true;
+   }
+}
+
+void OpcUANodeSetLoader::endElement(const std::string &name) {
+   if (keepText)
+      decodeEntities(&text);
+
+   if (name == "NamespaceUris") {
+      inNamespaceUris = false;
+   } else if (name == "Uri" && inNamespaceUris) {
+      std::string uri = trim(text);
+      /* 0 if the replicas disagree, the nodes of it are skipped then */
+      if (_nodeHandler->checkServer())
+         nsMap.push_back(_nodeHandler->addNamespace(uri));
+      else
+         nsMap.push_back(nsMap.size() + 1);
+   } else if (name == "Alias") {
+      aliases[aliasName] = trim(text);
+   } else if (current) {
+      if (name == "DisplayName") {
+         displayName = text;
+      } else if (name == "Description") {
+         description = text;
+      } else if (name == "Reference") {
+         std::string target = trim(text);
+         UA_NodeId type;
+         std::string typeStorage;
+         bool typeDef = refType == "HasTypeDefinition" ||
+               (parseNodeId(refType, &type, &typeStorage) &&
+                type.namespaceIndex == 0 &&
+                type.identifierType == UA_NODEIDTYPE_NUMERIC &&
+                type.identifier.numeric == UA_NS0ID_HASTYPEDEFINITION);
+         if (typeDef && refForward)
+            typeDefinition = target;
+         else if (!typeDef && !refForward && parentId.empty())
+            /* the inverse hierarchical reference points to the parent */
+            parentId = target;
+      } else if (name == "UAObject" || name == "UAVariable" ||
+                 name == "UAMethod") {
+         endNode();
+      }
+   }
+
+   keepText = false;
+   text.clear();
+}
+
+void OpcUANodeSetLoader::beginNode(OpcUANodeContext *ctx) {
+   const std::string *attr;
+
+   current = ctx;
+   attr = getAttr("NodeId");
+   nodeId = attr ? *attr : "";
+   attr = getAttr("BrowseName");
+   browseName = attr ? *attr : "";
+   attr = getAttr("ParentNodeId");
+   parentId = attr ? *attr : "";
+   attr = getAttr("DataType");
+   dataType = attr ? *attr : "";
+   attr = getAttr("AccessLevel");
+   accessLevel = attr ? atoi(attr->c_str()) : UA_ACCESSLEVELMASK_READ;
+   displayName.clear();
+   description.clear();
+   typeDefinition.clear();
+}
+
+void OpcUANodeSetLoader::endNode() {
+   OpcUANodeContext *ctx = current;
+   current = nullptr;
+
+   UA_NodeId id;
+   std::string idStorage;
+   if (!parseNodeId(nodeId, &id, &idStorage) || id.namespaceIndex == 0) {
+      /* namespace 0 is part of every server already */
+      delete ctx;
+      skipped++;
+      return;
+   }
+
+   /* the browse name is prefixed by its namespace, e.g. "1:Pump" */
+   std::string name = browseName;
+   uint16_t browseNs = id.namespaceIndex;
+   size_t colon = browseName.find(':');
+   if (colon != std::string::npos && colon > 0 &&
+       browseName.find_first_not_of("0123456789") == colon) {
+      browseNs = mapNamespace(strtoul(browseName.c_str(), nullptr, 10));
+      name = browseName.substr(colon + 1);
+   }
+
+   ctx->setNamespace(browseNs);
+   ctx->setName(displayName.empty() ? name : trim(displayName));
+   ctx->setQualifiedName(name);
+   ctx->setDescription(trim(description));
+   if (!ctx->setNodeId(&id)) {
+      /* a NodeId given twice, the first node keeps it */
+      delete ctx;
+      skipped++;
+      return;
+   }
+
+   if (ctx->getNodeClass() == UA_NODECLASS_VARIABLE) {
+      OpcUAVarNodeContext *var = static_cast<OpcUAVarNodeContext *>(ctx);
+      int16_t type = resolveDataType(dataType);
+      if (type >= 0)
+         var->setDataTypeNumber(type);
+      var->setReadable(accessLevel & UA_ACCESSLEVELMASK_READ);
+      var->setWriteable(accessLevel & UA_ACCESSLEVELMASK_WRITE);
+   } else if (ctx->getNodeClass() == UA_NODECLASS_OBJECT) {
+      UA_NodeId type;
+      std::string typeStorage;
+      if (parseNodeId(typeDefinition, &type, &typeStorage) &&
+          type.namespaceIndex == 0 &&
+          type.identifierType == UA_NODEIDTYPE_NUMERIC &&
+          type.identifier.numeric <= INT8_MAX)
+         /* larger ids would wrap to a wrong type, they keep the default */
+         static_cast<OpcUAObjectNodeContext *>(ctx)->setObjectType(
+               (int8_t) type.identifier.numeric);
+   }
+
+   if (onNode && !onNode(ctx)) {
+      delete ctx;
+      skipped++;
+      return;
+   }
+
+   linkParent(ctx, parentId, false);
+   loaded.push_back(ctx);
+}
+
+void OpcUANodeSetLoader::linkParent(OpcUANodeContext *ctx,
+                                    const std::string &parent, bool late) {
+   UA_NodeId id;
+   std::string storage;
+   if (parent.empty() || !parseNodeId(parent, &id, &storage))
+      return;
+
+   OpcUANodeContext *parentCtx = nullptr;
+   if (_nodeHandler->findNodeInIndex(&id, &parentCtx) && parentCtx != ctx) {
+      parentCtx->addChild(ctx);
+      return;
+   }
+
+   if (!late && id.namespaceIndex != 0) {
+      pending.push_back(std::make_pair(ctx, parent));
+      return;
+   }
+   ctx->setParentNodeId(&id);
+}
+
+void OpcUANodeSetLoader::orderLoaded() {
+   std::unordered_map<OpcUANodeContext *, size_t> depth;
+   for (size_t i = 0; i < loaded.size(); i++)
+      depth[loaded[i]] = 0;
+
+   for (size_t i = 0; i < loaded.size(); i++) {
+      OpcUANodeContext *ctx = loaded[i];
+      size_t d = 0;
+      /* the bound stops at cycles in broken files */
+      while (d < loaded.size() &&
+             _nodeHandler->findNodeInIndex(ctx->getParent(), &ctx) &&
+             depth.count(ctx))
+         d++;
+      depth[loaded[i]] = d;
+   }
+
+   std::stable_sort(loaded.begin(), loaded.end(),
+                    [&depth](OpcUANodeContext *a, OpcUANodeContext *b) {
+      return depth[a] < depth[b];
+   });
+}
+
+uint16_t OpcUANodeSetLoader::mapNamespace(unsigned long ns) {
+   if (ns == 0)
+      return 0;
+   if (ns - 1 < nsMap.size())
+      return nsMap[ns - 1];
+   return (uint16_t) ns;
+}
+
+bool OpcUANodeSetLoader::parseNodeId(const std::string &text, UA_NodeId *id,
+                                     std::string *storage) {
+   std::unordered_map<std::string, std::string>::const_iterator alias;
+   alias = aliases.find(text);
+   const char *str = alias != aliases.end() ? alias->second.c_str()
+                                            : text.c_str();
+   char *end;
+
+   id->namespaceIndex = 0;
+   if (strncmp(str, "ns=", 3) == 0) {
+      unsigned long ns = strtoul(str + 3, &end, 10);
+      if (end == str + 3 || *end != ';')
+         return false;
+      id->namespaceIndex = mapNamespace(ns);
+      str = end + 1;
+   }
+
+   if (str[0] == '\0' || str[1] != '=')
+      return false;
+
+   switch (str[0]) {
+   case 'i':
+      id->identifierType = UA_NODEIDTYPE_NUMERIC;
+      id->identifier.numeric = strtoul(str + 2, &end, 10);
+      return end != str + 2 && *end == '\0';
+   case 's':
+      storage->assign(str + 2);
+      id->identifierType = UA_NODEIDTYPE_STRING;
+      id->identifier.string.length = storage->size();
+      id->identifier.string.data = (UA_Byte *) storage->data();
+      return true;
+   case 'g': {
+      unsigned int d[11];
+      if (sscanf(str + 2, "%8x-%4x-%4x-%2x%2x-%2x%2x%2x%2x%2x%2x",
+                 &d[0], &d[1], &d[2], &d[3], &d[4], &d[5], &d[6], &d[7],
+                 &d[8], &d[9], &d[10]) != 11)
+         return false;
+      id->identifierType = UA_NODEIDTYPE_GUID;
+      id->identifier.guid.data1 = d[0];
+      id->identifier.guid.data2 = (UA_UInt16) d[1];
+      id->identifier.guid.data3 = (UA_UInt16) d[2];
+      for (int i = 0; i < 8; i++)
+         id->identifier.guid.data4[i] = (UA_Byte) d[3 + i];
+      return true;
+   }
+   default:
+      /* opaque (b=) NodeIds are not supported */
+      return false;
+   }
+}
+
+int16_t OpcUANodeSetLoader::resolveDataType(const std::string &text) {
+   if (text.empty())
+      return -1;
+
+   /* the aliases of the builtin types mostly carry the type names */
+   int16_t type = _nodeHandler->mapDataTypeToName(text.c_str());
+   if (type >= 0)
+      return type;
+
+   UA_NodeId id;
+   std::string storage;
+   if (!parseNodeId(text, &id, &storage) || id.namespaceIndex != 0 ||
+       id.identifierType != UA_NODEIDTYPE_NUMERIC)
+      return -1;
+
+   for (int16_t i = 0; i < UA_TYPES_COUNT; i++) {
+      if (UA_TYPES[i].typeId.identifierType == UA_NODEIDTYPE_NUMERIC &&
+          UA_TYPES[i].typeId.identifier.numeric == id.identifier.numeric)
+         return i;
+   }
+   return -1;
+}
+
+} /* namespace n_opcua */
@@ -0,0 +1,225 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#ifndef SRC_OPCUANODESETLOADER_H_
+#define SRC_OPCUANODESETLOADER_H_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <unordered_map>
+#include "OpcUANodeHandler.h"
+
+namespace n_opcua {
+
+/**
+ * @brief Called for every node created from a NodeSet2 file, before it is
+ * added to the server. Use it to bind read/write or method callbacks.
+ * @return false to drop the node
+ */
+typedef std::function<bool(OpcUANodeContext *ctx)> OpcUANodeSetCallback;
+
+/**
+ * Streaming loader of NodeSet2 XML files.
+ *
+ * The file is read in fixed size chunks and parsed SAX style, so the memory
+ * used for parsing does not depend on the file size. Only the UAObject,
+ * UAVariable and UAMethod nodes are loaded, into OpcUAObjectNodeContext,
+ * OpcUAVarNodeContext and OpcUAMethodNodeContext instances registered with
+ * the node handler. Types, views and values of the file are skipped.
+ */
+class OpcUANodeSetLoader {
+private:
+   typedef std::vector<std::pair<std::string, std::string> > Attributes;
+
+   enum ParseState {
+      StateText,
+      StateTag,
+      /* a tag starting with "<!" */
+      StateDeclaration,
+      StateComment,
+      StateCData
+   };
+
+   OpcUANodeHandler *_nodeHandler;
+   OpcUANodeSetCallback onNode;
+
+   /* tokenizer state */
+   ParseState state;
+   std::string tag;
+   std::string text;
+   bool keepText;
+   char quote;
+   /* recent characters, to find the end of comments and CDATA */
+   char tail[2];
+   /* the name of the current element, without namespace prefix */
+   std::string element;
+   /* the attributes of the current tag, the entries are reused */
+   Attributes attrs;
+   size_t attrCount;
+
+   /* namespace index of the file - 1 to the one on the server */
+   std::vector<uint16_t> nsMap;
+   bool inNamespaceUris;
+   /* alias name to NodeId */
+   std::unordered_map<std::string, std::string> aliases;
+   std::string aliasName;
+
+   /* the node being read */
+   OpcUANodeContext *current;
+   std::string nodeId;
+   std::string browseName;
+   std::string displayName;
+   std::string description;
+   std::string dataType;
+   std::string parentId;
+   std::string typeDefinition;
+   int accessLevel;
+   std::string refType;
+   bool refForward;
+
+   /* all loaded nodes, in file order */
+   std::vector<OpcUANodeContext *> loaded;
+   /* nodes whose parent came later in the file */
+   std::vector<std::pair<OpcUANodeContext *, std::string> > pending;
+   size_t skipped;
+   std::string error;
+
+   /**
+    * @brief Parse the next chunk of the document
+    */
+   void feed(const char *data, size_t length);
+
+   /**
+    * @brief Handle a complete tag, without its angle brackets
+    */
+   void flushTag();
+
+   /**
+    * @brief Handle the start and end of an element, by its name without
+    * namespace prefix
+    */
+   void startElement(const std::string &name);
+   void endElement(const std::string &name);
+
+   /**
+    * @brief Set the current element name from a part of the tag
+    */
+   void setElement(size_t begin, size_t end);
+
+   /**
+    * @brief Start reading a node into a new context
+    */
+   void beginNode(OpcUANodeContext *ctx);
+
+   /**
+    * @brief Set up the context of the node read and register it
+    */
+   void endNode();
+
+   /**
+    * @brief Make a node the child of its parent
+    * @param ctx the context of the node
+    * @param parent the NodeId of the parent as given in the file
+    * @param late if the parent can no longer come later in the file
+    */
+   void linkParent(OpcUANodeContext *ctx, const std::string &parent,
+                   bool late);
+
+   /**
+    * @brief Sort the loaded nodes so parents come before their children
+    */
+   void orderLoaded();
+
+   /**
+    * @brief Return the value of an attribute of the current tag
+    */
+   const std::string *getAttr(const char *name) const;
+
+   /**
+    * @brief Map a namespace index of the file to the one on the server
+    */
+   uint16_t mapNamespace(unsigned long ns);
+
+   /**
+    * @brief Parse the text form of a NodeId, e.g. "ns=1;i=5001", mapping the
+    * namespace of the file to the one on the server
+    * @param text the NodeId or an alias of it
+    * @param id the returned NodeId, string identifiers point into storage
+    * @param storage the identifier bytes of string NodeIds
+    * @return true if parsed, else false
+    */
+   bool parseNodeId(const std::string &text, UA_NodeId *id,
+                    std::string *storage);
+
+   /**
+    * @brief Return the open62541 type index of a DataType attribute
+    * @return the index or -1 if unknown
+    */
+   int16_t resolveDataType(const std::string &text);
+
+public:
+   /**
+    * @brief Constructor for this class
+    * @param nodeHandler The handler the nodes are created with
+    */
+   OpcUANodeSetLoader(OpcUANodeHandler *nodeHandler);
+
+   /**
+    * @brief Set the callback called for every created node
+    * @param callback The callback
+    */
+   void setNodeCallback(OpcUANodeSetCallback callback) {
+      onNode = callback;
+   }
+
+   /**
+    * @brief Load a NodeSet2 file
+    * @param path The path of the file
+    * @param addToServer If the loaded nodes are added to the server
+    * @return true if loaded, else false, see getError()
+    */
+   bool loadFile(const std::string &path, bool addToServer = true);
+
+   /**
+    * @brief Load a NodeSet2 document from an open file
+    * @param file The file to read until its end
+    * @param addToServer If the loaded nodes are added to the server
+    * @return true if loaded, else false, see getError()
+    */
+   bool load(FILE *file, bool addToServer = true);
+
+   /**
+    * @brief Return the nodes loaded by the last load, parents before their
+    * children
+    */
+   const std::vector<OpcUANodeContext *> &getLoadedNodes() {
+      return loaded;
+   }
+
+   /**
+    * @brief Return the count of nodes of the last load which were skipped,
+    * e.g. for a NodeId given twice
+    */
+   size_t getSkippedCount() {
+      return skipped;
+   }
+
+   /**
+    * @brief Return the reason the last load failed
+    */
+   const std::string &getError() {
+      return error;
+   }
+};
+
+} /* namespace n_opcua */
+
+#endif /* SRC_OPCUANODESETLOADER_H_ */
@@ -0,0 +1,90 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include <chrono>
+#include <mutex>
+#include "OpcUANodeStats.h"
+
+namespace n_opcua {
+
+double OpcUACallStats::nsPerTick = 1.0;
+std::atomic<uint32_t> OpcUACallStats::sampleMask(0);
+
+uint64_t OpcUACallStatsSnapshot::percentileNs(double share) const {
+   if (timed == 0)
+      return 0;
+
+   uint64_t wanted = (uint64_t) (share * timed);
+   uint64_t counted = 0;
+   for (unsigned i = 0; i < buckets.size(); i++) {
+      counted += buckets[i];
+      if (counted > wanted || counted == timed) {
+         /* the upper bound of the bucket, the maximum within the last one */
+         if (i + 1 >= buckets.size())
+            return maxNs;
+         uint64_t upper = OpcUACallStats::bucketLowerNs(i + 1) - 1;
+         return upper < maxNs ? upper : maxNs;
+      }
+   }
+   return maxNs;
+}
+
+OpcUACallStats::OpcUACallStats() {
+   reset();
+}
+
+void OpcUACallStats::calibrate() {
+   static std::once_flag once;
+
+   std::call_once(once, []() {
+      std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+      uint64_t ticks = now();
+      std::chrono::steady_clock::time_point end;
+      do {
+         end = std::chrono::steady_clock::now();
+      } while (end - start < std::chrono::milliseconds(5));
+      ticks = now() - ticks;
+
+      std::chrono::duration<double, std::nano> elapsed = end - start;
+      if (ticks > 0)
+         nsPerTick = elapsed.count() / ticks;
+   });
+}
+
+uint64_t OpcUACallStats::bucketLowerNs(unsigned bucket) {
+   if (bucket < subBuckets)
+      return bucket;
+   unsigned exp = bucket / subBuckets + subBucketBits - 1;
+   uint64_t sub = bucket % subBuckets;
+   return (1ull << exp) + (sub << (exp - subBucketBits));
+}
+
+void OpcUACallStats::snapshot(OpcUACallStatsSnapshot *snapshot) const {
+   snapshot->buckets.resize(bucketCount);
+   snapshot->timed = 0;
+   for (unsigned i = 0; i < bucketCount; i++) {
+      snapshot->buckets[i] = buckets[i].load(std::memory_order_relaxed);
+      snapshot->timed += snapshot->buckets[i];
+   }
+   snapshot->calls = calls.load(std::memory_order_relaxed);
+   snapshot->errors = errors.load(std::memory_order_relaxed);
+   snapshot->totalNs = totalNs.load(std::memory_order_relaxed);
+   snapshot->maxNs = maxNs.load(std::memory_order_relaxed);
+}
+
+void OpcUACallStats::reset() {
+   calls.store(0, std::memory_order_relaxed);
+   errors.store(0, std::memory_order_relaxed);
+   totalNs.store(0, std::memory_order_relaxed);
+   maxNs.store(0, std::memory_order_relaxed);
+   for (unsigned i = 0; i < bucketCount; i++)
+      buckets[i].store(0, std::memory_order_relaxed);
+}
+
+} /* namespace n_opcua */
@@ -0,0 +1,199 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#ifndef SRC_OPCUANODESTATS_H_
+#define SRC_OPCUANODESTATS_H_
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+namespace n_opcua {
+
+/**
+ * @brief A copy of the statistics of one kind of call
+ */
+struct OpcUACallStatsSnapshot {
+   /* the count of calls and of failed calls */
+   uint64_t calls;
+   uint64_t errors;
+   /* the count of timed calls, all or a sample of the calls */
+   uint64_t timed;
+   /* the sum and the maximum of the timed call durations */
+   uint64_t totalNs;
+   uint64_t maxNs;
+   /* the count of timed calls per latency bucket, see OpcUACallStats */
+   std::vector<uint64_t> buckets;
+
+   /**
+    * @brief Return the mean call duration in ns, 0 without timed calls
+    */
+   double meanNs() const {
+      return timed ? (double) totalNs / timed : 0;
+   }
+
+   /**
+    * @brief Return the duration a share of the timed calls stayed below
+    * @param share the share, e.g. 0.99 for the 99th percentile
+    * @return the upper bound of the bucket in ns, 0 without timed calls
+    */
+   uint64_t percentileNs(double share) const;
+};
+
+/**
+ * Call counters and a latency histogram of one kind of call of a node.
+ *
+ * The histogram is log linear like a HDR histogram: every power of two is
+ * split in subBuckets buckets, so a bucket is at most 1/subBuckets off. The
+ * counters are relaxed atomics. Counting a call costs an uncontended atomic
+ * add, timing it two clock reads and two more adds, so only every n-th call
+ * of a thread may be timed, see setSampling().
+ */
+class OpcUACallStats {
+public:
+   static const unsigned subBucketBits = 2;
+   static const unsigned subBuckets = 1 << subBucketBits;
+   /* up to 2^32 ns, about 4 s, longer calls count in the last bucket */
+   static const unsigned bucketCount = (32 - subBucketBits + 1) * subBuckets;
+
+private:
+   std::atomic<uint64_t> calls;
+   std::atomic<uint64_t> errors;
+   std::atomic<uint64_t> totalNs;
+   std::atomic<uint64_t> maxNs;
+   /* the timed call count is the sum of the buckets */
+   std::atomic<uint64_t> buckets[bucketCount];
+
+   /* ns per tick of now(), see calibrate() */
+   static double nsPerTick;
+   /* calls of a thread not timed between two timed ones, a power of 2 - 1 */
+   static std::atomic<uint32_t> sampleMask;
+
+public:
+   OpcUACallStats();
+
+   OpcUACallStats(const OpcUACallStats &) = delete;
+   OpcUACallStats &operator=(const OpcUACallStats &) = delete;
+
+   /**
+    * @brief Return the current time in ticks of a cheap clock
+    */
+   static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+      return __rdtsc();
+#else
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+   }
+
+   /**
+    * @brief Measure the tick rate of now(), has to be called once before
+    * recording, takes a few milliseconds
+    */
+   static void calibrate();
+
+   /**
+    * @brief Time only every 2^shift-th call of a thread
+    * @param shift 0 to time every call
+    */
+   static void setSampling(unsigned shift) {
+      sampleMask.store((1u << (shift < 31 ? shift : 31)) - 1,
+                       std::memory_order_relaxed);
+   }
+
+   /**
+    * @brief Start a call of this thread
+    * @return the time from now() if the call is timed, else 0
+    */
+   static uint64_t start() {
+      static thread_local uint32_t callsOfThread = 0;
+      if ((callsOfThread++ & sampleMask.load(std::memory_order_relaxed)) != 0)
+         return 0;
+      return now();
+   }
+
+   /**
+    * @brief Return the bucket of a duration
+    */
+   static unsigned bucketOf(uint64_t ns) {
+      if (ns < subBuckets)
+         return (unsigned) ns;
+      unsigned exp = 63 - __builtin_clzll(ns);
+      unsigned bucket = (exp - subBucketBits + 1) * subBuckets +
+                        ((ns >> (exp - subBucketBits)) & (subBuckets - 1));
+      return bucket < bucketCount ? bucket : bucketCount - 1;
+   }
+
+   /**
+    * @brief Return the smallest duration counted in a bucket
+    */
+   static uint64_t bucketLowerNs(unsigned bucket);
+
+   /**
+    * @brief Record a call
+    * @param start the value of start() before the call
+    * @param ok if the call succeeded
+    */
+   void record(uint64_t start, bool ok) {
+      calls.fetch_add(1, std::memory_order_relaxed);
+      if (!ok)
+         errors.fetch_add(1, std::memory_order_relaxed);
+      if (start == 0)
+         return;
+
+      uint64_t ns = (uint64_t) ((now() - start) * nsPerTick);
+      buckets[bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+      totalNs.fetch_add(ns, std::memory_order_relaxed);
+
+      uint64_t max = maxNs.load(std::memory_order_relaxed);
+      while (ns > max &&
+             !maxNs.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+         ;
+   }
+
+   /**
+    * @brief Copy the statistics, calls recorded meanwhile may be missing in
+    * parts of the copy
+    * @param snapshot the copy to fill
+    */
+   void snapshot(OpcUACallStatsSnapshot *snapshot) const;
+
+   /**
+    * @brief Start over from zero
+    */
+   void reset();
+};
+
+/**
+ * @brief The statistics of a node, read and write for variables, call for
+ * methods
+ */
+struct OpcUANodeStats {
+   OpcUACallStats read;
+   OpcUACallStats write;
+   OpcUACallStats call;
+};
+
+/**
+ * @brief A copy of the statistics of a node
+ */
+struct OpcUANodeStatsSnapshot {
+   OpcUACallStatsSnapshot read;
+   OpcUACallStatsSnapshot write;
+   OpcUACallStatsSnapshot call;
+};
+
+} /* namespace n_opcua */
+
+#endif /* SRC_OPCUANODESTATS_H_ */
@@ -0,0 +1,210 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include "OpcUAPathIndex.h"
+
+namespace n_opcua {
+
+OpcUAPathIndex::OpcUAPathIndex() : count(0), nodeCount(0) {
+   root.ctx = nullptr;
+}
+
+OpcUAPathIndex::~OpcUAPathIndex() {
+   freeChildren(&root);
+}
+
+size_t OpcUAPathIndex::childOf(const Node *node, unsigned char c,
+                               bool *found) {
+   size_t low = 0;
+   size_t high = node->firsts.size();
+
+   while (low < high) {
+      size_t mid = (low + high) / 2;
+      unsigned char first = node->firsts[mid];
+      if (first == c) {
+         *found = true;
+         return mid;
+      }
+      if (first < c)
+         low = mid + 1;
+      else
+         high = mid;
+   }
+   *found = false;
+   return low;
+}
+
+void OpcUAPathIndex::freeChildren(Node *node) {
+   for (size_t i = 0; i < node->children.size(); i++) {
+      freeChildren(node->children[i]);
+      delete node->children[i];
+   }
+   node->children.clear();
+   node->firsts.clear();
+}
+
+void OpcUAPathIndex::collect(const Node *node,
+                             std::vector<OpcUANodeContext *> *nodes) {
+   if (node->ctx)
+      nodes->push_back(node->ctx);
+   for (size_t i = 0; i < node->children.size(); i++)
+      collect(node->children[i], nodes);
+}
+
+OpcUANodeContext *OpcUAPathIndex::find(const std::string &path) const {
+   const Node *node = &root;
+   size_t pos = 0;
+
+   while (pos < path.size()) {
+      bool found;
+      size_t i = childOf(node, path[pos], &found);
+      if (!found)
+         return nullptr;
+
+      node = node->children[i];
+      if (path.compare(pos, node->label.size(), node->label) != 0)
+         return nullptr;
+      pos += node->label.size();
+   }
+   return node->ctx;
+}
+
+size_t OpcUAPathIndex::findPrefix(const std::string &prefix,
+                                  std::vector<OpcUANodeContext *> *nodes)
+      const {
+   const Node *node = &root;
+   size_t pos = 0;
+   size_t before = nodes->size();
+
+   while (pos < prefix.size()) {
+      bool found;
+      size_t i = childOf(node, prefix[pos], &found);
+      if (!found)
+         return 0;
+
+      node = node->children[i];
+      size_t rest = prefix.size() - pos;
+      if (rest <= node->label.size()) {
+         /* the prefix ends on this edge */
+         if (node->label.compare(0, rest, prefix, pos, rest) != 0)
+            return 0;
+         break;
+      }
+      if (prefix.compare(pos, node->label.size(), node->label) != 0)
+         return 0;
+      pos += node->label.size();
+   }
+
+   collect(node, nodes);
+   return nodes->size() - before;
+}
+
+bool OpcUAPathIndex::insert(const std::string &path, OpcUANodeContext *ctx) {
+   if (path.empty() || !ctx)
+      return false;
+
+   Node *node = &root;
+   size_t pos = 0;
+   while (pos < path.size()) {
+      bool found;
+      size_t i = childOf(node, path[pos], &found);
+      if (!found) {
+         Node *leaf = new Node();
+         leaf->label.assign(path, pos, std::string::npos);
+         leaf->ctx = ctx;
+         node->children.insert(node->children.begin() + i, leaf);
+         node->firsts.insert(node->firsts.begin() + i, path[pos]);
+         nodeCount++;
+         count++;
+         return true;
+      }
+
+      Node *child = node->children[i];
+      size_t common = 1;
+      while (common < child->label.size() && pos + common < path.size() &&
+             child->label[common] == path[pos + common])
+         common++;
+
+      if (common < child->label.size()) {
+         /* split the edge where the paths part */
+         Node *mid = new Node();
+         mid->label.assign(child->label, 0, common);
+         mid->ctx = nullptr;
+         child->label.erase(0, common);
+         mid->children.push_back(child);
+         mid->firsts.push_back(child->label[0]);
+         node->children[i] = mid;
+         nodeCount++;
+         child = mid;
+      }
+      node = child;
+      pos += common;
+   }
+
+   if (node->ctx)
+      return false;
+   node->ctx = ctx;
+   count++;
+   return true;
+}
+
+bool OpcUAPathIndex::erase(const std::string &path, OpcUANodeContext *ctx) {
+   Node *parent = nullptr;
+   size_t slot = 0;
+   Node *node = &root;
+   size_t pos = 0;
+
+   while (pos < path.size()) {
+      bool found;
+      size_t i = childOf(node, path[pos], &found);
+      if (!found)
+         return false;
+
+      Node *child = node->children[i];
+      if (path.compare(pos, child->label.size(), child->label) != 0)
+         return false;
+      pos += child->label.size();
+      parent = node;
+      slot = i;
+      node = child;
+   }
+   if (!parent || !ctx || node->ctx != ctx)
+      return false;
+
+   node->ctx = nullptr;
+   count--;
+
+   if (node->children.empty()) {
+      parent->children.erase(parent->children.begin() + slot);
+      parent->firsts.erase(slot, 1);
+      delete node;
+      nodeCount--;
+      node = parent;
+   }
+
+   /* a node without context and a single child is merged with it */
+   if (node != &root && !node->ctx && node->children.size() == 1) {
+      Node *child = node->children[0];
+      node->label += child->label;
+      node->ctx = child->ctx;
+      node->children.swap(child->children);
+      node->firsts.swap(child->firsts);
+      delete child;
+      nodeCount--;
+   }
+   return true;
+}
+
+void OpcUAPathIndex::clear() {
+   freeChildren(&root);
+   root.ctx = nullptr;
+   count = 0;
+   nodeCount = 0;
+}
+
+} /* namespace n_opcua */
@@ -0,0 +1,141 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#ifndef SRC_OPCUAPATHINDEX_H_
+#define SRC_OPCUAPATHINDEX_H_
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace n_opcua {
+
+class OpcUANodeContext;
+
+/**
+ * Radix tree from browse paths like "Plant/Line3/Motor12/Speed" to their
+ * OpcUANodeContext.
+ *
+ * Every edge holds the bytes shared by all paths below it, so a lookup
+ * compares each byte of the path once and costs time proportional to the
+ * path length, independent of the count of indexed paths. The children of a
+ * node are ordered by the first byte of their edge. Paths sharing a prefix
+ * share its nodes, which also makes enumerating all paths below a prefix a
+ * walk of one subtree.
+ */
+class OpcUAPathIndex {
+private:
+   struct Node {
+      /* the bytes of the edge leading to this node */
+      std::string label;
+      /* the context of the path ending here, nullptr if none */
+      OpcUANodeContext *ctx;
+      /* ordered by the first byte of their label */
+      std::vector<Node *> children;
+      /* the first byte of the label of each child, searched without
+       * touching the children themselves */
+      std::string firsts;
+   };
+
+   Node root;
+   size_t count;
+   size_t nodeCount;
+
+   /**
+    * @brief Return the position of the child starting with a byte
+    * @param node the node to search
+    * @param c the first byte of the label
+    * @param found set if a child starts with c
+    * @return the position of the child, or where it would be inserted
+    */
+   static size_t childOf(const Node *node, unsigned char c, bool *found);
+
+   /**
+    * @brief Free the nodes below a node
+    */
+   void freeChildren(Node *node);
+
+   /**
+    * @brief Append the contexts of a node and all nodes below it
+    */
+   static void collect(const Node *node,
+                       std::vector<OpcUANodeContext *> *nodes);
+
+public:
+   /**
+    * @brief Constructor for an empty index
+    */
+   OpcUAPathIndex();
+
+   /**
+    * @brief Default deconstructor
+    */
+   virtual ~OpcUAPathIndex();
+
+   OpcUAPathIndex(const OpcUAPathIndex &) = delete;
+   OpcUAPathIndex &operator=(const OpcUAPathIndex &) = delete;
+
+   /**
+    * @brief Find the context indexed under a path
+    * @param path the path to look for
+    * @return the context or nullptr if not found
+    */
+   OpcUANodeContext *find(const std::string &path) const;
+
+   /**
+    * @brief Append the contexts of all paths starting with a prefix, in the
+    * byte order of their paths
+    * @param prefix the prefix, "Plant/Line3/" for the nodes below Line3
+    * @param nodes the found contexts are appended to it
+    * @return the count of found contexts
+    */
+   size_t findPrefix(const std::string &prefix,
+                     std::vector<OpcUANodeContext *> *nodes) const;
+
+   /**
+    * @brief Index a context under a path, the first context claiming a path
+    * wins
+    * @param path the path of the context
+    * @param ctx the context to index
+    * @return true if inserted, false if the path is empty or already taken
+    */
+   bool insert(const std::string &path, OpcUANodeContext *ctx);
+
+   /**
+    * @brief Remove a context from the index
+    * @param path the path the context was indexed under
+    * @param ctx the context to remove, another context claiming the same
+    * path is left alone
+    * @return true if removed, else false
+    */
+   bool erase(const std::string &path, OpcUANodeContext *ctx);
+
+   /**
+    * @brief Remove all entries
+    */
+   void clear();
+
+   /**
+    * @brief Return the count of indexed paths
+    */
+   size_t size() const {
+      return count;
+   }
+
+   /**
+    * @brief Return the memory used by the tree nodes in bytes, without the
+    * heap memory of long labels and of the child arrays
+    */
+   size_t memoryUsage() const {
+      return nodeCount * sizeof(Node);
+   }
+};
+
+} /* namespace n_opcua */
+
+#endif /* SRC_OPCUAPATHINDEX_H_ */
@@ -6,7 +6,13 @@
  * <tobias.johannes.klausmann@mni.thm.de>
  */
 
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
 #include "OpcUAServer.h"
+#include "OpcUAClock.h"
 
 namespace n_opcua {
 
@@ -38,6 +44,185 @@ void OpcUAServer::resetBaseConfig() {
 
    config = nullptr;
    config = UA_ServerConfig_new_minimal(port, cert);
+#ifdef UA_ENABLE_MULTITHREADING
+   config->nThreads = threads;
+#endif
+   defaultLimits = getLimits();
+}
+
+OpcUAServerLimits OpcUAServer::getProfileLimits(OpcServerProfile profile) {
+   OpcUAServerLimits limits = defaultLimits;
+
+   switch (profile) {
+   case ProfileLowLatency:
+      /* a read response fits a single small chunk, and few clients and
+       * short queues keep the work of an iteration short */
+      limits.sendBufferSize = 8192;
+      limits.recvBufferSize = 8192;
+      limits.maxSecureChannels = 10;
+      limits.maxSessions = 10;
+      limits.maxPublishRequestsPerSession = 2;
+      limits.maxNotificationsPerPublish = 100;
+      limits.maxQueueSize = 10;
+      limits.minPublishingInterval = 1;
+      limits.minSamplingInterval = 1;
+      break;
+   case ProfileHighFanOut:
+      limits.sendBufferSize = 262144;
+      limits.recvBufferSize = 262144;
+      limits.maxMessageSize = 16 * 1024 * 1024;
+      limits.maxChunkCount = 0;
+      limits.maxSecureChannels = 1000;
+      limits.maxSessions = 1000;
+      limits.maxSubscriptionsPerSession = 50;
+      limits.maxMonitoredItemsPerSubscription = 10000;
+      limits.maxPublishRequestsPerSession = 20;
+      limits.maxNotificationsPerPublish = 10000;
+      limits.maxRetransmissionQueueSize = 100;
+      limits.maxQueueSize = 100;
+      break;
+   case ProfileLowMemory:
+      limits.sendBufferSize = 8192;
+      limits.recvBufferSize = 8192;
+      limits.maxMessageSize = 65536;
+      limits.maxChunkCount = 8;
+      limits.maxSecureChannels = 4;
+      limits.maxSessions = 4;
+      limits.maxSubscriptionsPerSession = 2;
+      limits.maxMonitoredItemsPerSubscription = 100;
+      limits.maxPublishRequestsPerSession = 4;
+      limits.maxNotificationsPerPublish = 100;
+      limits.maxRetransmissionQueueSize = 4;
+      limits.maxQueueSize = 10;
+      break;
+   case ProfileDefault:
+      break;
+   }
+   return limits;
+}
+
+bool OpcUAServer::setProfile(OpcServerProfile profile) {
+   OpcUAServerLimits limits = getProfileLimits(profile);
+   if (!setLimits(limits))
+      return false;
+
+   /* without UA_ENABLE_SUBSCRIPTIONS the config drops the subscription
+    * limits, so the preset is only partly applied */
+   OpcUAServerLimits applied = getLimits();
+   return applied.maxSubscriptionsPerSession ==
+                limits.maxSubscriptionsPerSession &&
+          applied.maxMonitoredItemsPerSubscription ==
+                limits.maxMonitoredItemsPerSubscription &&
+          applied.maxPublishRequestsPerSession ==
+                limits.maxPublishRequestsPerSession &&
+          applied.maxNotificationsPerPublish ==
+                limits.maxNotificationsPerPublish &&
+          applied.maxRetransmissionQueueSize ==
+                limits.maxRetransmissionQueueSize &&
+          applied.maxQueueSize == limits.maxQueueSize &&
+          applied.minPublishingInterval == limits.minPublishingInterval &&
+          applied.minSamplingInterval == limits.minSamplingInterval;
+}
+
+bool OpcUAServer::setLimits(const OpcUAServerLimits &limits) {
+   /* the server copied the config when it was created */
+   if (server)
+      return false;
+   /* the smallest chunk the OPC UA transport allows */
+   if (limits.sendBufferSize < 8192 || limits.recvBufferSize < 8192)
+      return false;
+
+   for (size_t i = 0; i < config->networkLayersSize; i++) {
+      UA_ConnectionConfig *connection =
+            &config->networkLayers[i].localConnectionConfig;
+      connection->sendBufferSize = limits.sendBufferSize;
+      connection->recvBufferSize = limits.recvBufferSize;
+      connection->maxMessageSize = limits.maxMessageSize;
+      connection->maxChunkCount = limits.maxChunkCount;
+   }
+   config->maxSecureChannels = limits.maxSecureChannels;
+   config->maxSessions = limits.maxSessions;
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+   config->maxSubscriptionsPerSession = limits.maxSubscriptionsPerSession;
+   config->maxMonitoredItemsPerSubscription =
+         limits.maxMonitoredItemsPerSubscription;
+   config->maxPublishReqPerSession = limits.maxPublishRequestsPerSession;
+   config->maxNotificationsPerPublish = limits.maxNotificationsPerPublish;
+   config->maxRetransmissionQueueSize = limits.maxRetransmissionQueueSize;
+   config->queueSizeLimits.max = limits.maxQueueSize;
+   config->publishingIntervalLimits.min = limits.minPublishingInterval;
+   config->samplingIntervalLimits.min = limits.minSamplingInterval;
+#endif
+   return true;
+}
+
+OpcUAServerLimits OpcUAServer::getLimits() {
+   OpcUAServerLimits limits = OpcUAServerLimits();
+
+   if (config->networkLayersSize > 0) {
+      const UA_ConnectionConfig *connection =
+            &config->networkLayers[0].localConnectionConfig;
+      limits.sendBufferSize = connection->sendBufferSize;
+      limits.recvBufferSize = connection->recvBufferSize;
+      limits.maxMessageSize = connection->maxMessageSize;
+      limits.maxChunkCount = connection->maxChunkCount;
+   }
+   limits.maxSecureChannels = config->maxSecureChannels;
+   limits.maxSessions = config->maxSessions;
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+   limits.maxSubscriptionsPerSession = config->maxSubscriptionsPerSession;
+   limits.maxMonitoredItemsPerSubscription =
+         config->maxMonitoredItemsPerSubscription;
+   limits.maxPublishRequestsPerSession = config->maxPublishReqPerSession;
+   limits.maxNotificationsPerPublish = config->maxNotificationsPerPublish;
+   limits.maxRetransmissionQueueSize = config->maxRetransmissionQueueSize;
+   limits.maxQueueSize = config->queueSizeLimits.max;
+   limits.minPublishingInterval = config->publishingIntervalLimits.min;
+   limits.minSamplingInterval = config->samplingIntervalLimits.min;
+#endif
+   return limits;
+}
+
+bool OpcUAServer::setBufferSizes(uint32_t sendBufferSize,
+                                 uint32_t recvBufferSize) {
+   OpcUAServerLimits limits = getLimits();
+   limits.sendBufferSize = sendBufferSize;
+   limits.recvBufferSize = recvBufferSize;
+   return setLimits(limits);
+}
+
+bool OpcUAServer::setMaxMessageSize(uint32_t maxMessageSize,
+                                    uint32_t maxChunkCount) {
+   OpcUAServerLimits limits = getLimits();
+   limits.maxMessageSize = maxMessageSize;
+   limits.maxChunkCount = maxChunkCount;
+   return setLimits(limits);
+}
+
+bool OpcUAServer::setMaxSessions(uint16_t maxSessions,
+                                 uint16_t maxSecureChannels) {
+   OpcUAServerLimits limits = getLimits();
+   limits.maxSessions = maxSessions;
+   limits.maxSecureChannels = maxSecureChannels;
+   return setLimits(limits);
+}
+
+bool OpcUAServer::setSubscriptionLimits(
+      uint32_t maxSubscriptionsPerSession,
+      uint32_t maxMonitoredItemsPerSubscription,
+      uint32_t maxPublishRequestsPerSession) {
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+   OpcUAServerLimits limits = getLimits();
+   limits.maxSubscriptionsPerSession = maxSubscriptionsPerSession;
+   limits.maxMonitoredItemsPerSubscription = maxMonitoredItemsPerSubscription;
+   limits.maxPublishRequestsPerSession = maxPublishRequestsPerSession;
+   return setLimits(limits);
+#else
+   (void) maxSubscriptionsPerSession;
+   (void) maxMonitoredItemsPerSubscription;
+   (void) maxPublishRequestsPerSession;
+   return false;
+#endif
 }
 
 void OpcUAServer::setBaseConfigDone() {
@@ -110,43 +295,42 @@ void OpcUAServer::removeURI() {
 
 bool OpcUAServer::registerAtLDS(std::string ldsServerURI) {
 
-   _ldsServerURI = ldsServerURI;
-
-   ldsRegisterClient = UA_Client_new(UA_ClientConfig_default);
-
-   // periodic server register after 10 Minutes, delay first register for 500ms
-   UA_StatusCode ret =
-       UA_Server_addPeriodicServerRegisterCallback(server,
-                                                   ldsRegisterClient,
-                                                   _ldsServerURI.c_str(),
-                                                   10 * 60 * 1000, 500,
-                                                   nullptr);
-
-   if(ret != UA_STATUSCODE_GOOD) {
-       UA_Client_disconnect(ldsRegisterClient);
-       UA_Client_delete(ldsRegisterClient);
-       ldsRegisterClient = nullptr;
-       _ldsServerURI = "";
+   if (!server || ldsRegistrar)
+      return false;
 
-       return false;
-   }
+   ldsRegistrar = new OpcUALDSRegistrar(server,
+         [this](const std::function<void()> &task) { runInLoop(task); },
+         ldsServerURI, ldsOptions, ldsCall);
+   ldsRegistrar->start();
    return true;
 }
 
 bool OpcUAServer::unregisterAtLDS() {
 
-   if (!ldsRegisterClient)
+   if (!ldsRegistrar)
       return false;
 
-   UA_StatusCode ret = UA_Server_unregister_discovery(server,
-                                                      ldsRegisterClient);
+   bool ret = ldsRegistrar->stop();
+   delete ldsRegistrar;
+   ldsRegistrar = nullptr;
+
+   return ret;
+}
+
+bool OpcUAServer::setLDSOptions(const OpcUALDSOptions &options) {
+   if (!options.period || !options.minBackoff || !options.timeout ||
+       options.minBackoff > options.maxBackoff)
+      return false;
 
-   UA_Client_disconnect(ldsRegisterClient);
-   UA_Client_delete(ldsRegisterClient);
-   ldsRegisterClient = nullptr;
+   ldsOptions = options;
+   return true;
+}
 
-   if(ret != UA_STATUSCODE_GOOD)
+bool OpcUAServer::getLDSStats(OpcUALDSStats *stats) {
+   if (!ldsRegistrar)
       return false;
+
+   *stats = ldsRegistrar->getStats();
    return true;
 }
 
@@ -188,29 +372,272 @@ void OpcUAServer::removeCapabilites() {
 
 OpcUAServer::OpcUAServer(uint16_t sport) :
    running(true),
+   epoch(0),
+   looping(false),
+   cachedClock(false),
+   wakePending(false),
+   threads(0),
+   sharedNodes(false),
    port(sport),
-   server(nullptr), cert(nullptr), ldsRegisterClient(nullptr), role(RoleServer) {
+   server(nullptr), cert(nullptr), ldsRegistrar(nullptr), role(RoleServer) {
 
    config = UA_ServerConfig_new_minimal(port, cert);
 
    config->applicationDescription.applicationType = UA_APPLICATIONTYPE_SERVER;
+   defaultLimits = getLimits();
+
+   for (unsigned i = 0; i < readerSlotCount; i++)
+      readerSlots[i].store(0, std::memory_order_relaxed);
+   overflowReaders.store(0, std::memory_order_relaxed);
+
+   if (pipe(wakeFds) != 0) {
+      wakeFds[0] = -1;
+      wakeFds[1] = -1;
+   }
+   for (int i = 0; i < 2 && wakeFds[i] >= 0; i++) {
+      fcntl(wakeFds[i], F_SETFL, fcntl(wakeFds[i], F_GETFL) | O_NONBLOCK);
+      fcntl(wakeFds[i], F_SETFD, FD_CLOEXEC);
+   }
 }
 
 OpcUAServer::~OpcUAServer() {
 
+   stop();
+
    unregisterAtLDS();
 
+   applyPendingWrites();
+   applyPendingTasks();
+
    if (server)
       UA_Server_delete(server);
    UA_ServerConfig_delete(config);
+
+   for (int i = 0; i < 2; i++) {
+      if (wakeFds[i] >= 0)
+         close(wakeFds[i]);
+   }
 }
 
 void OpcUAServer::run() {
-   UA_Server_run(server, &running);
+   /* same as UA_Server_run(), but we keep track of the iterations */
+   if (!startup())
+      return;
+   while (running)
+      iterate(true);
+   shutdown();
+}
+
+bool OpcUAServer::startup() {
+   if (!server || looping)
+      return false;
+
+   /* writes and tasks of other threads run at once until looping is set */
+   std::lock_guard<std::recursive_mutex> direct(serverLock);
+   if (UA_Server_run_startup(server) != UA_STATUSCODE_GOOD)
+      return false;
+   std::lock_guard<std::mutex> lock(writeLock);
+   looping = true;
+   /* a terminate() of an earlier loop is no work for this one */
+   drainWakeups();
+   return true;
+}
+
+uint16_t OpcUAServer::iterate(bool waitInternal) {
+   /* the wakeup is consumed before the work it announced is done */
+   drainWakeups();
+
+   bool cycle = cachedClock.load(std::memory_order_relaxed);
+   if (cycle)
+      OpcUAClock::beginCycle();
+   epoch.fetch_add(1, std::memory_order_seq_cst);
+   uint16_t timeout = UA_Server_run_iterate(server, waitInternal);
+   epoch.fetch_add(1, std::memory_order_seq_cst);
+   if (cycle)
+      OpcUAClock::endCycle();
+   applyPendingWrites();
+   applyPendingTasks();
+   return timeout;
+}
+
+void OpcUAServer::shutdown() {
+   std::lock_guard<std::recursive_mutex> direct(serverLock);
+   {
+      std::lock_guard<std::mutex> lock(writeLock);
+      if (!looping)
+         return;
+      looping = false;
+   }
+   applyPendingWrites();
+   applyPendingTasks();
+   UA_Server_run_shutdown(server);
+}
+
+bool OpcUAServer::start(int cpu) {
+   if (!server || loopThread.joinable())
+      return false;
+
+   running = true;
+   loopThread = std::thread(&OpcUAServer::run, this);
+#ifdef __linux__
+   if (cpu >= 0) {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(cpu, &cpus);
+      pthread_setaffinity_np(loopThread.native_handle(), sizeof(cpus), &cpus);
+   }
+#endif
+   return true;
+}
+
+bool OpcUAServer::stop() {
+   if (!loopThread.joinable())
+      return false;
+
+   terminate();
+   loopThread.join();
+   return true;
+}
+
+void OpcUAServer::drainWakeups() {
+   /* the flag is cleared only after the byte of the wake() which set it was
+    * read, so the pipe holds at most that byte: a racing wake() neither
+    * loses its byte nor leaves one behind, and its work was queued before */
+   char byte;
+   if (wakePending.load(std::memory_order_acquire) &&
+       read(wakeFds[0], &byte, 1) == 1)
+      wakePending.store(false, std::memory_order_release);
+}
+
+void OpcUAServer::wake() {
+   /* one byte is enough until iterate() consumed it */
+   if (wakeFds[1] >= 0 && !wakePending.exchange(true)) {
+      char byte = 1;
+      ssize_t written = write(wakeFds[1], &byte, 1);
+      (void) written;
+   }
+}
+
+bool OpcUAServer::epochPassed(uint64_t e) {
+   /* a loop iteration running since e or before is not done yet */
+   if ((e & 1) != 0 && getEpoch() <= e)
+      return false;
+
+   /* worker threads read outside of the iterations */
+   if (!isMultithreaded())
+      return true;
+   if (overflowReaders.load(std::memory_order_seq_cst) > 0)
+      return false;
+   for (unsigned i = 0; i < readerSlotCount; i++) {
+      uint64_t mark = readerSlots[i].load(std::memory_order_seq_cst);
+      if (mark != 0 && mark <= e + 1)
+         return false;
+   }
+   return true;
+}
+
+bool OpcUAServer::setThreads(uint16_t n) {
+   if (server)
+      return false;
+#ifdef UA_ENABLE_MULTITHREADING
+   config->nThreads = n;
+   threads = n;
+   return true;
+#else
+   return n == 0;
+#endif
+}
+
+unsigned OpcUAServer::enterReader() {
+   static std::atomic<unsigned> nextSlot(0);
+   /* every thread starts looking at its own slot */
+   static thread_local unsigned home = nextSlot.fetch_add(1) % readerSlotCount;
+   uint64_t mark = getEpoch() + 1;
+
+   for (unsigned i = 0; i < readerSlotCount; i++) {
+      unsigned slot = (home + i) % readerSlotCount;
+      uint64_t unused = 0;
+      if (readerSlots[slot].compare_exchange_strong(unused, mark,
+                                                    std::memory_order_seq_cst))
+         return slot;
+   }
+   /* more readers than slots, hold back all epochs until we leave */
+   overflowReaders.fetch_add(1, std::memory_order_seq_cst);
+   return readerSlotCount;
+}
+
+bool OpcUAServer::writeValue(const UA_NodeId *node, const UA_Variant *value) {
+   if (!server || !node || !value)
+      return false;
+
+   /* no loop starts while we write at once, and the write callbacks it
+    * calls may write again */
+   std::lock_guard<std::recursive_mutex> direct(serverLock);
+   {
+      std::lock_guard<std::mutex> lock(writeLock);
+      if (looping) {
+         std::pair<UA_NodeId, UA_Variant> write;
+         if (UA_NodeId_copy(node, &write.first) != UA_STATUSCODE_GOOD)
+            return false;
+         if (UA_Variant_copy(value, &write.second) != UA_STATUSCODE_GOOD) {
+            UA_NodeId_deleteMembers(&write.first);
+            return false;
+         }
+         pendingWrites.push_back(write);
+         wake();
+         return true;
+      }
+   }
+   return UA_Server_writeValue(server, *node, *value) == UA_STATUSCODE_GOOD;
+}
+
+void OpcUAServer::applyPendingWrites() {
+   std::vector<std::pair<UA_NodeId, UA_Variant> > writes;
+   {
+      std::lock_guard<std::mutex> lock(writeLock);
+      if (pendingWrites.empty())
+         return;
+      writes.swap(pendingWrites);
+   }
+
+   for (size_t i = 0; i < writes.size(); i++) {
+      if (server)
+         UA_Server_writeValue(server, writes[i].first, writes[i].second);
+      UA_NodeId_deleteMembers(&writes[i].first);
+      UA_Variant_deleteMembers(&writes[i].second);
+   }
+}
+
+void OpcUAServer::runInLoop(const std::function<void()> &task) {
+   /* like writeValue(), a task run at once may write or run tasks again */
+   std::lock_guard<std::recursive_mutex> direct(serverLock);
+   {
+      std::lock_guard<std::mutex> lock(writeLock);
+      if (looping) {
+         pendingTasks.push_back(task);
+         wake();
+         return;
+      }
+   }
+   task();
+}
+
+void OpcUAServer::applyPendingTasks() {
+   std::vector<std::function<void()> > tasks;
+   {
+      std::lock_guard<std::mutex> lock(writeLock);
+      if (pendingTasks.empty())
+         return;
+      tasks.swap(pendingTasks);
+   }
+
+   for (size_t i = 0; i < tasks.size(); i++)
+      tasks[i]();
 }
 
 void OpcUAServer::terminate() {
    running = false;
+   wake();
 }
 
 void OpcUAServer::setName(string sname, string slocale) {
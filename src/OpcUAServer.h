@@ -14,6 +14,13 @@
 
 #include <string>
 #include <set>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "OpcUALDSRegistrar.h"
 
 #ifndef SRC_OPCUASERVER_H_
 #define SRC_OPCUASERVER_H_
@@ -24,12 +31,88 @@ enum OpcServerRole {
    RoleDiscoveryServer,
 };
 
+/* presets of the server limits, see OpcUAServer::setProfile() */
+enum OpcServerProfile {
+   /* the limits of the open62541 default config */
+   ProfileDefault = 0,
+   /* small buffers and queues, few clients served quickly */
+   ProfileLowLatency,
+   /* large buffers and limits, many clients and monitored items */
+   ProfileHighFanOut,
+   /* small buffers and limits, for constrained devices */
+   ProfileLowMemory,
+};
+
 
 namespace n_opcua {
 
+/**
+ * The limits of a server deciding its throughput and memory use, 0 means
+ * unlimited where open62541 allows it
+ */
+struct OpcUAServerLimits {
+   /* bytes of a message chunk sent or received, at least 8192 */
+   uint32_t sendBufferSize;
+   uint32_t recvBufferSize;
+   /* bytes of a whole message and chunks per message */
+   uint32_t maxMessageSize;
+   uint32_t maxChunkCount;
+   uint16_t maxSecureChannels;
+   uint16_t maxSessions;
+   uint32_t maxSubscriptionsPerSession;
+   uint32_t maxMonitoredItemsPerSubscription;
+   uint32_t maxPublishRequestsPerSession;
+   uint32_t maxNotificationsPerPublish;
+   uint32_t maxRetransmissionQueueSize;
+   /* the largest queue of a monitored item */
+   uint32_t maxQueueSize;
+   /* the fastest publishing and sampling intervals in ms */
+   double minPublishingInterval;
+   double minSamplingInterval;
+
+   /**
+    * @brief Return the memory all secure channels may use for their
+    * buffers in bytes
+    */
+   uint64_t bufferMemory() const {
+      return (uint64_t) maxSecureChannels * (sendBufferSize + recvBufferSize);
+   }
+};
+
 class OpcUAServer {
 private:
-   bool running;
+   std::atomic<bool> running;
+   /* advanced before and after each server loop iteration */
+   std::atomic<uint64_t> epoch;
+   /* if run() executes the server loop */
+   std::atomic<bool> looping;
+   /* if each loop iteration is a cycle of OpcUAClock */
+   std::atomic<bool> cachedClock;
+   /* the thread of start(), see stop() */
+   std::thread loopThread;
+   /* a pipe readable while work for the next iterate() is waiting */
+   int wakeFds[2];
+   std::atomic<bool> wakePending;
+   /* worker threads of the open62541 multithreading build, 0 if none */
+   uint16_t threads;
+   /* if the loops of other servers read our nodes, see OpcUAServerGroup */
+   std::atomic<bool> sharedNodes;
+
+   /* the epoch + 1 a worker thread started reading in, 0 if unused */
+   static const unsigned readerSlotCount = 64;
+   std::atomic<uint64_t> readerSlots[readerSlotCount];
+   /* readers finding all slots taken, no epoch passes while there are any */
+   std::atomic<uint32_t> overflowReaders;
+
+   /* held while the server is used outside of its loop: by startup(),
+    * shutdown() and the writes and tasks done at once, recursive as these
+    * may write or run tasks again. Taken before writeLock */
+   std::recursive_mutex serverLock;
+   /* writes waiting for the server loop, see writeValue() */
+   std::mutex writeLock;
+   std::vector<std::pair<UA_NodeId, UA_Variant> > pendingWrites;
+   /* tasks waiting for the server loop, see runInLoop() */
+   std::vector<std::function<void()> > pendingTasks;
    uint16_t port;
    std::string name;
    std::string locale;
@@ -45,9 +128,13 @@ private:
    /* Capabilities */
    std::set<std::string> caps;
 
+   /* the limits of the config as created, see ProfileDefault */
+   OpcUAServerLimits defaultLimits;
+
    /* LDS Registry */
-   std::string _ldsServerURI;
-   UA_Client *ldsRegisterClient;
+   OpcUALDSOptions ldsOptions;
+   OpcUALDSCall ldsCall;
+   OpcUALDSRegistrar *ldsRegistrar;
 
    /**
     * @brief Push the capabilites to the actual config (helper)
@@ -58,6 +145,26 @@ private:
     * @brief Remove the capabilites from the server (helper)
     */
    void removeCapabilites();
+
+   /**
+    * @brief Write the values queued by writeValue() to the server (helper)
+    */
+   void applyPendingWrites();
+
+   /**
+    * @brief Run the tasks queued by runInLoop() (helper)
+    */
+   void applyPendingTasks();
+
+   /**
+    * @brief Make the wakeup file descriptor readable (helper)
+    */
+   void wake();
+
+   /**
+    * @brief Consume the wakeups so far (helper)
+    */
+   void drainWakeups();
 public:
    /**
     * @brief OpcUAServer Default constructor for a new OpcUAServer object
@@ -66,11 +173,11 @@ public:
    OpcUAServer(uint16_t sport = 4840);
    /**
     * @brief OpcUAServer destructor for the Server object, if the server is
-    * running, call terminate() first
+    * running, call terminate() first. A loop of start() is stopped
     */
    virtual ~OpcUAServer();
    /**
-    * @brief Start the server execution
+    * @brief Start the server execution, blocks until terminate() is called
     */
    void run();
    /**
@@ -78,6 +185,170 @@ public:
     */
    void terminate();
 
+   /**
+    * @brief Run the server loop on a thread of its own
+    * @param cpu the CPU to pin the thread to, -1 to let it float
+    * @return true if started, false if already started or there is no
+    * server, see setBaseConfigDone()
+    */
+   bool start(int cpu = -1);
+
+   /**
+    * @brief Terminate the server loop of start() and wait for its thread
+    * @return true if stopped, false if not started
+    */
+   bool stop();
+
+   /**
+    * @brief Check if the server loop of start() runs
+    */
+   bool isStarted() {
+      return loopThread.joinable();
+   }
+
+   /**
+    * @brief Start the server for a loop of the caller, which calls
+    * iterate() until it calls shutdown(). Instead of run()
+    * @return true if started, else false
+    */
+   bool startup();
+
+   /**
+    * @brief Run one iteration of the server loop
+    * @param waitInternal true to wait up to the returned time for network
+    * input, false to only handle what is already there
+    * @return the time in ms until the next timed event of the server
+    *
+    * A caller driving the server from its own event loop waits for
+    * getWakeupFd() with the returned time as timeout. open62541 does not
+    * expose its sockets, so network input is handled at the latest when the
+    * timeout ran out, at most 50 ms later.
+    */
+   uint16_t iterate(bool waitInternal = false);
+
+   /**
+    * @brief Shut down a server started with startup()
+    */
+   void shutdown();
+
+   /**
+    * @brief Return a file descriptor which is readable while work for the
+    * next iterate() is waiting, like values queued by writeValue() from
+    * another thread or terminate(). iterate() empties it
+    * @return the file descriptor, -1 if none could be created
+    */
+   int getWakeupFd() {
+      return wakeFds[0];
+   }
+
+   /**
+    * @brief Return the server loop epoch, it is odd while a loop iteration
+    * runs and even in between
+    * @return the current epoch
+    *
+    * All responses of an iteration are encoded and sent before the epoch
+    * advances, so memory lent to the server (see OpcUABorrowedBuffer) while
+    * the epoch was e is no longer referenced once epochPassed(e) is true.
+    */
+   uint64_t getEpoch() {
+      return epoch.load(std::memory_order_seq_cst);
+   }
+
+   /**
+    * @brief Check if the server may still reference memory it was given up to
+    * a point in time
+    * @param e the epoch at that point in time, see getEpoch()
+    * @return true if the memory is no longer referenced, else false
+    */
+   bool epochPassed(uint64_t e);
+
+   /**
+    * @brief Stamp all values of one server loop iteration with one time,
+    * read when the iteration stamps its first value, after any wait for
+    * network input, see OpcUAClock. Reads on worker threads still read the
+    * clock for every value
+    * @param cached true to read the clock once per iteration, else false
+    */
+   void setCachedClock(bool cached) {
+      cachedClock.store(cached, std::memory_order_relaxed);
+   }
+
+   /**
+    * @brief Check if the clock is read once per server loop iteration
+    */
+   bool isCachedClock() {
+      return cachedClock.load(std::memory_order_relaxed);
+   }
+
+   /**
+    * @brief Set the count of worker threads, needs open62541 built with
+    * UA_ENABLE_MULTITHREADING. Has to be called before setBaseConfigDone()
+    * @param n the thread count, 0 runs single threaded
+    * @return true if set, else false
+    */
+   bool setThreads(uint16_t n);
+
+   /**
+    * @brief Return the count of worker threads
+    */
+   uint16_t getThreads() {
+      return threads;
+   }
+
+   /**
+    * @brief Check if callbacks run on worker threads or on the loops of
+    * other servers, outside of the loop iterations
+    */
+   bool isMultithreaded() {
+      return threads > 0 || sharedNodes.load(std::memory_order_relaxed);
+   }
+
+   /**
+    * @brief Mark the contexts of our nodes as read by the loops of other
+    * servers too, their reads then hold reader slots like worker threads
+    * @param shared true if shared, else false
+    */
+   void setSharedNodes(bool shared) {
+      sharedNodes.store(shared, std::memory_order_relaxed);
+   }
+
+   /**
+    * @brief Mark the calling thread as reading memory covered by
+    * epochPassed(), worker threads have to do this around such reads. Never
+    * waits, with all slots taken the reader holds back every epoch instead
+    * @return the slot to pass to leaveReader()
+    */
+   unsigned enterReader();
+
+   /**
+    * @brief Mark the reading thread as done
+    * @param slot the slot returned by enterReader()
+    */
+   void leaveReader(unsigned slot) {
+      if (slot < readerSlotCount)
+         readerSlots[slot].store(0, std::memory_order_release);
+      else
+         overflowReaders.fetch_sub(1, std::memory_order_release);
+   }
+
+   /**
+    * @brief Write the value of a node, from any thread. While run() executes
+    * the server loop, the write is queued and done between two iterations
+    * @param node the node to write
+    * @param value the value, it is copied
+    * @return true if written or queued, else false
+    */
+   bool writeValue(const UA_NodeId *node, const UA_Variant *value);
+
+   /**
+    * @brief Run a task using the server, from any thread. While the server
+    * loop runs, the task is queued and run between two iterations, else it
+    * runs at once. open62541 is not thread safe, so other threads touch the
+    * server only this way
+    * @param task the task, the loop waits for it
+    */
+   void runInLoop(const std::function<void()> &task);
+
    /**
     * @brief Set server name
     * @param sname the servers name
@@ -105,10 +376,81 @@ public:
    void setRole(const OpcServerRole value);
 
    /**
-    * @brief Reset the config to a basic state
+    * @brief Reset the config to a basic state, this also resets the limits
     * @note Can only be called before executing th run() method
     */
    void resetBaseConfig();
+
+   /**
+    * @brief Return the limits of a preset
+    * @param profile the preset
+    * @return the limits
+    */
+   OpcUAServerLimits getProfileLimits(OpcServerProfile profile);
+
+   /**
+    * @brief Apply the limits of a preset, has to be called before
+    * setBaseConfigDone()
+    * @param profile the preset
+    * @return true if applied, false if the server is already created or
+    * open62541 is built without UA_ENABLE_SUBSCRIPTIONS and the preset
+    * sets subscription limits, the other limits are applied then
+    */
+   bool setProfile(OpcServerProfile profile);
+
+   /**
+    * @brief Set all limits at once, has to be called before
+    * setBaseConfigDone()
+    * @param limits the limits
+    * @return true if set, false if the server is already created or a
+    * buffer is smaller than 8192 bytes
+    */
+   bool setLimits(const OpcUAServerLimits &limits);
+
+   /**
+    * @brief Return the limits of the config
+    */
+   OpcUAServerLimits getLimits();
+
+   /**
+    * @brief Set the chunk size of the network buffers, has to be called
+    * before setBaseConfigDone()
+    * @param sendBufferSize the bytes of a sent chunk, at least 8192
+    * @param recvBufferSize the bytes of a received chunk, at least 8192
+    * @return true if set, else false
+    */
+   bool setBufferSizes(uint32_t sendBufferSize, uint32_t recvBufferSize);
+
+   /**
+    * @brief Set the size of a message, has to be called before
+    * setBaseConfigDone()
+    * @param maxMessageSize the bytes of a message, 0 for unlimited
+    * @param maxChunkCount the chunks of a message, 0 for unlimited
+    * @return true if set, else false
+    */
+   bool setMaxMessageSize(uint32_t maxMessageSize, uint32_t maxChunkCount);
+
+   /**
+    * @brief Set the count of clients, has to be called before
+    * setBaseConfigDone()
+    * @param maxSessions the sessions
+    * @param maxSecureChannels the secure channels
+    * @return true if set, else false
+    */
+   bool setMaxSessions(uint16_t maxSessions, uint16_t maxSecureChannels);
+
+   /**
+    * @brief Set the subscription limits, has to be called before
+    * setBaseConfigDone(). Needs open62541 built with UA_ENABLE_SUBSCRIPTIONS
+    * @param maxSubscriptionsPerSession the subscriptions of a session
+    * @param maxMonitoredItemsPerSubscription the items of a subscription
+    * @param maxPublishRequestsPerSession the queued publish requests of a
+    * session
+    * @return true if set, else false
+    */
+   bool setSubscriptionLimits(uint32_t maxSubscriptionsPerSession,
+                              uint32_t maxMonitoredItemsPerSubscription,
+                              uint32_t maxPublishRequestsPerSession);
    /**
     * Call this after you set base settings for the server and in before you add
     * the server to a OpcUANodeHandler
@@ -151,20 +493,56 @@ public:
    void removeURI();
 
    /**
-    * @brief Register the server at a local discovery service (LDS)
+    * @brief Register the server at a local discovery service (LDS). The
+    * registration is timed by a thread of its own, which hands the requests
+    * to the server loop (see runInLoop()), and is repeated and retried as
+    * set by setLDSOptions(), its course is returned by getLDSStats()
     * @param ldsServerURI the server URI to register at (e.g.
     * "opc.tcp://localhost:4840")
-    * @return true on success, else false
+    * @return true if the registration started, false if there is no server
+    * (see setBaseConfigDone()) or it is already registering
     */
    bool registerAtLDS(std::string ldsServerURI);
 
    /**
     * @brief Unregister the server at a previously registered local discovery
-    *  service (LDS)
+    *  service (LDS). Waits at most for a registration in progress and the
+    *  unregistration, each bounded by OpcUALDSOptions::timeout
     * @return true on success, else false
     */
    bool unregisterAtLDS();
 
+   /**
+    * @brief Set the timing of the registrations of the next registerAtLDS()
+    * @param options the timing
+    * @return true if set, false if a time is 0 or minBackoff exceeds
+    * maxBackoff
+    */
+   bool setLDSOptions(const OpcUALDSOptions &options);
+
+   /**
+    * @brief Return the timing of the registrations
+    */
+   OpcUALDSOptions getLDSOptions() {
+      return ldsOptions;
+   }
+
+   /**
+    * @brief Replace the client connecting to the LDS by a call of our own
+    * for the next registerAtLDS(), e.g. a stand-in LDS for tests
+    * @param call the call, empty to connect to the LDS again
+    */
+   void setLDSCall(const OpcUALDSCall &call) {
+      ldsCall = call;
+   }
+
+   /**
+    * @brief Return the course of the registration at the LDS
+    * @param stats set to the course so far
+    * @return true if set, false if not registering
+    */
+   bool getLDSStats(OpcUALDSStats *stats);
+
    /**
     * @brief Add a new namespace to the server
     * @param ns the name for the new namespace
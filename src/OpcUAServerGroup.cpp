@@ -0,0 +1,70 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include <algorithm>
+#include <thread>
+#include "OpcUAServerGroup.h"
+
+namespace n_opcua {
+
+OpcUAServerGroup::OpcUAServerGroup(size_t count, uint16_t basePort) {
+   count = std::max<size_t>(count, 1);
+   for (size_t i = 0; i < count; i++)
+      shards.push_back(new OpcUAServer(basePort + i));
+}
+
+OpcUAServerGroup::~OpcUAServerGroup() {
+   stop();
+   for (size_t i = 0; i < shards.size(); i++)
+      delete shards[i];
+}
+
+bool OpcUAServerGroup::setProfile(OpcServerProfile profile) {
+   bool applied = true;
+   for (size_t i = 0; i < shards.size(); i++)
+      applied &= shards[i]->setProfile(profile);
+   return applied;
+}
+
+void OpcUAServerGroup::setName(const std::string &name,
+                               const std::string &locale) {
+   for (size_t i = 0; i < shards.size(); i++)
+      shards[i]->setName(name, locale);
+}
+
+void OpcUAServerGroup::setBaseConfigDone() {
+   for (size_t i = 0; i < shards.size(); i++)
+      shards[i]->setBaseConfigDone();
+}
+
+bool OpcUAServerGroup::attach(OpcUANodeHandler *handler) {
+   if (!handler || handler->getServer() != getPrimary())
+      return false;
+
+   for (size_t i = 1; i < shards.size(); i++) {
+      if (!handler->addReplica(shards[i]))
+         return false;
+   }
+   return true;
+}
+
+bool OpcUAServerGroup::start(bool pin) {
+   unsigned cpus = std::max(std::thread::hardware_concurrency(), 1u);
+   bool started = true;
+
+   for (size_t i = 0; i < shards.size(); i++)
+      started &= shards[i]->start(pin ? (int) (i % cpus) : -1);
+   return started;
+}
+
+void OpcUAServerGroup::stop() {
+   for (size_t i = 0; i < shards.size(); i++)
+      shards[i]->stop();
+}
+
+} /* namespace n_opcua */
@@ -0,0 +1,119 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#ifndef SRC_OPCUASERVERGROUP_H_
+#define SRC_OPCUASERVERGROUP_H_
+
+#include <string>
+#include <vector>
+#include "OpcUAServer.h"
+#include "OpcUANodeHandler.h"
+
+namespace n_opcua {
+
+/**
+ * Several servers (shards) on consecutive ports showing the same nodes,
+ * each running its loop on a thread of its own.
+ *
+ * The nodes are defined once, by a OpcUANodeHandler of the first shard (see
+ * attach()). The other shards show the same nodes with the same contexts,
+ * so a published value is seen by all shards without being copied per
+ * shard, and a read callback serves the clients of all shards. Such
+ * callbacks run on the loop threads of all shards concurrently, like on
+ * the worker threads of a multithreaded server.
+ */
+class OpcUAServerGroup {
+private:
+   std::vector<OpcUAServer *> shards;
+
+public:
+   /**
+    * @brief Constructor for a group of servers
+    * @param count the count of shards, at least 1
+    * @param basePort the port of the first shard, shard i listens on
+    * basePort + i
+    */
+   OpcUAServerGroup(size_t count, uint16_t basePort = 4840);
+
+   /**
+    * @brief Stop and delete all shards
+    */
+   virtual ~OpcUAServerGroup();
+
+   OpcUAServerGroup(const OpcUAServerGroup &) = delete;
+   OpcUAServerGroup &operator=(const OpcUAServerGroup &) = delete;
+
+   /**
+    * @brief Return the count of shards
+    */
+   size_t size() {
+      return shards.size();
+   }
+
+   /**
+    * @brief Return a shard, e.g. to configure it before setBaseConfigDone()
+    * @param i the index of the shard
+    * @return the shard, nullptr if there is no such shard
+    */
+   OpcUAServer *getShard(size_t i) {
+      return i < shards.size() ? shards[i] : nullptr;
+   }
+
+   /**
+    * @brief Return the first shard, the server of the node handler
+    */
+   OpcUAServer *getPrimary() {
+      return shards[0];
+   }
+
+   /**
+    * @brief Apply a preset of limits to all shards
+    * @param profile the preset
+    * @return true if applied to all, else false
+    */
+   bool setProfile(OpcServerProfile profile);
+
+   /**
+    * @brief Set the name of all shards
+    * @param name the server name
+    * @param locale the language of the name
+    */
+   void setName(const std::string &name, const std::string &locale = "en-US");
+
+   /**
+    * @brief Create the servers of all shards, see
+    * OpcUAServer::setBaseConfigDone()
+    */
+   void setBaseConfigDone();
+
+   /**
+    * @brief Let a node handler of the first shard define the nodes of all
+    * shards, has to be called before it adds nodes to the server. The group
+    * has to outlive the handler
+    * @param handler the handler, using getPrimary() as server
+    * @return true if attached, else false
+    */
+   bool attach(OpcUANodeHandler *handler);
+
+   /**
+    * @brief Run the loops of all shards
+    * @param pin true to pin the loop of shard i to CPU i modulo the CPU
+    * count, else false
+    * @return true if all started, else false
+    */
+   bool start(bool pin = true);
+
+   /**
+    * @brief Stop the loops of all shards
+    */
+   void stop();
+};
+
+} /* namespace n_opcua */
+
+#endif /* SRC_OPCUASERVERGROUP_H_ */
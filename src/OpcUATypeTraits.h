@@ -0,0 +1,104 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#ifndef SRC_OPCUATYPETRAITS_H_
+#define SRC_OPCUATYPETRAITS_H_
+
+#include <string>
+#include <cstdint>
+#include <type_traits>
+#include "OpcUAServer.h"
+
+namespace n_opcua {
+
+/**
+ * Compile time mapping of a C++ type to its open62541 representation.
+ *
+ * UaTypeTraits<T>::typeIndex is the UA_TYPES_* index of T and
+ * UaTypeTraits<T>::dataType() the matching UA_DataType. Using a type without
+ * an open62541 representation fails to compile.
+ *
+ * New types have to be added here, as well as the corresponding conversions
+ * in OpcUANodeContext!
+ */
+template <typename T, typename Enable = void>
+struct UaTypeTraits {
+   static_assert(sizeof(T) == 0,
+                 "This type has no open62541 representation, see UaTypeTraits");
+};
+
+template <int16_t TypeIndex>
+struct UaTypeTraitsBase {
+   /* the UA_TYPES_* index of the type */
+   static constexpr int16_t typeIndex = TypeIndex;
+
+   /**
+    * @brief Return the open62541 data type
+    * @return the entry of UA_TYPES for the type
+    */
+   static constexpr const UA_DataType *dataType() {
+      return &UA_TYPES[TypeIndex];
+   }
+};
+
+template <int16_t TypeIndex>
+constexpr int16_t UaTypeTraitsBase<TypeIndex>::typeIndex;
+
+/* integers are matched by size and signedness, so e.g. int, int32_t and
+ * long (on 32 bit) all resolve to the same type */
+template <size_t Size, bool Signed>
+struct UaIntegerTypeIndex;
+
+template <> struct UaIntegerTypeIndex<1, true>
+{ static constexpr int16_t value = UA_TYPES_SBYTE; };
+template <> struct UaIntegerTypeIndex<1, false>
+{ static constexpr int16_t value = UA_TYPES_BYTE; };
+template <> struct UaIntegerTypeIndex<2, true>
+{ static constexpr int16_t value = UA_TYPES_INT16; };
+template <> struct UaIntegerTypeIndex<2, false>
+{ static constexpr int16_t value = UA_TYPES_UINT16; };
+template <> struct UaIntegerTypeIndex<4, true>
+{ static constexpr int16_t value = UA_TYPES_INT32; };
+template <> struct UaIntegerTypeIndex<4, false>
+{ static constexpr int16_t value = UA_TYPES_UINT32; };
+template <> struct UaIntegerTypeIndex<8, true>
+{ static constexpr int16_t value = UA_TYPES_INT64; };
+template <> struct UaIntegerTypeIndex<8, false>
+{ static constexpr int16_t value = UA_TYPES_UINT64; };
+
+template <typename T>
+struct UaTypeTraits<T, typename std::enable_if<
+      std::is_integral<T>::value &&
+      !std::is_same<T, bool>::value &&
+      !std::is_same<T, char>::value>::type>:
+   UaTypeTraitsBase<UaIntegerTypeIndex<sizeof(T),
+                                       std::is_signed<T>::value>::value> {};
+
+/* bool */
+template <> struct UaTypeTraits<bool>:
+   UaTypeTraitsBase<UA_TYPES_BOOLEAN> {};
+/* plain char is used for raw bytes */
+template <> struct UaTypeTraits<char>:
+   UaTypeTraitsBase<UA_TYPES_BYTE> {};
+/* float */
+template <> struct UaTypeTraits<float>:
+   UaTypeTraitsBase<UA_TYPES_FLOAT> {};
+/* double */
+template <> struct UaTypeTraits<double>:
+   UaTypeTraitsBase<UA_TYPES_DOUBLE> {};
+/* strings */
+template <> struct UaTypeTraits<std::string>:
+   UaTypeTraitsBase<UA_TYPES_STRING> {};
+template <> struct UaTypeTraits<char *>:
+   UaTypeTraitsBase<UA_TYPES_STRING> {};
+template <> struct UaTypeTraits<const char *>:
+   UaTypeTraitsBase<UA_TYPES_STRING> {};
+
+} /* namespace n_opcua */
+
+#endif /* SRC_OPCUATYPETRAITS_H_ */
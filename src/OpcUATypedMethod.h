@@ -0,0 +1,467 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#ifndef SRC_OPCUATYPEDMETHOD_H_
+#define SRC_OPCUATYPEDMETHOD_H_
+
+#include <tuple>
+#include <string>
+#include <vector>
+#include <type_traits>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+#include "OpcUATypedVar.h"
+
+namespace n_opcua {
+
+/**
+ * Read only view of a string argument of a method call, pointing into the
+ * request of the server. It is only valid during the call.
+ */
+struct OpcUAStringRef {
+   const char *data;
+   size_t length;
+
+   OpcUAStringRef(): data(nullptr), length(0) {}
+
+   size_t size() const {
+      return length;
+   }
+
+   bool empty() const {
+      return length == 0;
+   }
+
+   /**
+    * @brief Return a copy of the string
+    */
+   std::string str() const {
+      return length ? std::string(data, length) : std::string();
+   }
+};
+
+/**
+ * Read only view of an array argument of a method call, pointing into the
+ * request of the server. It is only valid during the call.
+ */
+template <typename T>
+struct OpcUAArrayRef {
+   const T *data;
+   size_t length;
+
+   OpcUAArrayRef(): data(nullptr), length(0) {}
+
+   const T *begin() const {
+      return data;
+   }
+
+   const T *end() const {
+      return data + length;
+   }
+
+   size_t size() const {
+      return length;
+   }
+
+   bool empty() const {
+      return length == 0;
+   }
+
+   const T &operator[](size_t i) const {
+      return data[i];
+   }
+};
+
+/* std::index_sequence is C++14 */
+template <size_t... I>
+struct UaIndexSequence {};
+
+template <size_t N, size_t... I>
+struct UaMakeIndexSequence: UaMakeIndexSequence<N - 1, N - 1, I...> {};
+
+template <size_t... I>
+struct UaMakeIndexSequence<0, I...> {
+   typedef UaIndexSequence<I...> type;
+};
+
+/**
+ * @brief Point at the bytes of a string argument without copying them
+ * @return UA_STATUSCODE_GOOD or UA_STATUSCODE_BADTYPEMISMATCH
+ */
+inline UA_StatusCode decodeStringArgument(const UA_Variant *in,
+                                          const char **data, size_t *length) {
+   if (in->type != &UA_TYPES[UA_TYPES_STRING] || !UA_Variant_isScalar(in))
+      return UA_STATUSCODE_BADTYPEMISMATCH;
+
+   const UA_String *s = static_cast<const UA_String *>(in->data);
+   *data = reinterpret_cast<const char *>(s->data);
+   *length = s->length;
+   return UA_STATUSCODE_GOOD;
+}
+
+/**
+ * @brief Point at the elements of an array argument without copying them
+ * @return UA_STATUSCODE_GOOD or UA_STATUSCODE_BADTYPEMISMATCH
+ */
+template <typename E>
+UA_StatusCode decodeArrayArgument(const UA_Variant *in, const E **data,
+                                  size_t *length) {
+   if (in->type != UaTypeTraits<E>::dataType() || UA_Variant_isScalar(in))
+      return UA_STATUSCODE_BADTYPEMISMATCH;
+
+   *length = in->arrayLength;
+   /* empty arrays point at UA_EMPTY_ARRAY_SENTINEL */
+   *data = *length ? static_cast<const E *>(in->data) : nullptr;
+   return UA_STATUSCODE_GOOD;
+}
+
+/**
+ * Compile time decoding of a method input argument, used by OpcUATypedMethod.
+ *
+ * Every specialization provides the UA_TYPES index and value rank of the
+ * argument and decode() checking the type of a Variant and unpacking it.
+ * Numbers, bool, OpcUAStringRef and OpcUAArrayRef (std::string_view and
+ * std::span with C++17/20) are decoded without heap allocation, while
+ * std::string and std::vector arguments are copies.
+ */
+template <typename T, typename Enable = void>
+struct UaMethodArgument {
+   static_assert(sizeof(T) == 0,
+                 "This type can not be a method argument, see UaMethodArgument");
+};
+
+/* numbers and bool */
+template <typename T>
+struct UaMethodArgument<T, typename std::enable_if<
+      std::is_arithmetic<T>::value>::type> {
+   static constexpr int16_t typeIndex = UaTypeTraits<T>::typeIndex;
+   static constexpr int32_t valueRank = UA_VALUERANK_SCALAR;
+
+   static UA_StatusCode decode(const UA_Variant *in, T *value) {
+      if (in->type != UaTypeTraits<T>::dataType() || !UA_Variant_isScalar(in))
+         return UA_STATUSCODE_BADTYPEMISMATCH;
+
+      *value = *static_cast<const T *>(in->data);
+      return UA_STATUSCODE_GOOD;
+   }
+};
+
+/* strings */
+template <>
+struct UaMethodArgument<OpcUAStringRef> {
+   static constexpr int16_t typeIndex = UA_TYPES_STRING;
+   static constexpr int32_t valueRank = UA_VALUERANK_SCALAR;
+
+   static UA_StatusCode decode(const UA_Variant *in, OpcUAStringRef *value) {
+      return decodeStringArgument(in, &value->data, &value->length);
+   }
+};
+
+template <>
+struct UaMethodArgument<std::string> {
+   static constexpr int16_t typeIndex = UA_TYPES_STRING;
+   static constexpr int32_t valueRank = UA_VALUERANK_SCALAR;
+
+   static UA_StatusCode decode(const UA_Variant *in, std::string *value) {
+      const char *data;
+      size_t length;
+      UA_StatusCode retval = decodeStringArgument(in, &data, &length);
+      if (retval == UA_STATUSCODE_GOOD && length > 0)
+         value->assign(data, length);
+      return retval;
+   }
+};
+
+#if __cplusplus >= 201703L
+template <>
+struct UaMethodArgument<std::string_view> {
+   static constexpr int16_t typeIndex = UA_TYPES_STRING;
+   static constexpr int32_t valueRank = UA_VALUERANK_SCALAR;
+
+   static UA_StatusCode decode(const UA_Variant *in, std::string_view *value) {
+      const char *data;
+      size_t length;
+      UA_StatusCode retval = decodeStringArgument(in, &data, &length);
+      if (retval == UA_STATUSCODE_GOOD && length > 0)
+         *value = std::string_view(data, length);
+      return retval;
+   }
+};
+#endif
+
+/* one dimensional arrays of numbers */
+template <typename E>
+struct UaMethodArgument<OpcUAArrayRef<E> > {
+   static constexpr int16_t typeIndex = UaTypeTraits<E>::typeIndex;
+   static constexpr int32_t valueRank = UA_VALUERANK_ONE_DIMENSION;
+
+   static UA_StatusCode decode(const UA_Variant *in, OpcUAArrayRef<E> *value) {
+      return decodeArrayArgument(in, &value->data, &value->length);
+   }
+};
+
+template <typename E>
+struct UaMethodArgument<std::vector<E> > {
+   static_assert(std::is_arithmetic<E>::value && !std::is_same<E, bool>::value,
+                 "Only vectors of numbers can be method arguments");
+
+   static constexpr int16_t typeIndex = UaTypeTraits<E>::typeIndex;
+   static constexpr int32_t valueRank = UA_VALUERANK_ONE_DIMENSION;
+
+   static UA_StatusCode decode(const UA_Variant *in, std::vector<E> *value) {
+      const E *data;
+      size_t length;
+      UA_StatusCode retval = decodeArrayArgument(in, &data, &length);
+      if (retval == UA_STATUSCODE_GOOD)
+         value->assign(data, data + length);
+      return retval;
+   }
+};
+
+#if __cplusplus >= 202002L
+template <typename E>
+struct UaMethodArgument<std::span<const E> > {
+   static constexpr int16_t typeIndex = UaTypeTraits<E>::typeIndex;
+   static constexpr int32_t valueRank = UA_VALUERANK_ONE_DIMENSION;
+
+   static UA_StatusCode decode(const UA_Variant *in, std::span<const E> *value) {
+      const E *data;
+      size_t length;
+      UA_StatusCode retval = decodeArrayArgument(in, &data, &length);
+      if (retval == UA_STATUSCODE_GOOD)
+         *value = std::span<const E>(data, length);
+      return retval;
+   }
+};
+#endif
+
+/**
+ * Compile time encoding of the result of a method, as its only output
+ * argument, through UaTypedBinding
+ */
+template <typename R>
+struct UaMethodResult {
+   typedef typename std::decay<R>::type Value;
+   static constexpr size_t count = 1;
+
+   template <typename F, typename... A>
+   static UA_StatusCode call(F &fn, UA_Variant *output, A &... args) {
+      return UaTypedBinding<Value>::read(fn(args...), output, nullptr);
+   }
+};
+
+template <>
+struct UaMethodResult<void> {
+   static constexpr size_t count = 0;
+
+   template <typename F, typename... A>
+   static UA_StatusCode call(F &fn, UA_Variant *output, A &... args) {
+      fn(args...);
+      return UA_STATUSCODE_GOOD;
+   }
+};
+
+/**
+ * Result and argument types of a function, function pointer, lambda or
+ * other callable object with a single operator()
+ */
+template <typename F>
+struct UaCallableTraits: UaCallableTraits<decltype(&F::operator())> {};
+
+template <typename R, typename... A>
+struct UaCallableTraits<R (*)(A...)> {
+   typedef R Result;
+   typedef std::tuple<typename std::decay<A>::type...> Arguments;
+};
+
+template <typename C, typename R, typename... A>
+struct UaCallableTraits<R (C::*)(A...)>: UaCallableTraits<R (*)(A...)> {};
+
+template <typename C, typename R, typename... A>
+struct UaCallableTraits<R (C::*)(A...) const>:
+   UaCallableTraits<R (*)(A...)> {};
+
+/**
+ * Method calling an ordinary C++ callable.
+ *
+ * The input and output arguments of the node are set up from the signature
+ * of the callable, e.g. double(int32_t, OpcUAStringRef, OpcUAArrayRef<float>)
+ * becomes a method with an Int32, a String and a Float array input and a
+ * Double output. The server calls a static callback generated for F, which
+ * checks the types of the inputs and unpacks them straight into the
+ * arguments of the callable, without the std::function callbacks of
+ * OpcUAMethodNodeContext. The result is written to the first output
+ * argument. See UaMethodArgument for the possible argument types and
+ * UaTypedBinding for the possible results.
+ *
+ * Names of the arguments may be set with setInputArgumentName() and
+ * setOutputArgumentName(). Use newTypedMethod() to create one for a lambda.
+ */
+template <typename F>
+class OpcUATypedMethod: public OpcUAMethodNodeContext {
+private:
+   typedef UaCallableTraits<F> Traits;
+   typedef typename Traits::Result Result;
+   typedef typename Traits::Arguments Arguments;
+   typedef typename UaMakeIndexSequence<
+         std::tuple_size<Arguments>::value>::type Indices;
+
+   /**
+    * @brief The called function
+    */
+   F fn;
+
+   /**
+    * @brief Set the type of an argument description
+    */
+   static void setArgumentType(UA_Argument *arg, int16_t typeIndex,
+                               int32_t valueRank, UA_UInt32 length) {
+      arg->dataType = UA_TYPES[typeIndex].typeId;
+      arg->valueRank = valueRank;
+      if (length > 0) {
+         arg->arrayDimensions = static_cast<UA_UInt32 *>(
+               UA_Array_new(1, &UA_TYPES[UA_TYPES_UINT32]));
+         if (arg->arrayDimensions) {
+            arg->arrayDimensions[0] = length;
+            arg->arrayDimensionsSize = 1;
+         }
+      }
+   }
+
+   template <size_t... I>
+   void initArgumentTypes(UaIndexSequence<I...>) {
+      initInputArguments(sizeof...(I));
+      UA_Argument *args = getInputArguments();
+      int expand[] = {0, (setArgumentType(&args[I],
+            UaMethodArgument<typename std::tuple_element<I, Arguments>::type>
+               ::typeIndex,
+            UaMethodArgument<typename std::tuple_element<I, Arguments>::type>
+               ::valueRank, 0), 0)...};
+      (void) args;
+      (void) expand;
+   }
+
+   template <typename R>
+   void initResultType(R *) {
+      typedef UaTypedBinding<typename std::decay<R>::type> Binding;
+      initOutputArguments(1);
+      setArgumentType(getOutputArguments(), Binding::typeIndex,
+                      Binding::valueRank, Binding::length);
+   }
+
+   void initResultType(void *) {
+      initOutputArguments(0);
+   }
+
+   template <size_t... I>
+   static UA_StatusCode invoke(OpcUATypedMethod *method,
+                               const UA_Variant *input, UA_Variant *output,
+                               UaIndexSequence<I...>) {
+      Arguments args;
+      UA_StatusCode codes[] = {UA_STATUSCODE_GOOD,
+            UaMethodArgument<typename std::tuple_element<I, Arguments>::type>
+               ::decode(&input[I], &std::get<I>(args))...};
+      for (UA_StatusCode code : codes) {
+         if (code != UA_STATUSCODE_GOOD)
+            return code;
+      }
+      (void) input;
+      return UaMethodResult<Result>::call(method->fn, output,
+                                          std::get<I>(args)...);
+   }
+
+   static UA_StatusCode dispatch(OpcUATypedMethod *method, size_t inputSize,
+                                 const UA_Variant *input, size_t outputSize,
+                                 UA_Variant *output) {
+      if (inputSize < std::tuple_size<Arguments>::value)
+         return UA_STATUSCODE_BADARGUMENTSMISSING;
+      if (inputSize > std::tuple_size<Arguments>::value)
+         return UA_STATUSCODE_BADTOOMANYARGUMENTS;
+      if (outputSize < UaMethodResult<Result>::count)
+         return UA_STATUSCODE_BADINVALIDARGUMENT;
+      return invoke(method, input, output, Indices());
+   }
+
+   static UA_StatusCode callMethod(UA_Server * /* server */,
+                                   const UA_NodeId * /* sessionId */,
+                                   void * /* sessionContext */,
+                                   const UA_NodeId * /* methodId */,
+                                   void *methodContext,
+                                   const UA_NodeId * /* objectId */,
+                                   void * /* objectContext */,
+                                   size_t inputSize,
+                                   const UA_Variant *input, size_t outputSize,
+                                   UA_Variant *output) {
+      OpcUATypedMethod *method = static_cast<OpcUATypedMethod *>(
+            static_cast<OpcUAMethodNodeContext *>(methodContext));
+      OpcUANodeStats *stats = method->getStats();
+
+      if (!stats)
+         return dispatch(method, inputSize, input, outputSize, output);
+
+      uint64_t start = OpcUACallStats::start();
+      UA_StatusCode retval = dispatch(method, inputSize, input, outputSize,
+                                      output);
+      stats->call.record(start, retval == UA_STATUSCODE_GOOD);
+      return retval;
+   }
+
+public:
+   /**
+    * @brief Constructor for this class
+    * @param node A preinitialized node
+    * @param nodeHandler The nodeHandler this node will be handled
+    * @param function The function called by the method
+    */
+   OpcUATypedMethod(UA_NodeId *node, OpcUANodeHandler *nodeHandler,
+                    F function):
+      OpcUAMethodNodeContext(node, nodeHandler), fn(function) {
+      initArgumentTypes(Indices());
+      initResultType(static_cast<Result *>(nullptr));
+   }
+
+   /**
+    * @brief Constructor for this class
+    * @param nodeHandler The nodeHandler this node will be handled
+    * @param function The function called by the method
+    */
+   OpcUATypedMethod(OpcUANodeHandler *nodeHandler, F function):
+      OpcUAMethodNodeContext(nodeHandler), fn(function) {
+      initArgumentTypes(Indices());
+      initResultType(static_cast<Result *>(nullptr));
+   }
+
+   /**
+    * @brief Return the callback calling the function
+    * @return The callback
+    */
+   UA_MethodCallback getMethodCallback() {
+      return callMethod;
+   }
+};
+
+/**
+ * @brief Create a typed method for a callable, e.g. a lambda whose type can
+ * not be named
+ * @param nodeHandler The nodeHandler the node will be handled
+ * @param function The function called by the method
+ * @return The new method, owned by the node handler
+ */
+template <typename F>
+OpcUATypedMethod<F> *newTypedMethod(OpcUANodeHandler *nodeHandler,
+                                    F function) {
+   return new (nodeHandler) OpcUATypedMethod<F>(nodeHandler, function);
+}
+
+} /* namespace n_opcua */
+
+#endif /* SRC_OPCUATYPEDMETHOD_H_ */
@@ -0,0 +1,415 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#ifndef SRC_OPCUATYPEDVAR_H_
+#define SRC_OPCUATYPEDVAR_H_
+
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <type_traits>
+#include "OpcUANodeContext.h"
+#include "OpcUANodeStats.h"
+
+namespace n_opcua {
+
+/**
+ * @brief Resolve a one dimensional index range against an array length, see
+ * resolveNumericRange()
+ * @param range the range, nullptr for the whole array
+ * @param length the element count of the array
+ * @param begin the returned first index
+ * @param count the returned element count
+ * @return UA_STATUSCODE_GOOD or the error of the range
+ */
+inline UA_StatusCode resolveTypedRange(const UA_NumericRange *range,
+                                       size_t length, size_t *begin,
+                                       size_t *count) {
+   UA_UInt32 dims = static_cast<UA_UInt32>(length);
+   return resolveNumericRange(range, &dims, 1, begin, count);
+}
+
+/**
+ * Compile time conversion between a bound C++ object and a open62541 Variant,
+ * used by OpcUATypedVar.
+ *
+ * Every binding provides the UA_TYPES index, value rank and fixed array
+ * length of its type, and read()/write() copying between the object and a
+ * Variant. Binding a type without a specialization fails to compile.
+ */
+template <typename T, typename Enable = void>
+struct UaTypedBinding {
+   static_assert(sizeof(T) == 0,
+                 "This type can not be bound to a variable, see UaTypedBinding");
+};
+
+/* numbers and bool */
+template <typename T>
+struct UaTypedBinding<T, typename std::enable_if<
+      std::is_arithmetic<T>::value>::type> {
+   static constexpr int16_t typeIndex = UaTypeTraits<T>::typeIndex;
+   static constexpr int32_t valueRank = UA_VALUERANK_SCALAR;
+   static constexpr UA_UInt32 length = 0;
+
+   static UA_StatusCode read(const T &obj, UA_Variant *out,
+                             const UA_NumericRange *range) {
+      if (range)
+         return UA_STATUSCODE_BADINDEXRANGEINVALID;
+
+      T *p = static_cast<T *>(UA_new(UaTypeTraits<T>::dataType()));
+      if (!p)
+         return UA_STATUSCODE_BADOUTOFMEMORY;
+      *p = obj;
+      UA_Variant_setScalar(out, p, UaTypeTraits<T>::dataType());
+      return UA_STATUSCODE_GOOD;
+   }
+
+   static UA_StatusCode write(T &obj, const UA_Variant *in,
+                              const UA_NumericRange *range) {
+      if (range)
+         return UA_STATUSCODE_BADINDEXRANGEINVALID;
+      if (in->type != UaTypeTraits<T>::dataType() || !UA_Variant_isScalar(in))
+         return UA_STATUSCODE_BADTYPEMISMATCH;
+
+      obj = *static_cast<const T *>(in->data);
+      return UA_STATUSCODE_GOOD;
+   }
+};
+
+/* std::string as UA_String */
+template <>
+struct UaTypedBinding<std::string> {
+   static constexpr int16_t typeIndex = UA_TYPES_STRING;
+   static constexpr int32_t valueRank = UA_VALUERANK_SCALAR;
+   static constexpr UA_UInt32 length = 0;
+
+   static UA_StatusCode read(const std::string &obj, UA_Variant *out,
+                             const UA_NumericRange *range) {
+      if (range)
+         return UA_STATUSCODE_BADINDEXRANGEINVALID;
+
+      const UA_DataType *type = &UA_TYPES[UA_TYPES_STRING];
+      UA_String *s = static_cast<UA_String *>(UA_new(type));
+      if (!s)
+         return UA_STATUSCODE_BADOUTOFMEMORY;
+      if (!obj.empty()) {
+         s->data = static_cast<UA_Byte *>(
+               UA_Array_new(obj.size(), &UA_TYPES[UA_TYPES_BYTE]));
+         if (!s->data) {
+            UA_delete(s, type);
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+         }
+         memcpy(s->data, obj.data(), obj.size());
+         s->length = obj.size();
+      }
+      UA_Variant_setScalar(out, s, type);
+      return UA_STATUSCODE_GOOD;
+   }
+
+   static UA_StatusCode write(std::string &obj, const UA_Variant *in,
+                              const UA_NumericRange *range) {
+      if (range)
+         return UA_STATUSCODE_BADINDEXRANGEINVALID;
+      if (in->type != &UA_TYPES[UA_TYPES_STRING] || !UA_Variant_isScalar(in))
+         return UA_STATUSCODE_BADTYPEMISMATCH;
+
+      const UA_String *s = static_cast<const UA_String *>(in->data);
+      if (s->length > 0)
+         obj.assign(reinterpret_cast<const char *>(s->data), s->length);
+      else
+         obj.clear();
+      return UA_STATUSCODE_GOOD;
+   }
+};
+
+/* std::atomic of a number, loaded and stored as a whole */
+template <typename T>
+struct UaTypedBinding<std::atomic<T> > {
+   static_assert(std::is_arithmetic<T>::value,
+                 "Only atomic numbers can be bound to a variable");
+
+   static constexpr int16_t typeIndex = UaTypedBinding<T>::typeIndex;
+   static constexpr int32_t valueRank = UA_VALUERANK_SCALAR;
+   static constexpr UA_UInt32 length = 0;
+
+   static UA_StatusCode read(const std::atomic<T> &obj, UA_Variant *out,
+                             const UA_NumericRange *range) {
+      return UaTypedBinding<T>::read(obj.load(std::memory_order_acquire), out,
+                                     range);
+   }
+
+   static UA_StatusCode write(std::atomic<T> &obj, const UA_Variant *in,
+                              const UA_NumericRange *range) {
+      T value;
+      UA_StatusCode retval = UaTypedBinding<T>::write(value, in, range);
+      if (retval == UA_STATUSCODE_GOOD)
+         obj.store(value, std::memory_order_release);
+      return retval;
+   }
+};
+
+/**
+ * Copies of one dimensional arrays of numbers, which share their memory
+ * layout with open62541 and are copied as a whole
+ */
+template <typename E>
+struct UaTypedArrayBinding {
+   static_assert(std::is_arithmetic<E>::value,
+                 "Only arrays of numbers can be bound to a variable");
+
+   static constexpr int16_t typeIndex = UaTypeTraits<E>::typeIndex;
+   static constexpr int32_t valueRank = UA_VALUERANK_ONE_DIMENSION;
+
+   static UA_StatusCode readArray(const E *data, size_t length,
+                                  UA_Variant *out,
+                                  const UA_NumericRange *range) {
+      size_t begin, count;
+      UA_StatusCode retval = resolveTypedRange(range, length, &begin, &count);
+      if (retval != UA_STATUSCODE_GOOD)
+         return retval;
+
+      const UA_DataType *type = UaTypeTraits<E>::dataType();
+      E *arr = static_cast<E *>(UA_Array_new(count, type));
+      if (!arr)
+         return UA_STATUSCODE_BADOUTOFMEMORY;
+      if (count > 0)
+         memcpy(arr, data + begin, count * sizeof(E));
+      UA_Variant_setArray(out, arr, count, type);
+      return UA_STATUSCODE_GOOD;
+   }
+
+   /* write into an array of a given length, the value has to fill the whole
+    * array or range */
+   static UA_StatusCode writeArray(E *data, size_t length,
+                                   const UA_Variant *in,
+                                   const UA_NumericRange *range) {
+      if (in->type != UaTypeTraits<E>::dataType() || UA_Variant_isScalar(in))
+         return UA_STATUSCODE_BADTYPEMISMATCH;
+
+      size_t begin, count;
+      UA_StatusCode retval = resolveTypedRange(range, length, &begin, &count);
+      if (retval != UA_STATUSCODE_GOOD)
+         return retval;
+      if (in->arrayLength != count)
+         return range ? UA_STATUSCODE_BADINDEXRANGEINVALID :
+                        UA_STATUSCODE_BADTYPEMISMATCH;
+
+      if (count > 0)
+         memcpy(data + begin, in->data, count * sizeof(E));
+      return UA_STATUSCODE_GOOD;
+   }
+};
+
+/* std::array, of a fixed length */
+template <typename E, size_t N>
+struct UaTypedBinding<std::array<E, N> >: UaTypedArrayBinding<E> {
+   static constexpr UA_UInt32 length = N;
+
+   static UA_StatusCode read(const std::array<E, N> &obj, UA_Variant *out,
+                             const UA_NumericRange *range) {
+      return UaTypedArrayBinding<E>::readArray(obj.data(), N, out, range);
+   }
+
+   static UA_StatusCode write(std::array<E, N> &obj, const UA_Variant *in,
+                              const UA_NumericRange *range) {
+      return UaTypedArrayBinding<E>::writeArray(obj.data(), N, in, range);
+   }
+};
+
+/* std::vector, resized by writes of the whole array */
+template <typename E>
+struct UaTypedBinding<std::vector<E> >: UaTypedArrayBinding<E> {
+   static_assert(!std::is_same<E, bool>::value,
+                 "std::vector<bool> does not store its elements as an array");
+
+   static constexpr UA_UInt32 length = 0;
+
+   static UA_StatusCode read(const std::vector<E> &obj, UA_Variant *out,
+                             const UA_NumericRange *range) {
+      return UaTypedArrayBinding<E>::readArray(obj.data(), obj.size(), out,
+                                               range);
+   }
+
+   static UA_StatusCode write(std::vector<E> &obj, const UA_Variant *in,
+                              const UA_NumericRange *range) {
+      if (!range && in->type == UaTypeTraits<E>::dataType() &&
+          !UA_Variant_isScalar(in))
+         obj.resize(in->arrayLength);
+      return UaTypedArrayBinding<E>::writeArray(obj.data(), obj.size(), in,
+                                                range);
+   }
+};
+
+/**
+ * Variable bound directly to a C++ object.
+ *
+ * Reads and writes of the server copy from and to the bound object through
+ * static UA_DataSource functions generated for T, without the std::function
+ * callbacks of OpcUAVarNodeContext and without looking up the type of the
+ * value at runtime. Data type, value rank and array dimensions of the node
+ * are set from T. T may be a number, bool, std::string, std::atomic of a
+ * number, or a std::array or std::vector of numbers. A const T makes the
+ * variable read only.
+ *
+ * The published value cache, the read/write callbacks and the change filter
+ * do not apply to these variables, the server always sees the object itself.
+ * With a multithreaded server (OpcUAServer::setThreads()) the object is read
+ * from the worker threads, so bind a std::atomic if it changes while the
+ * server runs.
+ */
+template <typename T>
+class OpcUATypedVar: public OpcUAVarNodeContext {
+private:
+   typedef typename std::remove_const<T>::type Value;
+   typedef UaTypedBinding<Value> Binding;
+
+   /**
+    * @brief The bound object
+    */
+   T *target;
+
+   /**
+    * @brief The array dimension attribute of array bindings
+    */
+   UA_UInt32 arrayDimension;
+
+   /**
+    * @brief Set the attributes of the node from the binding
+    */
+   void bindAttributes() {
+      setDataTypeNumber(Binding::typeIndex);
+
+      UA_VariableAttributes *attr = getVariableAttr();
+      attr->valueRank = Binding::valueRank;
+      if (Binding::valueRank == UA_VALUERANK_ONE_DIMENSION) {
+         /* 0 for arrays of variable length */
+         arrayDimension = Binding::length;
+         attr->arrayDimensions = &arrayDimension;
+         attr->arrayDimensionsSize = 1;
+      }
+
+      setReadable(true);
+      setWriteable(!std::is_const<T>::value);
+   }
+
+   static UA_StatusCode readObject(OpcUATypedVar *var,
+                                   UA_Boolean includeSourceTimeStamp,
+                                   const UA_NumericRange *range,
+                                   UA_DataValue *value) {
+      UA_StatusCode retval = Binding::read(*var->target, &value->value, range);
+      if (retval != UA_STATUSCODE_GOOD)
+         return retval;
+
+      value->hasValue = true;
+      if (includeSourceTimeStamp) {
+         value->sourceTimestamp = OpcUAClock::cycleNow();
+         value->hasSourceTimestamp = true;
+      }
+      return UA_STATUSCODE_GOOD;
+   }
+
+   static UA_StatusCode writeObject(OpcUATypedVar *var,
+                                    const UA_NumericRange *range,
+                                    const UA_DataValue *value) {
+      if (std::is_const<T>::value)
+         return UA_STATUSCODE_BADNOTWRITABLE;
+      if (!value->hasValue)
+         return UA_STATUSCODE_BADTYPEMISMATCH;
+      return Binding::write(*const_cast<Value *>(var->target), &value->value,
+                            range);
+   }
+
+   static UA_StatusCode readSource(UA_Server * /* server */,
+                                   const UA_NodeId * /* sessionId */,
+                                   void * /* sessionContext */,
+                                   const UA_NodeId * /* nodeId */,
+                                   void *nodeContext,
+                                   UA_Boolean includeSourceTimeStamp,
+                                   const UA_NumericRange *range,
+                                   UA_DataValue *value) {
+      OpcUATypedVar *var = static_cast<OpcUATypedVar *>(
+            static_cast<OpcUAVarNodeContext *>(nodeContext));
+      OpcUANodeStats *stats = var->getStats();
+
+      if (!stats)
+         return readObject(var, includeSourceTimeStamp, range, value);
+
+      uint64_t start = OpcUACallStats::start();
+      UA_StatusCode retval = readObject(var, includeSourceTimeStamp, range,
+                                        value);
+      stats->read.record(start, retval == UA_STATUSCODE_GOOD);
+      return retval;
+   }
+
+   static UA_StatusCode writeSource(UA_Server * /* server */,
+                                    const UA_NodeId * /* sessionId */,
+                                    void * /* sessionContext */,
+                                    const UA_NodeId * /* nodeId */,
+                                    void *nodeContext,
+                                    const UA_NumericRange *range,
+                                    const UA_DataValue *value) {
+      OpcUATypedVar *var = static_cast<OpcUATypedVar *>(
+            static_cast<OpcUAVarNodeContext *>(nodeContext));
+      OpcUANodeStats *stats = var->getStats();
+
+      if (!stats)
+         return writeObject(var, range, value);
+
+      uint64_t start = OpcUACallStats::start();
+      UA_StatusCode retval = writeObject(var, range, value);
+      stats->write.record(start, retval == UA_STATUSCODE_GOOD);
+      return retval;
+   }
+
+public:
+   /**
+    * @brief Constructor for this class
+    * @param node A preinitialized node
+    * @param nodeHandler The nodeHandler this node will be handled
+    * @param object The object to bind, it has to outlive the variable
+    */
+   OpcUATypedVar(UA_NodeId *node, OpcUANodeHandler *nodeHandler, T *object):
+      OpcUAVarNodeContext(node, nodeHandler), target(object),
+      arrayDimension(0) {
+      bindAttributes();
+   }
+
+   /**
+    * @brief Constructor for this class
+    * @param nodeHandler The nodeHandler this node will be handled
+    * @param object The object to bind, it has to outlive the variable
+    */
+   OpcUATypedVar(OpcUANodeHandler *nodeHandler, T *object):
+      OpcUAVarNodeContext(nodeHandler), target(object), arrayDimension(0) {
+      bindAttributes();
+   }
+
+   /**
+    * @brief Return the bound object
+    */
+   T *getObject() {
+      return target;
+   }
+
+   /**
+    * @brief Return the data source reading and writing the bound object
+    * @param source the data source to fill
+    * @return always true
+    */
+   bool getDataSource(UA_DataSource *source) {
+      source->read = readSource;
+      source->write = std::is_const<T>::value ? nullptr : writeSource;
+      return true;
+   }
+};
+
+} /* namespace n_opcua */
+
+#endif /* SRC_OPCUATYPEDVAR_H_ */
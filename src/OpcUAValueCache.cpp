@@ -0,0 +1,328 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "OpcUAValueCache.h"
+#include "OpcUAClock.h"
+
+namespace n_opcua {
+
+/* the range publishes remembered to catch spares up, and the spares kept */
+static const size_t historyDepth = 8;
+static const size_t spareCount = 2;
+
+void OpcUADirtyRanges::add(size_t begin, size_t end) {
+   if (begin >= end)
+      return;
+
+   /* the first range ending at or after begin touches the new one */
+   std::vector<Range>::iterator first = std::lower_bound(
+         ranges.begin(), ranges.end(), begin,
+         [](const Range &r, size_t value) { return r.second < value; });
+   std::vector<Range>::iterator last = first;
+   while (last != ranges.end() && last->first <= end) {
+      begin = std::min(begin, last->first);
+      end = std::max(end, last->second);
+      ++last;
+   }
+
+   if (first == last) {
+      ranges.insert(first, Range(begin, end));
+   } else {
+      *first = Range(begin, end);
+      ranges.erase(first + 1, last);
+   }
+}
+
+OpcUAValueCache::OpcUAValueCache() : current(nullptr), version(0) {
+   UA_DataValue_init(&staged);
+}
+
+OpcUAValueCache::~OpcUAValueCache() {
+   for (size_t i = 0; i < retired.size(); i++)
+      UA_DataValue_delete(retired[i].value);
+   unstage();
+
+   UA_DataValue *value = current.load(std::memory_order_relaxed);
+   if (value)
+      UA_DataValue_delete(value);
+}
+
+void OpcUAValueCache::reclaim(OpcUAServer *server) {
+   size_t kept = 0;
+
+   for (size_t i = 0; i < retired.size(); i++) {
+      if (server && !server->epochPassed(retired[i].epoch))
+         retired[kept++] = retired[i];
+      else if (staged.value.type && spares.size() < spareCount)
+         spares.push_back(retired[i]);
+      else
+         UA_DataValue_delete(retired[i].value);
+   }
+   retired.resize(kept);
+}
+
+void OpcUAValueCache::swap(UA_DataValue *snapshot, OpcUAServer *server) {
+   UA_DataValue *old = current.exchange(snapshot, std::memory_order_seq_cst);
+   if (old) {
+      /* a reader which still got the old snapshot is in this epoch or before */
+      Retired r = {old, server ? server->getEpoch() : 0, version};
+      retired.push_back(r);
+   }
+   version++;
+   reclaim(server);
+}
+
+void OpcUAValueCache::unstage() {
+   UA_DataValue_deleteMembers(&staged);
+   UA_DataValue_init(&staged);
+   dirty.clear();
+   history.clear();
+   for (size_t i = 0; i < spares.size(); i++)
+      UA_DataValue_delete(spares[i].value);
+   spares.clear();
+}
+
+bool OpcUAValueCache::publish(const UA_DataValue *value,
+                              OpcUAServer *server) {
+   if (!value)
+      return false;
+
+   UA_DataValue *snapshot = UA_DataValue_new();
+   if (!snapshot)
+      return false;
+   if (UA_DataValue_copy(value, snapshot) != UA_STATUSCODE_GOOD) {
+      UA_DataValue_delete(snapshot);
+      return false;
+   }
+   if (!snapshot->hasServerTimestamp) {
+      snapshot->serverTimestamp = OpcUAClock::cycleNow();
+      snapshot->hasServerTimestamp = true;
+   }
+
+   /* a staged array would be based on the replaced value */
+   unstage();
+   swap(snapshot, server);
+   return true;
+}
+
+void *OpcUAValueCache::stage(const UA_DataType *type, size_t *length) {
+   if (!staged.value.type) {
+      const UA_DataValue *snapshot = current.load(std::memory_order_relaxed);
+      if (!snapshot || !snapshot->hasValue || snapshot->value.type != type ||
+          UA_Variant_isScalar(&snapshot->value) || !type->pointerFree)
+         return nullptr;
+      if (UA_DataValue_copy(snapshot, &staged) != UA_STATUSCODE_GOOD) {
+         UA_DataValue_init(&staged);
+         return nullptr;
+      }
+   } else if (staged.value.type != type) {
+      return nullptr;
+   }
+
+   *length = staged.value.arrayLength;
+   return staged.value.data;
+}
+
+UA_DataValue *OpcUAValueCache::takeSpare() {
+   const UA_Variant *source = &staged.value;
+   size_t size = source->type->memSize;
+
+   while (!spares.empty()) {
+      /* the newest spare misses the fewest changes */
+      Retired spare = spares.back();
+      spares.pop_back();
+
+      UA_Variant *target = &spare.value->value;
+      if (target->type != source->type ||
+          target->arrayLength != source->arrayLength ||
+          UA_Variant_isScalar(target)) {
+         UA_DataValue_delete(spare.value);
+         continue;
+      }
+
+      const UA_Byte *src = static_cast<const UA_Byte *>(source->data);
+      UA_Byte *dst = static_cast<UA_Byte *>(target->data);
+      if (history.empty() || history.front().version > spare.version + 1) {
+         /* the changes since it was current are no longer known */
+         memcpy(dst, src, source->arrayLength * size);
+         return spare.value;
+      }
+
+      missed.clear();
+      for (size_t i = 0; i < history.size(); i++) {
+         if (history[i].version > spare.version)
+            missed.add(history[i].ranges);
+      }
+      for (size_t i = 0; i < missed.size(); i++) {
+         size_t offset = missed[i].first * size;
+         memcpy(dst + offset, src + offset,
+                (missed[i].second - missed[i].first) * size);
+      }
+      return spare.value;
+   }
+   return nullptr;
+}
+
+bool OpcUAValueCache::publishStaged(UA_DateTime sourceTimestamp,
+                                    OpcUAServer *server) {
+   if (!staged.value.type)
+      return false;
+   if (dirty.empty())
+      return true;
+
+   /* remember the changes of this publish, reusing the oldest entry */
+   History entry;
+   if (history.size() >= historyDepth) {
+      entry = std::move(history.front());
+      history.pop_front();
+      entry.ranges.clear();
+   }
+   entry.version = version + 1;
+   std::swap(entry.ranges, dirty);
+   history.push_back(std::move(entry));
+
+   staged.sourceTimestamp = sourceTimestamp;
+   staged.hasSourceTimestamp = true;
+   staged.serverTimestamp = OpcUAClock::cycleNow();
+   staged.hasServerTimestamp = true;
+
+   reclaim(server);
+   UA_DataValue *snapshot = takeSpare();
+   if (snapshot) {
+      UA_Variant value = snapshot->value;
+      *snapshot = staged;
+      snapshot->value = value;
+   } else {
+      snapshot = UA_DataValue_new();
+      if (!snapshot)
+         return false;
+      if (UA_DataValue_copy(&staged, snapshot) != UA_STATUSCODE_GOOD) {
+         UA_DataValue_delete(snapshot);
+         return false;
+      }
+   }
+
+   swap(snapshot, server);
+   return true;
+}
+
+UA_StatusCode OpcUAValueCache::read(UA_DataValue *value,
+                                    bool includeSourceTimeStamp,
+                                    const UA_NumericRange *range) const {
+   /* ordered after the reader slot of worker threads, see enterReader() */
+   const UA_DataValue *snapshot = current.load(std::memory_order_seq_cst);
+   if (!snapshot)
+      return UA_STATUSCODE_BADWAITINGFORINITIALDATA;
+
+   UA_StatusCode retval;
+   if (range) {
+      *value = *snapshot;
+      UA_Variant_init(&value->value);
+      retval = UA_Variant_copyRange(&snapshot->value, &value->value, *range);
+   } else {
+      retval = UA_DataValue_copy(snapshot, value);
+   }
+   if (retval != UA_STATUSCODE_GOOD) {
+      UA_DataValue_init(value);
+      return retval;
+   }
+
+   if (!includeSourceTimeStamp) {
+      value->hasSourceTimestamp = false;
+      value->hasSourcePicoseconds = false;
+   }
+   return UA_STATUSCODE_GOOD;
+}
+
+OpcUAReadMemo::OpcUAReadMemo() :
+   maxAge(0),
+   memoStatus(UA_STATUSCODE_GOOD),
+   valid(false),
+   loading(false),
+   loads(0),
+   invalidations(0),
+   hits(0),
+   misses(0),
+   coalesced(0) {
+   UA_DataValue_init(&memo);
+}
+
+OpcUAReadMemo::~OpcUAReadMemo() {
+   UA_DataValue_deleteMembers(&memo);
+}
+
+void OpcUAReadMemo::setMaxAge(std::chrono::nanoseconds age) {
+   std::lock_guard<std::mutex> guard(lock);
+   maxAge.store(std::max<int64_t>(age.count(), 0), std::memory_order_relaxed);
+   valid = false;
+   invalidations++;
+}
+
+void OpcUAReadMemo::invalidate() {
+   if (!isEnabled())
+      return;
+
+   std::lock_guard<std::mutex> guard(lock);
+   valid = false;
+   invalidations++;
+}
+
+void OpcUAReadMemo::resetCounters() {
+   hits.store(0, std::memory_order_relaxed);
+   misses.store(0, std::memory_order_relaxed);
+   coalesced.store(0, std::memory_order_relaxed);
+}
+
+bool OpcUAReadMemo::fresh(std::chrono::steady_clock::time_point now) const {
+   return valid && now - memoTime <=
+          std::chrono::nanoseconds(maxAge.load(std::memory_order_relaxed));
+}
+
+void OpcUAReadMemo::store(UA_DataValue *result, UA_StatusCode retval,
+                          std::chrono::steady_clock::time_point started,
+                          uint64_t epoch) {
+   UA_DataValue_deleteMembers(&memo);
+   memo = *result;
+   memoStatus = retval;
+   memoTime = started;
+   /* failures are handed to the waiting reads, but not reused */
+   valid = retval == UA_STATUSCODE_GOOD && epoch == invalidations;
+   loading = false;
+   loads++;
+   loaded.notify_all();
+}
+
+UA_StatusCode OpcUAReadMemo::copyOut(UA_DataValue *value,
+                                     bool includeSourceTimeStamp,
+                                     const UA_NumericRange *range) const {
+   if (memoStatus != UA_STATUSCODE_GOOD)
+      return memoStatus;
+
+   UA_StatusCode retval;
+   if (range) {
+      *value = memo;
+      UA_Variant_init(&value->value);
+      retval = UA_Variant_copyRange(&memo.value, &value->value, *range);
+   } else {
+      retval = UA_DataValue_copy(&memo, value);
+   }
+   if (retval != UA_STATUSCODE_GOOD) {
+      UA_DataValue_init(value);
+      return retval;
+   }
+
+   if (!includeSourceTimeStamp) {
+      value->hasSourceTimestamp = false;
+      value->hasSourcePicoseconds = false;
+   }
+   return UA_STATUSCODE_GOOD;
+}
+
+} /* namespace n_opcua */
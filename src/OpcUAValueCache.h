@@ -0,0 +1,437 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. 
+ *
+ * Copyright (C) 2018 Tobias Klausmann 
+ * <tobias.johannes.klausmann@mni.thm.de>
+ */
+
+#ifndef SRC_OPCUAVALUECACHE_H_
+#define SRC_OPCUAVALUECACHE_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include "OpcUAServer.h"
+
+namespace n_opcua {
+
+/**
+ * Sorted, disjoint element ranges of an array, overlapping and adjacent
+ * ranges are merged when added.
+ */
+class OpcUADirtyRanges {
+public:
+   /* the first element and the element after the last one */
+   typedef std::pair<size_t, size_t> Range;
+
+private:
+   std::vector<Range> ranges;
+
+public:
+   /**
+    * @brief Add the elements [begin, end)
+    * @param begin the first element
+    * @param end the element after the last one
+    */
+   void add(size_t begin, size_t end);
+
+   /**
+    * @brief Add all ranges of another set
+    * @param other the ranges to add
+    */
+   void add(const OpcUADirtyRanges &other) {
+      for (size_t i = 0; i < other.ranges.size(); i++)
+         add(other.ranges[i].first, other.ranges[i].second);
+   }
+
+   /**
+    * @brief Remove all ranges
+    */
+   void clear() {
+      ranges.clear();
+   }
+
+   /**
+    * @brief Check if no element is in a range
+    */
+   bool empty() const {
+      return ranges.empty();
+   }
+
+   /**
+    * @brief Return the count of disjoint ranges
+    */
+   size_t size() const {
+      return ranges.size();
+   }
+
+   /**
+    * @brief Return a range, ordered by their first element
+    * @param i the index of the range
+    */
+   const Range &operator[](size_t i) const {
+      return ranges[i];
+   }
+
+   /**
+    * @brief Return the count of elements in all ranges
+    */
+   size_t elements() const {
+      size_t count = 0;
+      for (size_t i = 0; i < ranges.size(); i++)
+         count += ranges[i].second - ranges[i].first;
+      return count;
+   }
+};
+
+/**
+ * Last published value of a variable, read by the server without locks and
+ * without calling into user code.
+ *
+ * Every publish() stores a deep copy of the value as a new immutable
+ * snapshot and swaps it in with a single atomic store, a read copies the
+ * snapshot it loaded. A replaced snapshot is retired and only freed after the
+ * server finished the loop iteration it could have been read in (see
+ * OpcUAServer::epochPassed()), so a reader never sees a torn or freed value.
+ *
+ * Large arrays changing in small windows are updated in place instead: the
+ * producer changes a staged copy (stage(), markDirty()) and publishStaged()
+ * brings a retired snapshot up to date by copying only the changed ranges.
+ *
+ * publish() may be called from any single producer thread, read() is called
+ * from the server thread. The server has to be run by OpcUAServer::run().
+ */
+class OpcUAValueCache {
+private:
+   struct Retired {
+      UA_DataValue *value;
+      uint64_t epoch;
+      /* the publish the snapshot was made by */
+      uint64_t version;
+   };
+
+   struct History {
+      uint64_t version;
+      OpcUADirtyRanges ranges;
+   };
+
+   /* the snapshot served to readers, nullptr until the first publish */
+   std::atomic<UA_DataValue *> current;
+   /* replaced snapshots the server may still read from */
+   std::vector<Retired> retired;
+
+   /* count of publishes, the version of current */
+   uint64_t version;
+   /* producer side copy of the array updated in place, see stage() */
+   UA_DataValue staged;
+   /* the elements of staged changed since the last publish */
+   OpcUADirtyRanges dirty;
+   /* the changed elements of the last range publishes, oldest first */
+   std::deque<History> history;
+   /* retired snapshots no longer read, reused by publishStaged() */
+   std::vector<Retired> spares;
+   /* the elements a spare snapshot has to catch up on */
+   OpcUADirtyRanges missed;
+
+   /**
+    * @brief Free the retired snapshots the server no longer reads from, or
+    * keep them as spares while an array is staged
+    * @param server the server reading the snapshots
+    */
+   void reclaim(OpcUAServer *server);
+
+   /**
+    * @brief Swap in a new snapshot and retire the old one
+    * @param snapshot the new snapshot
+    * @param server the server reading the cache, nullptr if none does yet
+    */
+   void swap(UA_DataValue *snapshot, OpcUAServer *server);
+
+   /**
+    * @brief Take a spare snapshot and copy the elements of staged it missed
+    * @return the snapshot, nullptr if no spare matches staged
+    */
+   UA_DataValue *takeSpare();
+
+   /**
+    * @brief Drop the staged array, the spares and the range history
+    */
+   void unstage();
+
+public:
+   /**
+    * @brief Constructor for an empty cache
+    */
+   OpcUAValueCache();
+
+   /**
+    * @brief Default deconstructor, the server must no longer read from the
+    * cache
+    */
+   virtual ~OpcUAValueCache();
+
+   OpcUAValueCache(const OpcUAValueCache &) = delete;
+   OpcUAValueCache &operator=(const OpcUAValueCache &) = delete;
+
+   /**
+    * @brief Publish a new value
+    * @param value the value to copy into the cache
+    * @param server the server reading the cache, nullptr if none does yet
+    * @return true if published, else false
+    */
+   bool publish(const UA_DataValue *value, OpcUAServer *server);
+
+   /**
+    * @brief Return the elements of the staged array to update in place, the
+    * last published value is copied once on the first call. Only for the
+    * producer thread, mark the changed elements with markDirty()
+    * @param type the element type of the array
+    * @param length the returned element count
+    * @return the first element, nullptr if the last published value is no
+    * array of type or type is not pointer free
+    */
+   void *stage(const UA_DataType *type, size_t *length);
+
+   /**
+    * @brief Mark elements of the staged array as changed
+    * @param first the first element
+    * @param count the count of elements
+    */
+   void markDirty(size_t first, size_t count) {
+      if (count > 0)
+         dirty.add(first, first + count);
+   }
+
+   /**
+    * @brief Return the elements of the staged array changed since the last
+    * publish
+    */
+   const OpcUADirtyRanges &getDirty() const {
+      return dirty;
+   }
+
+   /**
+    * @brief Publish the staged array. A retired snapshot the server no longer
+    * reads from is reused and only the elements changed since it was
+    * current are copied, a new snapshot is only allocated if none is spare
+    * @param sourceTimestamp the source timestamp of the value
+    * @param server the server reading the cache, nullptr if none does yet
+    * @return true if published or nothing changed, false if nothing is
+    * staged
+    */
+   bool publishStaged(UA_DateTime sourceTimestamp, OpcUAServer *server);
+
+   /**
+    * @brief Copy the last published value
+    * @param value the returned value
+    * @param includeSourceTimeStamp if the source timestamp is returned
+    * @param range the index range to return, nullptr for all of it
+    * @return the status of the read, UA_STATUSCODE_BADWAITINGFORINITIALDATA
+    * if nothing was published yet
+    */
+   UA_StatusCode read(UA_DataValue *value, bool includeSourceTimeStamp,
+                      const UA_NumericRange *range = nullptr) const;
+
+   /**
+    * @brief Check if a value was published
+    * @return true if a value was published, else false
+    */
+   bool isPublished() const {
+      return current.load(std::memory_order_relaxed) != nullptr;
+   }
+
+   /**
+    * @brief Return the last published value, only for the producer thread
+    * @return the value, nullptr if nothing was published yet
+    */
+   const UA_DataValue *getPublished() const {
+      return current.load(std::memory_order_relaxed);
+   }
+
+   /**
+    * @brief Return the count of snapshots waiting to be freed
+    */
+   size_t retiredCount() const {
+      return retired.size();
+   }
+};
+
+/**
+ * Result of the last read callback call of a variable, reused for a
+ * configurable time, see OpcUAVarNodeContext::setReadMaxAge().
+ *
+ * A read finding no fresh result calls the callback, reads arriving while
+ * that call runs wait for its result instead of calling it again. The
+ * callback is always called for the whole value with the source timestamp,
+ * ranges and the source timestamp are applied to copies of the result.
+ */
+class OpcUAReadMemo {
+private:
+   std::mutex lock;
+   /* signaled when a load finished */
+   std::condition_variable loaded;
+   /* the max age in nanoseconds, 0 if disabled */
+   std::atomic<int64_t> maxAge;
+
+   /* the last result and when its load began */
+   UA_DataValue memo;
+   UA_StatusCode memoStatus;
+   std::chrono::steady_clock::time_point memoTime;
+   bool valid;
+   /* if a callback call runs, and the count of finished ones */
+   bool loading;
+   uint64_t loads;
+   /* advanced by invalidate(), a load overlapping it is not kept */
+   uint64_t invalidations;
+
+   std::atomic<uint64_t> hits;
+   std::atomic<uint64_t> misses;
+   std::atomic<uint64_t> coalesced;
+
+   /**
+    * @brief Check if the last result may be returned, lock has to be held
+    */
+   bool fresh(std::chrono::steady_clock::time_point now) const;
+
+   /**
+    * @brief Copy the last result, lock has to be held
+    */
+   UA_StatusCode copyOut(UA_DataValue *value, bool includeSourceTimeStamp,
+                         const UA_NumericRange *range) const;
+
+   /**
+    * @brief Keep the result of a load and wake the waiting reads, lock has
+    * to be held
+    * @param result the result, moved into the memo
+    * @param retval the status of the load
+    * @param started when the load began
+    * @param epoch the invalidations when the load began
+    */
+   void store(UA_DataValue *result, UA_StatusCode retval,
+              std::chrono::steady_clock::time_point started, uint64_t epoch);
+
+public:
+   /**
+    * @brief Constructor for a disabled memo
+    */
+   OpcUAReadMemo();
+
+   /**
+    * @brief Default deconstructor
+    */
+   virtual ~OpcUAReadMemo();
+
+   OpcUAReadMemo(const OpcUAReadMemo &) = delete;
+   OpcUAReadMemo &operator=(const OpcUAReadMemo &) = delete;
+
+   /**
+    * @brief Set how long a result is reused, the last result is dropped
+    * @param age the max age, 0 disables the memo
+    */
+   void setMaxAge(std::chrono::nanoseconds age);
+
+   /**
+    * @brief Return how long a result is reused
+    */
+   std::chrono::nanoseconds getMaxAge() const {
+      return std::chrono::nanoseconds(maxAge.load(std::memory_order_relaxed));
+   }
+
+   /**
+    * @brief Check if results are reused
+    */
+   bool isEnabled() const {
+      return maxAge.load(std::memory_order_relaxed) > 0;
+   }
+
+   /**
+    * @brief Drop the last result, e.g. after the variable was written
+    */
+   void invalidate();
+
+   template <typename Load>
+   /**
+    * @brief Read through the memo
+    * @param value the value to fill
+    * @param includeSourceTimeStamp if the source timestamp is returned
+    * @param range the elements to return, nullptr for all
+    * @param load called as UA_StatusCode load(UA_DataValue *) to read the
+    * whole value with source timestamp if no fresh result is there
+    * @return the status of the load the result came from,
+    * UA_STATUSCODE_BADINTERNALERROR if it threw
+    */
+   UA_StatusCode read(UA_DataValue *value, bool includeSourceTimeStamp,
+                      const UA_NumericRange *range, Load load) {
+      std::unique_lock<std::mutex> guard(lock);
+      std::chrono::steady_clock::time_point now =
+            std::chrono::steady_clock::now();
+      if (fresh(now)) {
+         hits.fetch_add(1, std::memory_order_relaxed);
+         return copyOut(value, includeSourceTimeStamp, range);
+      }
+
+      if (loading) {
+         coalesced.fetch_add(1, std::memory_order_relaxed);
+         uint64_t waitFor = loads + 1;
+         loaded.wait(guard, [&] { return loads >= waitFor; });
+         return copyOut(value, includeSourceTimeStamp, range);
+      }
+
+      misses.fetch_add(1, std::memory_order_relaxed);
+      loading = true;
+      uint64_t epoch = invalidations;
+      guard.unlock();
+
+      UA_DataValue result;
+      UA_DataValue_init(&result);
+      UA_StatusCode retval;
+      try {
+         retval = load(&result);
+      } catch (...) {
+         /* the waiting reads would wait for this load forever, and the
+          * exception must not unwind through the C code of open62541 */
+         UA_DataValue_deleteMembers(&result);
+         UA_DataValue_init(&result);
+         retval = UA_STATUSCODE_BADINTERNALERROR;
+      }
+
+      guard.lock();
+      store(&result, retval, now, epoch);
+      return copyOut(value, includeSourceTimeStamp, range);
+   }
+
+   /**
+    * @brief Return the count of reads served from a fresh result
+    */
+   uint64_t getHits() const {
+      return hits.load(std::memory_order_relaxed);
+   }
+
+   /**
+    * @brief Return the count of reads calling the callback
+    */
+   uint64_t getMisses() const {
+      return misses.load(std::memory_order_relaxed);
+   }
+
+   /**
+    * @brief Return the count of reads waiting for the call of another one
+    */
+   uint64_t getCoalesced() const {
+      return coalesced.load(std::memory_order_relaxed);
+   }
+
+   /**
+    * @brief Reset the counters to 0
+    */
+   void resetCounters();
+};
+
+} /* namespace n_opcua */
+
+#endif /* SRC_OPCUAVALUECACHE_H_ */